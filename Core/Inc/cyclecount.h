@@ -0,0 +1,34 @@
+/*
+ * cyclecount.h
+ *
+ *  Created on: 2025-03-22
+ *  Updated on: 2025-03-22
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * CPU cycle counter (Cortex-M7 DWT CYCCNT) for timing measurements.
+ *
+ * The counter is 32 bits and wraps every ~20 seconds at 216 MHz,
+ * so only use it to measure intervals shorter than that. Unsigned
+ * subtraction handles a single wrap correctly.
+ */
+
+#ifndef INC_CYCLECOUNT_H_
+#define INC_CYCLECOUNT_H_
+
+#include <stdint.h>
+#include "stm32f7xx.h"
+
+// Enable the DWT cycle counter; call once at startup
+void cyclecount_init(void);
+
+// Convert a cycle count interval into microseconds
+uint32_t cyclecount_to_us(uint32_t cycles);
+
+/** Returns the current CPU cycle count. Safe to call from interrupts. */
+static inline uint32_t cyclecount_now(void) {
+  return DWT->CYCCNT;
+}
+
+#endif /* INC_CYCLECOUNT_H_ */
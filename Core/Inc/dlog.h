@@ -0,0 +1,83 @@
+/*
+ * dlog.h
+ *
+ *  Created on: 2025-04-07
+ *  Updated on: 2025-04-07
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Deferred-format console logging: DLOG() records where its format
+ * string is and its raw arguments; the formatting is done later, by
+ * the host (Tools/dlogdecode.py) in binary mode, or by dlog_flush()
+ * in text mode.
+ */
+
+#ifndef INC_DLOG_H_
+#define INC_DLOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Bytes of frames waiting to be sent; must be a power of 2
+#define DLOG_BUF_SZ 1024
+
+// Most arguments one DLOG() can take (DLOG_NARGS counts up to this)
+#define DLOG_MAX_ARGS 12
+
+// Longest text mode line, after formatting
+#define DLOG_LINE_MAX 200
+
+/* Binary frame, all little endian. Keep in sync with
+ * Tools/dlogdecode.py:
+ *   0: DLOG_SYNC
+ *   1: number of arguments
+ *   2: sequence number, to spot lost frames
+ *   3: checksum: makes the sum of all the frame's bytes 0 (mod 256)
+ *   4: format string address, in the .dlog_fmt section
+ *   8: DWT cycle count when logged
+ *  12: the arguments, 4 bytes each
+ */
+#define DLOG_SYNC   0xA5
+#define DLOG_HDR_SZ 12
+#define DLOG_FRAME_MAX (DLOG_HDR_SZ + 4 * DLOG_MAX_ARGS)
+
+typedef struct dlog_stats {
+  uint32_t logged;  // Messages recorded
+  uint32_t dropped; // Messages that did not fit
+  uint32_t frames;  // Sent as binary frames
+  uint32_t lines;   // Sent as text
+  uint32_t bytes;   // Total bytes sent, either way
+} dlog_stats_t;
+
+extern dlog_stats_t dlog_stats;
+
+void dlog_init(void);
+void dlog_set_binary(bool binary);
+bool dlog_binary(void);
+size_t dlog_pending(void);
+size_t dlog_flush(uint8_t *out, size_t out_sz);
+
+void dlog_write(uint32_t nargs, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Counts the arguments of DLOG(), 0 to DLOG_MAX_ARGS
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_NARGS_(z, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, n, ...) n
+
+/** Logs a printf style message without formatting it. The format
+ * must be a string literal; it is kept in the .dlog_fmt section, and
+ * its address is what is sent. Each argument is sent as 32 bits, so
+ * only ints, longs, chars and pointers may be used: no floats or
+ * 64 bit values (cast those first). A %s argument must be a constant
+ * string in flash, as only its address is sent.
+ *
+ * Main loop only; this is not interrupt safe.
+ */
+#define DLOG(fmt, ...) do { \
+    static const char dlog_fmt_[] __attribute__((section(".dlog_fmt"), used)) = fmt; \
+    dlog_write(DLOG_NARGS(__VA_ARGS__), dlog_fmt_, ##__VA_ARGS__); \
+  } while (0)
+
+#endif /* INC_DLOG_H_ */
@@ -0,0 +1,51 @@
+/*
+ * memstats.h
+ *
+ *  Created on: 2025-03-25
+ *  Updated on: 2025-03-25
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Non-destructive memory usage measurement: stack high-water mark,
+ * heap break and malloc usage, and static RAM region usage.
+ */
+
+#ifndef INC_MEMSTATS_H_
+#define INC_MEMSTATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// What unused stack is painted with
+#define MEMSTATS_STACK_PAINT 0xA5C3A5C3
+
+typedef struct memstats {
+  // DTCM stack: size, deepest use seen since boot, use right now
+  size_t   stack_size;
+  size_t   stack_peak;
+  size_t   stack_now;
+
+  // Heap: size, break (now and peak) and failed requests (_sbrk)
+  size_t   heap_size;
+  size_t   heap_brk;
+  size_t   heap_brk_peak;
+  uint32_t sbrk_failures;
+
+  // newlib malloc: bytes in use and free within the break (mallinfo)
+  size_t   malloc_in_use;
+  size_t   malloc_free;
+
+  // Static allocations in each RAM region
+  size_t   fastram_size;
+  size_t   fastram_used;
+  size_t   dmaram_size;
+  size_t   dmaram_used;
+  size_t   ram_static;   // .data + .bss
+} memstats_t;
+
+// Call once, as early as possible
+void memstats_paint_stack(void);
+void memstats_get(memstats_t *ms);
+
+#endif /* INC_MEMSTATS_H_ */
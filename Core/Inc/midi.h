@@ -2,7 +2,7 @@
  * midi.h
  *
  *  Created on: Sep 8, 2024
- *  Updated on: 2024-09-08
+ *  Updated on: 2025-04-12
  *      Author: Douglas P. Fields, Jr.
  *   Copyright: 2024, Douglas P. Fields, Jr.
  *     License: Apache 2.0
@@ -18,7 +18,8 @@
 #define MIDI_NONE     ((uint8_t)0x00) // If we have no current running status
 #define MIDI_ERROR    ((uint8_t)0x01) // If we see an error somehow
 
-// Channel mode messages
+// Channel mode messages - these are the control numbers of a
+// Control Change (0xBn) message which make it a channel mode message
 #define MIDI_MODE_ALL_SOUND_OFF ((uint8_t)120)
 #define MIDI_MODE_RESET_ALL     ((uint8_t)121)
 #define MIDI_MODE_LOCAL_CONTROL ((uint8_t)122)
@@ -32,11 +33,23 @@
 #define MIDI_NOTE_OFF ((uint8_t)0x80)
 #define MIDI_NOTE_ON  ((uint8_t)0x90)
 // System messages
+#define MIDI_SONG_POSITION ((uint8_t)0xF2)
 // Real time mesages
 #define MIDI_RT_TIMING_CLOCK ((uint8_t)0xF8)
+#define MIDI_RT_START        ((uint8_t)0xFA)
+#define MIDI_RT_CONTINUE     ((uint8_t)0xFB)
+#define MIDI_RT_STOP         ((uint8_t)0xFC)
 // ...
 #define MIDI_RT_SYSTEM_RESET ((uint8_t)0xFF)
 
+// midi_status_info[] entries: number of data bytes and class
+#define MIDI_SI_LENGTH    ((uint8_t)0x03) // Data bytes: 0-2
+#define MIDI_SI_CHANNEL   ((uint8_t)0x04) // Channel voice/mode; running status
+#define MIDI_SI_COMMON    ((uint8_t)0x08) // System common
+#define MIDI_SI_SYSEX     ((uint8_t)0x10) // SysEx start
+#define MIDI_SI_REALTIME  ((uint8_t)0x20) // System real-time
+#define MIDI_SI_UNDEFINED ((uint8_t)0x40) // Undefined & EOX: end running status
+
 /*
  * We return this structure when we have received a fully
  * formed MIDI message.
@@ -45,6 +58,7 @@ typedef struct {
   // One of the MIDI_ enumerated types above; the same
   // as the MIDI status byte when >= 0x80
   uint8_t type;
+  // 0-15 for channel messages; 0 for system messages
   uint8_t channel;
   union {
     uint8_t data1;
@@ -66,6 +80,34 @@ typedef struct {
 
 #define MIDI_14bits(mmptr) (((mmptr)->lsb & 0x7F) | (((mmptr)->msb & 0x7F) << 7))
 
+/*
+ * How to receive SysEx payloads (everything between the 0xF0 and the
+ * 0xF7, exclusive). All callbacks are optional and are called from
+ * midi_stream_receive() and midi_stream_receive_buf(), with ctx.
+ *
+ * Without a buffer, data() gets each run of payload bytes directly
+ * from the span passed to midi_stream_receive_buf() - no copying.
+ * The pointer is only valid during the call.
+ *
+ * With a buffer, the payload is collected in it, and data() gets the
+ * buffer each time it fills up and once more at the end. Without a
+ * data() callback, whatever does not fit is dropped and counted as
+ * an overflow; end() can then use the first buf_sz bytes. A buffer
+ * with buf_sz 0 is the same as none.
+ *
+ * end() is called with complete = 0 if the SysEx was cut off by
+ * another status byte instead of ending with EOX. Real-time
+ * messages within a SysEx are received as usual.
+ */
+typedef struct midi_sysex_handler {
+  void (*start)(void *ctx);
+  void (*data)(void *ctx, const uint8_t *data, size_t len);
+  void (*end)(void *ctx, size_t total_len, int complete);
+  void *ctx;
+  uint8_t *buf;
+  size_t buf_sz;
+} midi_sysex_handler_t;
+
 /*
  * This structure maintains the internal state of
  * an incoming out outgoing MIDI I/O channel.
@@ -74,8 +116,8 @@ typedef struct {
  * accumulates bytes for messages before returning
  * a fully parsed message.
  *
- * Currently we ignore SysEx instead of storing
- * any SysEx stuff.
+ * SysEx payloads are handed to the midi_sysex_handler_t, if any,
+ * as they arrive.
  */
 
 typedef struct {
@@ -90,6 +132,19 @@ typedef struct {
   // will never be a valid data byte
   uint8_t data1;
 
+  // SysEx reception; see midi_stream_set_sysex()
+  const midi_sysex_handler_t *sysex;
+  uint8_t sysex_buffered;   // It has a buffer to collect in (buf_sz > 0)
+  uint8_t in_sysex;
+  uint8_t sysex_overflowed; // This SysEx has overflowed the buffer
+  size_t sysex_len;         // Payload bytes in this SysEx so far
+  size_t sysex_buf_used;    // Bytes in the handler's buffer
+  // SysEx counters
+  uint32_t sysex_complete;  // Ended by EOX
+  uint32_t sysex_truncated; // Cut off by another status byte
+  uint32_t sysex_overflows; // Did not fit the handler's buffer
+  uint32_t sysex_dropped;   // Payload bytes dropped by overflows
+
   // TODO: Track Omni/Poly/Mono for all 16 tracks
   // TODO: Track MSB & LSB for each CC and their last value
   // TODO: Track the state of every key
@@ -98,9 +153,14 @@ typedef struct {
 } midi_stream;
 
 extern const uint32_t midi_note_freqX100[];
+extern const uint8_t midi_status_info[256];
 
 void midi_stream_init(midi_stream *ms);
+void midi_stream_set_sysex(midi_stream *ms, const midi_sysex_handler_t *handler);
+void midi_stream_resync(midi_stream *ms);
 int midi_stream_receive(midi_stream *ms, uint8_t b, midi_message *msg);
+size_t midi_stream_receive_buf(midi_stream *ms, const uint8_t *buf, size_t len,
+                               midi_message *msgs, size_t max_msgs, size_t *consumed);
 int midi_snprintf(char *str, size_t size, midi_message *mm);
 
 #endif /* INC_MIDI_H_ */
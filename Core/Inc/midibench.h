@@ -0,0 +1,51 @@
+/*
+ * midibench.h
+ *
+ *  Created on: 2025-03-22
+ *  Updated on: 2025-03-29
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * On-device MIDI parser throughput benchmark and randomized
+ * cross-check against a simple reference decoder, and a round trip
+ * check of the MIDI output encoder.
+ */
+
+#ifndef INC_MIDIBENCH_H_
+#define INC_MIDIBENCH_H_
+
+#include <stdint.h>
+
+typedef struct midibench_result {
+  // Cross-check: bytes fed to both decoders and what they produced
+  uint32_t check_bytes;
+  uint32_t check_messages;
+  uint32_t mismatches;
+  // Byte offset of the first mismatch, if any
+  uint32_t first_mismatch;
+  // SysEx payload bytes, and whether their tally differed
+  uint32_t sysex_bytes;
+  uint32_t sysex_mismatch;
+  // Differences between the bulk and byte at a time parsers
+  uint32_t bulk_mismatches;
+  // midi_out round trip: messages, differences, and bytes on the
+  // wire compared to sending every status byte
+  uint32_t encode_messages;
+  uint32_t encode_mismatches;
+  uint32_t encode_bytes;
+  uint32_t encode_raw_bytes;
+
+  // Throughput: bytes and messages parsed in how many CPU cycles
+  uint32_t bench_bytes;
+  uint32_t bench_messages;
+  uint32_t bench_cycles;
+  // The same bytes through the bulk parser
+  uint32_t bulk_messages;
+  uint32_t bulk_cycles;
+} midibench_result_t;
+
+// Runs the cross-check and then the benchmark from the PRNG seed
+void midibench_run(uint32_t seed, midibench_result_t *result);
+
+#endif /* INC_MIDIBENCH_H_ */
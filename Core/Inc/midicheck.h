@@ -0,0 +1,81 @@
+/*
+ * midicheck.h
+ *
+ *  Created on: 2025-04-12
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Cross-checks of the MIDI parser (midi.c): the byte parser against
+ * the reference decoder, and the bulk parser against the byte parser;
+ * and a round trip of the MIDI output encoder (midiout.c) through it.
+ * Shared by the on-device benchmark (midibench.c) and the host fuzz
+ * harness (Tools/midifuzz).
+ */
+
+#ifndef INC_MIDICHECK_H_
+#define INC_MIDICHECK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "midi.h"
+#include "midiref.h"
+
+// Largest span fed to the bulk parser, and most messages asked for at once
+#define MIDICHECK_SPAN_SZ 64
+#define MIDICHECK_MAX_MSGS 4
+// Deliberately small, odd sized SysEx collecting buffer
+#define MIDICHECK_SYSEX_BUF_SZ 5
+// Messages per encoder round trip, and the largest chunk drained
+#define MIDICHECK_ENCODE_MSGS 256
+#define MIDICHECK_DRAIN_SZ 16
+
+/* Both checks, over any number of calls: the parsers keep their state
+ * from one to the next, as if the data were one stream. Don't move it
+ * after midicheck_init(); the SysEx handlers point into it.
+ */
+typedef struct midicheck {
+  // Byte parser and reference decoder. Its SysEx handler has a
+  // zero sized buffer, which has to work like none.
+  midi_stream ref_ms;
+  midiref_decoder_t rd;
+  midiref_tally_t ref_tally;
+  midi_sysex_handler_t ref_sysex;
+  uint8_t no_room[1];
+
+  // Bulk parser, with SysEx as spans, and byte parser, with SysEx
+  // through sysex_buf
+  midi_stream bulk_ms;
+  midi_stream byte_ms;
+  midiref_tally_t bulk_tally;
+  midiref_tally_t byte_tally;
+  midi_sysex_handler_t bulk_sysex;
+  midi_sysex_handler_t byte_sysex;
+  uint8_t sysex_buf[MIDICHECK_SYSEX_BUF_SZ];
+
+  // Results. Offsets count bytes from the first call.
+  uint32_t bytes;             // Through the reference check
+  uint32_t messages;          // From the byte parser there
+  uint32_t mismatches;
+  uint32_t first_mismatch;    // Offset of the first, if any
+  uint32_t sysex_mismatch;    // The tallies differ (midicheck_finish())
+  uint32_t bulk_bytes;        // Through the bulk check
+  uint32_t bulk_mismatches;   // Messages, SysEx or consumed counts
+  uint32_t first_bulk_mismatch;
+  // midi_out round trips: messages, differences, and bytes on the
+  // wire compared to sending every status byte
+  uint32_t encode_messages;
+  uint32_t encode_mismatches;
+  uint32_t encode_bytes;
+  uint32_t encode_raw_bytes;
+} midicheck_t;
+
+uint32_t midicheck_random(uint32_t *state);
+void midicheck_init(midicheck_t *mc);
+void midicheck_reference(midicheck_t *mc, const uint8_t *data, size_t len);
+void midicheck_bulk(midicheck_t *mc, const uint8_t *data, size_t len, uint32_t *state);
+void midicheck_finish(midicheck_t *mc);
+void midicheck_encoder(midicheck_t *mc, uint32_t *state);
+
+#endif /* INC_MIDICHECK_H_ */
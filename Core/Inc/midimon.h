@@ -0,0 +1,61 @@
+/*
+ * midimon.h
+ *
+ *  Created on: 2025-04-03
+ *  Updated on: 2025-04-03
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Rate-limited MIDI monitor: buffers received messages and formats
+ * them for the console and the display only a few times a second,
+ * summarizing bursts.
+ */
+
+#ifndef INC_MIDIMON_H_
+#define INC_MIDIMON_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "midi.h"
+
+// Messages kept for the console; must be a power of 2
+#define MIDIMON_SIZE 16
+// Console output at most every this many ms, showing at most
+// this many messages each time (the newest)
+#define MIDIMON_CONSOLE_MS    50
+#define MIDIMON_CONSOLE_LINES 4
+// Display redraw at most every this many ms
+#define MIDIMON_DISPLAY_MS    100
+
+typedef struct midimon {
+  // Console: the newest messages, oldest overwritten when full
+  midi_message ring[MIDIMON_SIZE];
+  uint32_t head;
+  uint32_t tail;
+  uint32_t skipped;         // Overwritten since the last output
+  uint32_t last_console;    // ms
+
+  // Display: only the latest, and how many since the last redraw
+  midi_message latest;
+  uint32_t display_pending;
+  uint32_t last_display;    // ms
+
+  // Statistics
+  uint32_t received;        // Messages added for the console
+  uint32_t printed;         // Messages printed on the console
+  uint32_t summarized;      // Counted in a burst summary instead
+  uint32_t overwritten;     // Oldest dropped because the ring was full
+  uint32_t console_full;    // Not printed for lack of console space
+  uint32_t redraws;         // Display updates
+  uint32_t coalesced;       // Messages never drawn on their own
+} midimon_t;
+
+void midimon_init(midimon_t *m);
+void midimon_console_add(midimon_t *m, const midi_message *mm);
+void midimon_display_add(midimon_t *m, const midi_message *mm);
+size_t midimon_console_flush(midimon_t *m, uint32_t now_ms, char *out, size_t out_sz);
+size_t midimon_display_flush(midimon_t *m, uint32_t now_ms, char *out, size_t out_sz);
+
+#endif /* INC_MIDIMON_H_ */
@@ -0,0 +1,89 @@
+/*
+ * midiout.h
+ *
+ *  Created on: 2025-03-29
+ *  Updated on: 2025-03-29
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * MIDI output encoder with running status and a send queue
+ * that puts real-time bytes ahead of everything else, which
+ * also merges forwarded (MIDI thru) and locally made messages.
+ */
+
+#ifndef INC_MIDIOUT_H_
+#define INC_MIDIOUT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "midi.h"
+
+// Queue sizes; must be powers of 2
+#define MIDI_OUT_BUF_SZ 128
+#define MIDI_OUT_RT_SZ  8
+// Forwarded messages whose latency can be tracked at once
+#define MIDI_OUT_STAMPS 16
+
+// 10 bits per byte (8-N-1) at 31,250 baud
+#define MIDI_OUT_US_PER_BYTE 320
+
+typedef struct midi_out {
+  // Settings
+  // Send Note Off as Note On with velocity 0, which lets running
+  // status continue across note ons and offs (release velocity is lost)
+  bool off_as_zero_on;
+
+  // Status byte last sent, or 0 if the receiver has no running status
+  uint8_t running_status;
+
+  // Encoded messages waiting to be sent; free running indices
+  uint8_t  buf[MIDI_OUT_BUF_SZ];
+  uint32_t head;
+  uint32_t tail;
+
+  // Real-time bytes waiting, to be sent before anything in buf
+  uint8_t  rt[MIDI_OUT_RT_SZ];
+  uint32_t rt_head;
+  uint32_t rt_tail;
+
+  // When forwarded messages were received, and the buf index just
+  // past each one, to measure latency when they are drained
+  uint32_t stamp_pos[MIDI_OUT_STAMPS];
+  uint32_t stamp_time[MIDI_OUT_STAMPS];
+  uint32_t stamp_head;
+  uint32_t stamp_tail;
+
+  // Statistics
+  uint32_t messages;      // Messages queued (not counting real-time)
+  uint32_t realtime;      // Real-time bytes queued
+  uint32_t dropped;       // Messages & real-time bytes that did not fit
+  uint32_t dropped_bytes; // Bytes those would have taken
+  uint32_t forwarded;     // Messages sent with midi_out_forward()
+  uint32_t status_saved;  // Status bytes left out thanks to running status
+  uint32_t bytes_sent;    // Bytes handed to the port, i.e., wire time used
+  // Forwarding latency, receipt to drain, in the caller's time units
+  uint32_t latency_count;
+  uint32_t latency_max;
+  uint64_t latency_total;
+} midi_out_t;
+
+void midi_out_init(midi_out_t *mo);
+size_t midi_out_encode(midi_out_t *mo, const midi_message *mm, uint8_t *out);
+bool midi_out_send(midi_out_t *mo, const midi_message *mm);
+bool midi_out_realtime(midi_out_t *mo, uint8_t b);
+bool midi_out_forward(midi_out_t *mo, const midi_message *mm, uint32_t received);
+size_t midi_out_drain(midi_out_t *mo, uint8_t *dst, size_t max, uint32_t now);
+
+/** Bytes waiting to be drained */
+static inline size_t midi_out_pending(const midi_out_t *mo) {
+  return (mo->head - mo->tail) + (mo->rt_head - mo->rt_tail);
+}
+
+/** Wire time used so far, in milliseconds */
+static inline uint32_t midi_out_wire_ms(const midi_out_t *mo) {
+  return (uint32_t)((uint64_t)mo->bytes_sent * MIDI_OUT_US_PER_BYTE / 1000);
+}
+
+#endif /* INC_MIDIOUT_H_ */
@@ -0,0 +1,53 @@
+/*
+ * midiq.h
+ *
+ *  Created on: 2025-03-28
+ *  Updated on: 2025-04-10
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Fixed size, lock-free, single-producer/single-consumer queue of
+ * timestamped MIDI messages.
+ */
+
+#ifndef INC_MIDIQ_H_
+#define INC_MIDIQ_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "midi.h"
+
+// Must be a power of 2
+#define MIDIQ_SIZE 64
+
+typedef struct midiq_event {
+  uint32_t timestamp; // When it was received (DWT cycles)
+  uint8_t port;       // Where it came from
+  midi_message msg;
+} midiq_event_t;
+
+typedef struct midiq {
+  midiq_event_t events[MIDIQ_SIZE];
+  // Free running counts; only the producer writes head and
+  // only the consumer writes tail
+  volatile uint32_t head;
+  volatile uint32_t tail;
+
+  // Statistics, kept by the producer
+  uint32_t pushed;
+  uint32_t overflows;  // Events dropped because the queue was full
+  uint32_t high_water; // Deepest the queue has been
+} midiq_t;
+
+void midiq_init(midiq_t *q);
+bool midiq_push(midiq_t *q, uint32_t timestamp, uint8_t port, const midi_message *msg);
+bool midiq_pop(midiq_t *q, midiq_event_t *event);
+
+/** How many events are waiting. Either side may call this. */
+static inline uint32_t midiq_depth(const midiq_t *q) {
+  return q->head - q->tail;
+}
+
+#endif /* INC_MIDIQ_H_ */
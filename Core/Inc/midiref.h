@@ -0,0 +1,49 @@
+/*
+ * midiref.h
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-11
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * A deliberately simple reference MIDI decoder, written from the MIDI
+ * 1.0 spec, to check the real parser (midi.c) against: on the device
+ * by midibench.c and on a host by the fuzz harness in Tools/midifuzz.
+ */
+
+#ifndef INC_MIDIREF_H_
+#define INC_MIDIREF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "midi.h"
+
+// SysEx payloads, as a length and hash, and how they ended
+typedef struct midiref_tally {
+  uint32_t bytes;
+  uint32_t hash;
+  uint32_t complete;
+  uint32_t truncated;
+} midiref_tally_t;
+
+typedef struct midiref_decoder {
+  uint8_t status;   // Current status (running or system common), 0 if none
+  uint8_t count;    // Data bytes collected so far
+  uint8_t data[2];
+  midiref_tally_t sysex;
+} midiref_decoder_t;
+
+void midiref_tally_init(midiref_tally_t *t);
+void midiref_tally_bytes(midiref_tally_t *t, const uint8_t *data, size_t len);
+int midiref_tallies_match(const midiref_tally_t *a, const midiref_tally_t *b);
+// midi_sysex_handler_t callbacks, with a midiref_tally_t as ctx
+void midiref_tally_data(void *ctx, const uint8_t *data, size_t len);
+void midiref_tally_end(void *ctx, size_t total_len, int complete);
+
+void midiref_init(midiref_decoder_t *rd);
+int midiref_data_length(uint8_t status);
+int midiref_receive(midiref_decoder_t *rd, uint8_t b, midi_message *mm);
+int midiref_messages_match(const midi_message *a, const midi_message *b);
+
+#endif /* INC_MIDIREF_H_ */
@@ -0,0 +1,88 @@
+/*
+ * midiroute.h
+ *
+ *  Created on: 2025-04-01
+ *  Updated on: 2025-04-01
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * MIDI filtering and routing: per-route rules (channels, message
+ * types, notes, controllers) compiled into lookup tables, so routing
+ * a message is two table lookups and an AND.
+ */
+
+#ifndef INC_MIDIROUTE_H_
+#define INC_MIDIROUTE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "midi.h"
+
+// Where received messages can go; one bit each
+#define MIDI_ROUTES 4
+#define MIDI_ROUTE_SYNTH   ((uint8_t)0x01)
+#define MIDI_ROUTE_THRU    ((uint8_t)0x02)
+#define MIDI_ROUTE_MONITOR ((uint8_t)0x04) // Serial console
+#define MIDI_ROUTE_DISPLAY ((uint8_t)0x08)
+
+// Message type bits for midi_route_rule_t.types
+#define MIDI_ROUTE_T_NOTE_OFF   (1 << 0)
+#define MIDI_ROUTE_T_NOTE_ON    (1 << 1)
+#define MIDI_ROUTE_T_POLY_AT    (1 << 2)
+#define MIDI_ROUTE_T_CC         (1 << 3)
+#define MIDI_ROUTE_T_PROGRAM    (1 << 4)
+#define MIDI_ROUTE_T_CHAN_AT    (1 << 5)
+#define MIDI_ROUTE_T_PITCH_BEND (1 << 6)
+#define MIDI_ROUTE_T_COMMON     (1 << 7)  // System common
+#define MIDI_ROUTE_T_CLOCK      (1 << 8)  // 0xF8
+#define MIDI_ROUTE_T_TRANSPORT  (1 << 9)  // Start, Continue, Stop
+#define MIDI_ROUTE_T_OTHER_RT   (1 << 10) // Active Sensing, Reset, undefined
+#define MIDI_ROUTE_T_ALL        ((1 << 11) - 1)
+
+// What one route accepts: a message has to pass all that apply to it
+typedef struct midi_route_rule {
+  uint16_t channels; // Bit n: channel n (0-15)
+  uint16_t types;    // MIDI_ROUTE_T_xxx
+  uint32_t notes[4]; // Bit n: note n; for Note Off/On & Poly Aftertouch
+  uint32_t ccs[4];   // Bit n: controller n; for Control Change
+} midi_route_rule_t;
+
+// Rows of by_data
+#define MIDI_ROUTE_ROW_ANY  0
+#define MIDI_ROUTE_ROW_NOTE 1
+#define MIDI_ROUTE_ROW_CC   2
+
+typedef struct midi_router {
+  midi_route_rule_t rules[MIDI_ROUTES];
+
+  // Compiled from the rules by midi_router_compile()
+  uint8_t by_status[256];  // Routes taking each status (type & channel)
+  uint8_t data_row[256];   // Which row of by_data applies to data1
+  uint8_t by_data[3][128]; // Routes taking each data1 value
+
+  // Statistics
+  uint32_t routed[MIDI_ROUTES];
+  uint32_t rejected;       // Messages no route took
+} midi_router_t;
+
+void midi_router_init(midi_router_t *r);
+void midi_router_compile(midi_router_t *r);
+int midi_router_command(midi_router_t *r, const char *cmd);
+int midi_router_snprintf(char *str, size_t size, const midi_router_t *r, int route);
+const char *midi_router_name(int route);
+
+/** The routes a message goes to (MIDI_ROUTE_xxx bits), counted. */
+static inline uint8_t midi_route(midi_router_t *r, const midi_message *mm) {
+  uint8_t routes = r->by_status[mm->type] &
+                   r->by_data[r->data_row[mm->type]][mm->data1 & 0x7F];
+
+  r->routed[0] += routes & 1;
+  r->routed[1] += (routes >> 1) & 1;
+  r->routed[2] += (routes >> 2) & 1;
+  r->routed[3] += (routes >> 3) & 1;
+  r->rejected += routes == 0;
+  return routes;
+}
+
+#endif /* INC_MIDIROUTE_H_ */
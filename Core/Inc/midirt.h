@@ -0,0 +1,27 @@
+/*
+ * midirt.h
+ *
+ *  Created on: 2025-03-31
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * MIDI real-time fast path: real-time bytes are picked out of the
+ * received bytes before parsing and handled right away, each stamped
+ * with when it came in.
+ */
+
+#ifndef INC_MIDIRT_H_
+#define INC_MIDIRT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Gets each real-time byte (0xF8-0xFF) found, with when it came in (DWT cycles)
+typedef void (*midirt_handler_t)(void *ctx, uint32_t timestamp, uint8_t status);
+
+size_t midirt_scan(const uint8_t *buf, size_t len, uint32_t last, uint32_t byte_cycles,
+                   midirt_handler_t handler, void *ctx);
+
+#endif /* INC_MIDIRT_H_ */
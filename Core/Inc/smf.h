@@ -0,0 +1,76 @@
+/*
+ * smf.h
+ *
+ *  Created on: 2025-04-02
+ *  Updated on: 2025-04-02
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Standard MIDI File (type 0 & 1) player, reading the file image in
+ * place (e.g., from flash) and scheduling events to the sample.
+ */
+
+#ifndef INC_SMF_H_
+#define INC_SMF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "midi.h"
+
+#define SMF_MAX_TRACKS 16
+
+// Default tempo until a Set Tempo meta event: 120 BPM
+#define SMF_DEFAULT_TEMPO 500000
+
+typedef struct smf_track {
+  const uint8_t *pos;    // Next byte to parse
+  const uint8_t *end;
+  uint32_t next_tick;    // Absolute tick of the next event
+  uint8_t running_status;
+} smf_track_t;
+
+typedef struct smf_event {
+  uint64_t sample;       // When, in samples from the start
+  uint32_t tick;
+  midi_message msg;
+} smf_event_t;
+
+typedef struct smf_player {
+  uint32_t sample_rate;
+  uint16_t format;
+  uint16_t division;     // Ticks per quarter note
+  uint8_t  num_tracks;
+
+  smf_track_t tracks[SMF_MAX_TRACKS];
+  // Min-heap of tracks with events left, by next_tick then track #
+  uint8_t heap[SMF_MAX_TRACKS];
+  uint8_t heap_size;
+
+  // Tempo map: the current tempo and where it took effect
+  uint32_t tempo;        // Microseconds per quarter note
+  uint32_t tempo_tick;
+  uint64_t tempo_sample;
+
+  // Playing (smf_play_block)
+  uint64_t sample_now;   // Samples rendered so far
+  bool     have_event;
+  smf_event_t event;     // Next event, when have_event
+
+  // Statistics
+  uint32_t events;       // MIDI events produced
+  uint32_t tempo_changes;
+  uint32_t errors;       // Malformed tracks, cut short
+} smf_player_t;
+
+int smf_open(smf_player_t *p, const uint8_t *image, size_t len, uint32_t sample_rate);
+bool smf_next_event(smf_player_t *p, smf_event_t *ev);
+bool smf_play_block(smf_player_t *p, int16_t *buf, size_t samples);
+
+/** Is there anything left to play? */
+static inline bool smf_done(const smf_player_t *p) {
+  return !p->have_event && p->heap_size == 0;
+}
+
+#endif /* INC_SMF_H_ */
@@ -2,7 +2,7 @@
  * spidma.h
  *
  *  Created on: 2024-11-11
- *  Updated on: 2024-11-16
+ *  Updated on: 2025-04-12
  *      Author: Douglas P. Fields, Jr. - symbolics@lisp.engineer
  *   Copyright: 2024, Douglas P. Fields, Jr.
  *     License: Apache 2.0
@@ -12,8 +12,8 @@
  * Configurable items in this file:
  * 1. Number of queue entries in the SPIDMA queue
  *    * This must be a multiple of 2
- * 2. TODO: define if you want various counters enabled
- *    (useful for debugging)
+ * 2. SPIDMA_STATISTICS: define if you want the bus timing
+ *    statistics kept (useful for debugging and tuning)
  */
 
 #ifndef INC_SPIDMA_H_
@@ -23,6 +23,11 @@
 #define SPI_ENTRY_MASK  ((size_t)0xFF)  // A mask of the number of bits to hold the value above from 0 to that minus 1
 typedef uint16_t spiq_size_t;
 
+// Comment this out to remove the bus timing statistics
+#define SPIDMA_STATISTICS
+// Queue depth histogram buckets: 0, 1, 2-3, 4-7, ... 128-255
+#define SPIDMA_DEPTH_BUCKETS 9
+
 typedef enum spidma_entry_type {
   SPIDMA_DATA,      // Set the D/C flag to Data - and send data
   SPIDMA_COMMAND,   // Set the D/C flag to Command - and send data
@@ -86,6 +91,44 @@ typedef struct spidma_entry {
   uint8_t  should_free;
 } spidma_entry_t;
 
+/*
+ * Timing statistics for the SPI bus, all in CPU cycles
+ * (see cyclecount.h). These are kept so we can see how much
+ * of the time the display bus actually moves data, and how much
+ * it sits idle between queue entries.
+ *
+ * A "gap" is the time from one DMA completion to the start of
+ * the next DMA. If the queue still had entries waiting when the
+ * DMA completed, the gap is pure per-entry overhead (backlogged);
+ * otherwise we were just waiting for work (starved).
+ */
+typedef struct spidma_stats {
+  // When these statistics started being collected, in cycles and
+  // in HAL ticks, which count the cycle counter's wraps
+  uint32_t window_start;
+  uint32_t window_start_tick;
+  // DMA transfers started and total bytes sent by them
+  uint32_t dma_starts;
+  uint64_t bytes_sent;
+  // Time from DMA start to the transfer complete interrupt
+  uint64_t busy_cycles;
+  // Time spent in HAL_SPI_Transmit_DMA() setting up each transfer
+  uint64_t setup_cycles;
+  // Idle time between DMAs, split by whether there was work waiting
+  uint64_t backlogged_gap_cycles;
+  uint64_t starved_gap_cycles;
+  uint32_t max_backlogged_gap;
+  // Queue length seen at each DMA start
+  spiq_size_t max_depth;
+  uint32_t depth_histogram[SPIDMA_DEPTH_BUCKETS];
+
+  // Internal state between start and completion
+  uint32_t last_start;
+  uint32_t last_complete;
+  uint8_t  last_backlogged;
+  uint8_t  seen_complete;
+} spidma_stats_t;
+
 /*
  * This contains everything we need to manage an SPI
  * connected display with additional GPIO pins for
@@ -124,6 +167,8 @@ typedef struct spidma_config {
   // and the associated transfer DMA
   SPI_HandleTypeDef *spi;
   DMA_HandleTypeDef *dma_tx;
+  // The transfer DMA's interrupt, which runs our completion callback
+  IRQn_Type dma_tx_irqn;
 
   // TODO: Flag set when we're sending - reset by interrupt
   // Just before we do anything using DMA, we set this to what we're doing,
@@ -162,6 +207,10 @@ typedef struct spidma_config {
 
   uint32_t    mem_frees;
   uint32_t    backup_frees;
+
+#ifdef SPIDMA_STATISTICS
+  spidma_stats_t stats;
+#endif
 } spidma_config_t;
 
 
@@ -201,6 +250,10 @@ uint32_t spidma_empty_queue(spidma_config_t *spi);
 spidma_return_value_t spidma_free_queue(spidma_config_t *spi, void *buff);
 void *spidma_free_dequeue(spidma_config_t *spi);
 
+// Bus timing statistics (no-ops without SPIDMA_STATISTICS)
+void spidma_stats_reset(spidma_config_t *spi);
+uint64_t spidma_stats_elapsed(spidma_config_t *spi);
+
 // TODO: Function to drain the SPI queue in a busy loop
 
 #endif /* INC_SPIDMA_H_ */
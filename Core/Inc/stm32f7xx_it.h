@@ -71,7 +71,10 @@ void DMA2_Stream7_IRQHandler(void);
 /* USER CODE BEGIN EFP */
 
 void ll_usart_interrupt_handler(USART_TypeDef *u);
-void usart_dma_transfer_complete(USART_TypeDef *usartx);
+void USART1_IRQHandler(void);
+void USART2_IRQHandler(void);
+void USART3_IRQHandler(void);
+void USART6_IRQHandler(void);
 
 /* USER CODE END EFP */
 
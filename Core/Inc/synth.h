@@ -2,7 +2,7 @@
  * synth.h
  *
  *  Created on: 2025-03-16
- *  Updated on: 2025-03-16
+ *  Updated on: 2025-04-09
  *      Author: Douglas P. Fields, Jr.
  *   Copyright: 2025, Douglas P. Fields, Jr.
  *     License: Apache 2.0
@@ -42,6 +42,20 @@ typedef struct synth_voice {
   // When did the note off happen?
 } synth_voice_t;
 
+// The voices; only synth.c changes them (telemetry reads them)
+extern synth_voice_t voices[SYNTH_POLYPHONY];
+
+// Voice allocation counts, since boot
+typedef struct synth_stats {
+  uint32_t note_ons;
+  uint32_t note_offs;
+  uint32_t retriggers;  // Note on for a note already playing
+  uint32_t no_voice;    // Note on with every voice busy: not played
+  uint32_t stray_offs;  // Note off for a note not playing
+} synth_stats_t;
+
+extern synth_stats_t synth_stats;
+
 // Initialize our synthesizer engine
 void synth_init(uint16_t sample_rate);
 
@@ -54,5 +68,11 @@ void synth_check();
 // Fill up an output sound buffer with a specified # of samples
 void synth_fill(int16_t *buf, size_t samples);
 
+// Tempo-synced beat position (for LFOs, delays): where the beat
+// should be after the next samples are filled, in Q32.32 beats;
+// epoch changes when the position jumps
+void synth_set_beat(uint64_t target, uint32_t epoch, size_t samples);
+uint64_t synth_beat(void);
+
 
 #endif /* INC_SYNTH_H_ */
@@ -0,0 +1,49 @@
+/*
+ * synthcheck.h
+ *
+ *  Created on: 2025-03-23
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Bit-exact golden audio regression check for the synth.
+ */
+
+#ifndef INC_SYNTHCHECK_H_
+#define INC_SYNTHCHECK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Samples rendered per synth_fill() call (half our I2S buffer)
+// and blocks rendered per scenario
+#define SYNTHCHECK_BLOCK_SZ     128
+#define SYNTHCHECK_BLOCKS       16
+#define SYNTHCHECK_SAMPLE_RATE  32000
+#define SYNTHCHECK_SAMPLES      (SYNTHCHECK_BLOCK_SZ * SYNTHCHECK_BLOCKS)
+
+typedef struct synthcheck_result {
+  // How many scenarios were run and how many failed
+  uint32_t scenarios;
+  uint32_t failures;
+  // For the first failure: the scenario number and the
+  // sample range of the first block that differs (the host
+  // check in Tools/synthcheck finds the exact sample)
+  int32_t  failed_scenario;
+  uint32_t first_bad_sample;
+  uint32_t last_bad_sample;
+} synthcheck_result_t;
+
+extern const size_t synthcheck_num_scenarios;
+extern const char *synthcheck_scenario_names[];
+extern const uint32_t synthcheck_golden[][SYNTHCHECK_BLOCKS];
+
+// Render one scenario and hash each block of output, optionally
+// keeping the samples too
+void synthcheck_render(size_t scenario, uint32_t *block_hashes, int16_t *samples);
+// Render all scenarios and compare against the golden hashes.
+// This resets the synth.
+void synthcheck_run(synthcheck_result_t *result);
+
+#endif /* INC_SYNTHCHECK_H_ */
@@ -0,0 +1,28 @@
+/*
+ * sysmem.h
+ *
+ *  Created on: 2025-03-25
+ *  Updated on: 2025-03-25
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Heap break statistics from our _sbrk() (sysmem.c).
+ */
+
+#ifndef INC_SYSMEM_H_
+#define INC_SYSMEM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct sysmem_stats {
+  size_t   heap_size;      // Bytes between _end and _eheap
+  size_t   heap_brk;       // Bytes currently given to newlib
+  size_t   heap_brk_peak;  // Most bytes ever given to newlib
+  uint32_t sbrk_failures;  // Requests refused with ENOMEM
+} sysmem_stats_t;
+
+void sysmem_get_stats(sysmem_stats_t *stats);
+
+#endif /* INC_SYSMEM_H_ */
@@ -0,0 +1,155 @@
+/*
+ * telem.h
+ *
+ *  Created on: 2025-04-08
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Binary telemetry stream: periodic snapshots of the system state,
+ * profiling zones and (optionally) decimated audio, sent over the
+ * console as COBS frames with a CRC, and turned into CSV and plots on
+ * the host by Tools/telemrx.py.
+ */
+
+#ifndef INC_TELEM_H_
+#define INC_TELEM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "cyclecount.h"
+#include "synth.h"
+
+// Snapshot every this many ms while streaming
+#define TELEM_PERIOD_MS 100
+// Audio frames carry every TELEM_AUDIO_DECIMATE'th sample, this many at a time
+#define TELEM_AUDIO_DECIMATE 16
+#define TELEM_AUDIO_SAMPLES  64
+
+// Largest frame: delimiters, COBS overhead, payload and CRC
+#define TELEM_FRAME_MAX(payload) (2 + 1 + ((payload) + 2) / 254 + (payload) + 2)
+
+/* Payload types and layout version. Keep these and the structures
+ * below in sync with Tools/telemrx.py.
+ */
+#define TELEM_SNAPSHOT 1
+#define TELEM_AUDIO    2
+#define TELEM_VERSION  2
+
+// Profiling zones: where the main loop spends its time
+typedef enum telem_zone_id {
+  TELEM_ZONE_LOOP,     // A whole main loop
+  TELEM_ZONE_AUDIO,    // fill_i2s_data()
+  TELEM_ZONE_MIDI_IN,  // check_midi_input()
+  TELEM_ZONE_DISPLAY,  // spidma_check_activity()
+  TELEM_ZONES
+} telem_zone_id_t;
+
+typedef struct telem_zone {
+  uint32_t count;   // Times through the zone since the last snapshot
+  uint32_t total;   // Cycles in it
+  uint32_t max;     // Longest once
+} telem_zone_t;
+
+// All little endian, as it is sent
+typedef struct __attribute__((packed)) telem_header {
+  uint8_t  type;    // TELEM_SNAPSHOT or TELEM_AUDIO
+  uint8_t  version; // TELEM_VERSION
+  uint16_t seq;     // Per type, to spot lost frames
+  uint32_t cycles;  // DWT cycle count when taken
+  uint32_t ms;      // HAL tick when taken
+} telem_header_t;
+
+typedef struct __attribute__((packed)) telem_voice {
+  uint8_t  on;
+  uint8_t  note;
+  int16_t  ampl;
+  uint32_t freq;    // Hz
+} telem_voice_t;
+
+typedef struct __attribute__((packed)) telem_snapshot {
+  telem_header_t hdr;
+  uint32_t cpu_hz;
+  telem_voice_t voices[SYNTH_POLYPHONY];
+
+  // Counters, since boot
+  uint32_t midi_rx_bytes;
+  uint32_t midi_rx_lost;
+  uint32_t synth_msgs;
+  uint32_t synth_dropped;
+  uint32_t rt_msgs;
+  uint32_t midi_out_msgs;
+  uint32_t midi_out_dropped;
+  uint32_t console_dropped;
+  uint32_t log_dropped;
+  uint32_t spi_queue_failures;
+  uint32_t loops_per_tick;
+
+  // Queue depths, now
+  uint16_t synth_queue;
+  uint16_t midi_out_queue;
+  uint16_t console_tx;
+  uint16_t spi_queue;
+  uint16_t log_queue;
+
+  // Since the last snapshot
+  telem_zone_t zones[TELEM_ZONES];
+} telem_snapshot_t;
+
+typedef struct __attribute__((packed)) telem_audio {
+  telem_header_t hdr;
+  uint32_t first;   // Sample number of samples[0], before decimation
+  uint16_t decimate;
+  uint16_t count;
+  int16_t  samples[TELEM_AUDIO_SAMPLES];
+} telem_audio_t;
+
+typedef struct telem_state {
+  bool streaming;
+  bool audio;
+  uint32_t last_ms;
+  uint16_t seq[3];         // Next, by type
+
+  // Decimated audio being collected
+  telem_audio_t audio_frame;
+  uint16_t audio_count;    // Samples in it so far
+  uint32_t audio_sample;   // Samples seen, before decimation
+  bool audio_ready;
+
+  // Statistics
+  uint32_t frames;
+  uint32_t dropped;        // Frames that did not fit in the console
+  uint32_t bytes;
+} telem_state_t;
+
+extern telem_state_t telem;
+extern telem_zone_t telem_zones[TELEM_ZONES];
+
+void telem_init(void);
+uint16_t telem_crc16(const uint8_t *data, size_t len);
+size_t telem_frame(uint8_t *out, size_t out_sz, const void *payload, size_t len);
+void telem_header(telem_header_t *hdr, uint8_t type, uint32_t now_ms);
+void telem_set_streaming(bool on, uint32_t now_ms);
+void telem_take_zones(telem_snapshot_t *snap);
+void telem_audio_add(const int16_t *buf, size_t samples);
+const telem_audio_t *telem_audio_take(uint32_t now_ms);
+
+/** Starts timing a zone; pass what this returns to telem_zone_end() */
+static inline uint32_t telem_zone_begin(void) {
+  return cyclecount_now();
+}
+
+static inline void telem_zone_end(telem_zone_id_t zone, uint32_t start) {
+  uint32_t cycles = cyclecount_now() - start;
+  telem_zone_t *z = &telem_zones[zone];
+
+  z->count++;
+  z->total += cycles;
+  if (cycles > z->max) {
+    z->max = cycles;
+  }
+}
+
+#endif /* INC_TELEM_H_ */
@@ -0,0 +1,68 @@
+/*
+ * tempo.h
+ *
+ *  Created on: 2025-03-30
+ *  Updated on: 2025-03-30
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * MIDI clock tempo tracker: filters timestamped clock ticks into a
+ * tempo and a smooth beat position, following Start/Stop/Continue
+ * and Song Position Pointer.
+ */
+
+#ifndef INC_TEMPO_H_
+#define INC_TEMPO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "midi.h"
+
+// MIDI clocks per quarter note (beat), and per MIDI beat (16th note)
+#define TEMPO_PPQN 24
+#define TEMPO_CLOCKS_PER_SPP 6
+
+// Clocks further apart than at this tempo mean the clock stopped
+#define TEMPO_MIN_BPM 20
+
+// Filter gains as shifts: phase 1/4, period 1/32 (about critically damped)
+#define TEMPO_ALPHA_SHIFT 2
+#define TEMPO_BETA_SHIFT  5
+
+typedef struct tempo {
+  uint32_t cpu_hz;        // Timestamp ticks per second
+
+  // Clock filter
+  bool     locked;        // We have a period estimate
+  uint32_t last_clock;    // Raw timestamp of the last clock
+  uint32_t est_clock;     // Filtered timestamp of the last clock
+  uint64_t period_q16;    // Filtered timestamp ticks per clock, Q16
+
+  // Transport
+  bool     running;       // Between Start/Continue and Stop
+  bool     ticking;       // A clock has come since Start/Continue
+  uint32_t position;      // Song position of the last clock, in clocks
+  uint32_t next_position; // Song position of the next clock
+  uint64_t hold;          // Beat position while not ticking, Q32.32
+  uint64_t last_beat;     // Last beat position handed out, Q32.32
+  uint32_t epoch;         // Changes whenever the position jumps
+
+  // Statistics
+  uint32_t clocks;
+  uint32_t resyncs;       // Clocks too far off to be filtered
+  uint32_t jitter_max;    // Largest clock error filtered, in timestamp ticks
+} tempo_t;
+
+void tempo_init(tempo_t *t, uint32_t cpu_hz);
+void tempo_clock(tempo_t *t, uint32_t now);
+void tempo_start(tempo_t *t);
+void tempo_continue(tempo_t *t, uint32_t now);
+void tempo_stop(tempo_t *t, uint32_t now);
+void tempo_song_position(tempo_t *t, uint16_t spp);
+bool tempo_process_midi(tempo_t *t, const midi_message *mm, uint32_t received);
+uint64_t tempo_beat(tempo_t *t, uint32_t now);
+uint32_t tempo_bpm_x100(const tempo_t *t);
+
+#endif /* INC_TEMPO_H_ */
@@ -0,0 +1,115 @@
+/*
+ * trace.h
+ *
+ *  Created on: 2025-03-24
+ *  Updated on: 2025-03-24
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Binary event trace ring: timestamped 8-byte events recorded from
+ * the main loop and from interrupts, dumped in binary over the serial
+ * console and converted on the host with Tools/trace2chrome.py.
+ */
+
+#ifndef INC_TRACE_H_
+#define INC_TRACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "stm32f7xx.h"
+#include "cyclecount.h"
+
+// Comment this out to compile all TRACE() calls away
+#define USE_TRACE
+
+// Number of events kept in the ring; must be a power of 2
+#define TRACE_ENTRIES 512
+
+// Dump stream identifier, followed by the rest of trace_dump_header_t
+#define TRACE_MAGIC "TRC1"
+
+/* Event ids. Keep these in sync with Tools/trace2chrome.py.
+ * The arguments of each are noted.
+ */
+typedef enum trace_event_id {
+  TRACE_NONE = 0,
+  TRACE_ISR_ENTER,      // arg8: IRQn
+  TRACE_ISR_EXIT,       // arg8: IRQn
+  TRACE_DMA_START,      // arg8: TRACE_DMA_ID, arg16: bytes
+  TRACE_DMA_COMPLETE,   // arg8: TRACE_DMA_ID
+  TRACE_AUDIO_FILL_BEGIN, // arg8: buffer half, arg16: samples
+  TRACE_AUDIO_FILL_END,   // arg8: buffer half
+  TRACE_MIDI_MESSAGE,   // arg8: message type, arg16: data1 | data2 << 8
+  TRACE_SPI_ENTRY,      // arg8: SPIDMA_xxx entry type, arg16: buff_size
+  TRACE_MARK            // arg8, arg16: anything
+} trace_event_id_t;
+
+/* Identify a DMA stream for TRACE_DMA_xxx events:
+ * DMA1 streams are 0-7 and DMA2 streams are 8-15.
+ */
+#define TRACE_DMA_ID(dma, ll_stream) ((dma) == DMA2 ? 8 + (ll_stream) : (ll_stream))
+
+typedef struct trace_record {
+  uint32_t timestamp; // DWT cycle count
+  uint8_t  event;     // trace_event_id_t
+  uint8_t  arg8;
+  uint16_t arg16;
+} trace_record_t;
+
+/* What we send before the records in a dump; all little endian. */
+typedef struct trace_dump_header {
+  char     magic[4];  // TRACE_MAGIC
+  uint32_t cpu_hz;    // Timestamp cycles per second
+  uint16_t count;     // Records which follow, oldest first
+  uint16_t record_sz; // sizeof(trace_record_t)
+  uint32_t lost;      // Older records overwritten before the dump
+} trace_dump_header_t;
+
+extern trace_record_t trace_ring[TRACE_ENTRIES];
+extern volatile uint32_t trace_head;
+extern volatile uint32_t trace_enabled;
+
+void trace_init(void);
+
+// Dumping: stops tracing until the dump is fully consumed
+void trace_dump_begin(void);
+int trace_dump_active(void);
+size_t trace_dump_peek(const uint8_t **data);
+void trace_dump_consume(size_t bytes);
+
+/** Records one event. Lock free, so it is safe to call from any
+ * interrupt priority: the slot is reserved with LDREX/STREX, so a
+ * preempting writer simply takes the next slot.
+ */
+static inline void trace_event(uint8_t event, uint8_t arg8, uint16_t arg16) {
+  uint32_t slot;
+  trace_record_t *r;
+
+  if (!trace_enabled) {
+    return;
+  }
+
+  do {
+    slot = __LDREXW(&trace_head);
+  } while (__STREXW(slot + 1, &trace_head) != 0);
+
+  r = &trace_ring[slot & (TRACE_ENTRIES - 1)];
+  r->timestamp = cyclecount_now();
+  r->event = event;
+  r->arg8 = arg8;
+  r->arg16 = arg16;
+}
+
+/** The stream number of a HAL DMA handle, as a TRACE_DMA_ID */
+static inline uint8_t trace_hal_dma_id(const DMA_Stream_TypeDef *s) {
+  return s >= DMA2_Stream0 ? 8 + (s - DMA2_Stream0) : (s - DMA1_Stream0);
+}
+
+#ifdef USE_TRACE
+#  define TRACE(event, arg8, arg16) trace_event((event), (arg8), (arg16))
+#else
+#  define TRACE(event, arg8, arg16) ((void)0)
+#endif
+
+#endif /* INC_TRACE_H_ */
@@ -2,7 +2,7 @@
  * usartdma.h
  *
  *  Created on: 2024-11-17
- *  Updated on: 2024-11-23
+ *  Updated on: 2025-04-11
  *      Author: Douglas P. Fields, Jr.
  *   Copyright: 2024, Douglas P. Fields, Jr.
  *     License: Apache 2.0
@@ -11,9 +11,25 @@
 #ifndef INC_USARTDMA_H_
 #define INC_USARTDMA_H_
 
+#include <stdbool.h>
 #include "stm32f7xx_ll_usart.h"
 #include "stm32f7xx_ll_dma.h"
 
+// Transmit segments that can be queued (power of 2)
+#define UDCR_TX_SEGS 16
+// Bytes at the end of tx_buf used to send data the DMA can't read
+#define UDCR_TX_BOUNCE_SZ 32
+
+// Interrupt slots: an instance for each DMA stream, DMA1 streams 0-7
+// then DMA2 streams 0-7 (LL_DMA_STREAM_n is n)
+#define UDCR_DMA_SLOTS 16
+#define UDCR_SLOT(dma, stream) ((dma) == DMA2 ? 8 + (stream) : (stream))
+
+// Kinds of transmit segment
+#define UDCR_SEG_COPIED   1 // In tx_buf
+#define UDCR_SEG_BORROWED 2 // The caller's constant data, read by the DMA
+#define UDCR_SEG_BOUNCE   4 // The caller's constant data, copied a bit at a time
+
 
 typedef enum udcr_return_value {
   UDCR_OK,
@@ -23,6 +39,14 @@ typedef enum udcr_return_value {
 } udcr_return_value_t;
 
 
+/** Something queued to send: a run of bytes, and whose they are */
+typedef struct udcr_tx_seg {
+  const uint8_t *data;
+  uint32_t len;
+  uint32_t flags;  // UDCR_SEG_xxx
+} udcr_tx_seg_t;
+
+
 typedef struct usart_dma_config {
   // Creator set fields
 
@@ -37,45 +61,141 @@ typedef struct usart_dma_config {
   DMA_TypeDef *dma_tx;  // e.g., DMA1
   uint32_t dma_tx_stream;  // e.g., LL_DMA_STREAM_6
 
-  // Receive circular buffer
+  // Receive circular buffer. Size it so the main loop always reads
+  // everything before it fills: watch rx_peak under the worst stalls.
   uint8_t *rx_buf;
   size_t   rx_buf_sz;
 
-  // Transmit buffers 1 and 2 (same size)
-  uint8_t *tx_buf1;
-  uint8_t *tx_buf2;
+  // Transmit buffer, for copies of what is queued to send (and the
+  // bounce buffer, which is the last UDCR_TX_BOUNCE_SZ bytes of it)
+  uint8_t *tx_buf;
   size_t   tx_buf_sz;
 
+  // Optional event driven receive: the USART IDLE (line went quiet)
+  // and receive DMA half/complete interrupts count arrivals, so the
+  // main loop only has to look when udcr_rx_ready(). The interrupt
+  // handlers have to clear their flags and call usart_dma_rx_event().
+  // Only IDLE interrupts: RXNE and error interrupts must stay off, as
+  // the DMA reads every byte.
+  bool      rx_events;
+  IRQn_Type usart_irqn;  // e.g., USART2_IRQn
+
   // Library managed fields ////////////////////////////
 
   // What byte we should read next from circular rx_buf
   // (this is in units of LL_DMA_GetDataLength)
   uint32_t next_read_pos;
 
-  // Currently queueing buffer
-  uint8_t *tx_q_buf;
-  uint8_t *tx_q_next;
-  size_t   tx_q_sz_remain;
-
-  // Currently sending buffer
-  uint8_t *tx_send_buf;
-  size_t   tx_send_sz;
+  // Event driven receive: counted up by each receive interrupt, and
+  // the count when we had last read everything
+  volatile uint32_t rx_notify;
+  uint32_t rx_notify_seen;
+  // Bytes waiting as of the last receive interrupt
+  volatile uint32_t rx_available;
+  // What udcr_peek_spans() saw, for udcr_consume()
+  uint32_t rx_peek_notify;
+  size_t   rx_peek_write;
+
+  // Free running byte counts: received as of DMA position
+  // rx_last_write, and read. The receive interrupts (with rx_events)
+  // keep rx_total up to date at least every half buffer, which is how
+  // we know if the DMA has lapped us.
+  volatile uint32_t rx_total;
+  volatile uint32_t rx_last_write;
+  uint32_t rx_read_total;
+  // Receive statistics
+  uint32_t rx_overruns;  // Times the DMA lapped us
+  uint32_t rx_lost;      // Bytes dropped because of that
+  uint32_t rx_peak;      // Most bytes ever waiting to be read
+  // Overrun, framing and noise errors on the line: the USART
+  // interrupt handler has to count and clear these (see rx_events)
+  volatile uint32_t rx_line_errors;
+
+  // Segments to send, in order. Free running counts: the main loop
+  // adds at the head, and the DMA complete interrupt finishes them at
+  // the tail, then starts the next one right away.
+  udcr_tx_seg_t tx_segs[UDCR_TX_SEGS];
+  volatile uint32_t tx_seg_head;
+  volatile uint32_t tx_seg_tail;
+  uint32_t tx_seg_sent;  // Bytes of the tail segment already sent
+  uint32_t tx_send_sz;   // Bytes being sent now
+
+  // Copied bytes in tx_buf, which is a ring: free running counts of
+  // bytes copied in, and of those sent
+  uint32_t tx_buf_head;
+  volatile uint32_t tx_buf_tail;
 
   // Are we currently sending something via DMA?
   // This gets reset via interrupt
   volatile uint32_t is_sending;
+
+  // Transmit statistics
+  uint32_t tx_copied;    // Bytes copied into tx_buf
+  uint32_t tx_borrowed;  // Constant bytes sent without a copy
+  uint32_t tx_bounced;   // Constant bytes sent through the bounce buffer
+  uint32_t tx_dropped;   // Bytes that did not fit
+  uint32_t tx_chained;   // Sends started right from the complete interrupt
 } usart_dma_config_t;
 
 
+/** Received bytes waiting in rx_buf: up to two runs, oldest first
+ * (the second is used when they wrap around the end of rx_buf).
+ */
+typedef struct udcr_spans {
+  const uint8_t *buf[2];
+  size_t len[2];
+  size_t lost;  // Bytes dropped just before these, if the DMA lapped us
+} udcr_spans_t;
+
+
 udcr_return_value_t udcr_init(usart_dma_config_t *udcr);
 uint16_t udcr_read_byte(usart_dma_config_t *udcr);
 
+// Bulk receive functions
+size_t udcr_peek_spans(usart_dma_config_t *udcr, udcr_spans_t *spans);
+void udcr_consume(usart_dma_config_t *udcr, size_t n);
+
+/** Whether there may be received bytes to read: always, unless
+ * rx_events is set, in which case only after a receive interrupt.
+ */
+static inline bool udcr_rx_ready(const usart_dma_config_t *udcr) {
+  return !udcr->rx_events || udcr->rx_notify != udcr->rx_notify_seen;
+}
+
 // Transmit functions
 udcr_return_value_t udcr_send_from_queue(usart_dma_config_t *udcr);
 size_t udcr_queue_bytes(usart_dma_config_t *udcr, const uint8_t *buf, size_t buf_sz);
-
+size_t udcr_queue_const(usart_dma_config_t *udcr, const uint8_t *buf, size_t buf_sz);
+
+/** How many more bytes can be copied in by udcr_queue_bytes() right now */
+static inline size_t udcr_queue_space(const usart_dma_config_t *udcr) {
+  size_t ring_sz = udcr->tx_buf_sz - UDCR_TX_BOUNCE_SZ;
+  size_t free_bytes = ring_sz - (udcr->tx_buf_head - udcr->tx_buf_tail);
+  size_t to_end = ring_sz - udcr->tx_buf_head % ring_sz;
+  uint32_t free_segs = UDCR_TX_SEGS - (udcr->tx_seg_head - udcr->tx_seg_tail);
+
+  // Bytes that wrap around the end of the ring take two segments
+  if (free_segs >= 2) {
+    return free_bytes;
+  }
+  if (free_segs == 1) {
+    return free_bytes < to_end ? free_bytes : to_end;
+  }
+  return 0;
+}
+
+/** Whether anything queued has yet to be sent */
+static inline bool udcr_tx_pending(const usart_dma_config_t *udcr) {
+  return udcr->tx_seg_head != udcr->tx_seg_tail;
+}
+
+
+// What the DMA stream interrupt handlers call, from udcr_init()
+extern usart_dma_config_t *udcr_slots[UDCR_DMA_SLOTS];
 
 // DMA TX interrupt callback function
-void usart_dma_transfer_complete(USART_TypeDef *usartx);
+void usart_dma_transfer_complete(usart_dma_config_t *udcr);
+// USART IDLE and DMA RX half/complete interrupt callback function
+void usart_dma_rx_event(usart_dma_config_t *udcr);
 
 #endif /* INC_USARTDMA_H_ */
@@ -0,0 +1,37 @@
+/*
+ * cyclecount.c
+ *
+ *  Created on: 2025-03-22
+ *  Updated on: 2025-03-22
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Sets up the Cortex-M7 DWT cycle counter so we can time things
+ * with single CPU cycle resolution without using a hardware timer.
+ *
+ * See ARM DDI0489F (Cortex-M7 TRM) and ARMv7-M ARM C1.8 for the DWT.
+ */
+
+#include <stdint.h>
+#include "stm32f7xx.h"
+#include "cyclecount.h"
+
+// Magic value to unlock the DWT registers for writing (CoreSight)
+#define DWT_LAR_UNLOCK 0xC5ACCE55
+
+/** Turn on the trace system and then the DWT cycle counter.
+ * On the Cortex-M7 the DWT is locked at reset and has to be unlocked
+ * before CYCCNT can be enabled.
+ */
+void cyclecount_init(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->LAR = DWT_LAR_UNLOCK;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/** Convert a (short) cycle count into microseconds, rounding down. */
+uint32_t cyclecount_to_us(uint32_t cycles) {
+  return (uint32_t)(((uint64_t)cycles * 1000000) / SystemCoreClock);
+}
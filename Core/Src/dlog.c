@@ -0,0 +1,232 @@
+/*
+ * dlog.c
+ *
+ *  Created on: 2025-04-07
+ *  Updated on: 2025-04-07
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Deferred-format console logging.
+ *
+ * snprintf of a multi-field diagnostic costs thousands of cycles on
+ * the main loop, next to the audio deadline. DLOG() instead stores a
+ * frame of the format string's address, a timestamp and the raw 32
+ * bit arguments in a ring, which costs about as much as the copy.
+ *
+ * dlog_flush() then hands the caller whole frames to queue on the
+ * console. In binary mode they go out as they are, and the host
+ * decoder (Tools/dlogdecode.py) looks the format strings up in the
+ * ELF file's .dlog_fmt section and does the formatting there; frames
+ * are several times shorter than the text, too. In text mode, for a
+ * plain terminal, the frames are formatted here instead, one
+ * conversion at a time with snprintf, only when there is room to
+ * send the line.
+ *
+ * Raw text on the console may come between frames; the decoder
+ * passes anything that is not a valid frame through as text.
+ *
+ * When the ring is full, new messages are dropped whole and counted.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "realmain.h"
+#include "cyclecount.h"
+#include "dlog.h"
+
+FAST_BSS dlog_stats_t dlog_stats;
+
+FAST_BSS static uint8_t ring[DLOG_BUF_SZ];
+static uint32_t head;     // Free running byte counts
+static uint32_t tail;
+static uint8_t seq;
+static bool binary_mode;
+
+static inline void put32(uint8_t *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static inline uint32_t get32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void dlog_init(void) {
+  memset(&dlog_stats, 0, sizeof(dlog_stats));
+  head = tail = 0;
+  seq = 0;
+  binary_mode = false;
+}
+
+/** Binary frames or text from now on; anything waiting is sent the new way. */
+void dlog_set_binary(bool binary) {
+  binary_mode = binary;
+}
+
+bool dlog_binary(void) {
+  return binary_mode;
+}
+
+/** Bytes of frames waiting to be sent */
+size_t dlog_pending(void) {
+  return head - tail;
+}
+
+/** Records a message; use DLOG(), which counts the arguments and
+ * puts the format string where the decoder can find it.
+ */
+void dlog_write(uint32_t nargs, const char *fmt, ...) {
+  uint8_t frame[DLOG_FRAME_MAX];
+  size_t len, first;
+  va_list ap;
+
+  if (nargs > DLOG_MAX_ARGS) {
+    nargs = DLOG_MAX_ARGS;
+  }
+  len = DLOG_HDR_SZ + 4 * nargs;
+  if (DLOG_BUF_SZ - (head - tail) < len) {
+    // Still uses a sequence number, so the decoder sees the gap
+    seq++;
+    dlog_stats.dropped++;
+    return;
+  }
+
+  frame[0] = DLOG_SYNC;
+  frame[1] = nargs;
+  frame[2] = seq++;
+  frame[3] = 0; // Checksum is added when sent
+  put32(frame + 4, (uintptr_t)fmt);
+  put32(frame + 8, cyclecount_now());
+  va_start(ap, fmt);
+  for (uint32_t i = 0; i < nargs; i++) {
+    // Every argument takes one word
+    put32(frame + DLOG_HDR_SZ + 4 * i, (uint32_t)va_arg(ap, uintptr_t));
+  }
+  va_end(ap);
+
+  first = DLOG_BUF_SZ - (head & (DLOG_BUF_SZ - 1));
+  if (first > len) {
+    first = len;
+  }
+  memcpy(&ring[head & (DLOG_BUF_SZ - 1)], frame, first);
+  memcpy(ring, frame + first, len - first);
+  head += len;
+  dlog_stats.logged++;
+}
+
+/** Formats a frame into out like snprintf, but returns -1 if it does
+ * not fit. Handles the flags, width, precision and h/l length of the
+ * d i o u x X c s p conversions, and %%; not * widths.
+ */
+static int format_frame(char *out, size_t out_sz, const uint8_t *frame) {
+  const char *fmt = (const char *)(uintptr_t)get32(frame + 4);
+  uint32_t nargs = frame[1], arg = 0, value;
+  char spec[16];
+  size_t len = 0, s;
+  bool is_long;
+  char conv;
+  int l;
+
+  while (*fmt != '\0') {
+    if (*fmt != '%' || fmt[1] == '%') {
+      if (len + 1 >= out_sz) {
+        return -1;
+      }
+      out[len++] = *fmt;
+      fmt += *fmt == '%' ? 2 : 1;
+      continue;
+    }
+
+    // Copy the whole conversion specification
+    s = 0;
+    spec[s++] = *fmt++;
+    while (*fmt != '\0' && strchr("diouxXcsp", *fmt) == NULL && s < sizeof(spec) - 2) {
+      spec[s++] = *fmt++;
+    }
+    if (*fmt == '\0') {
+      break;
+    }
+    conv = *fmt++;
+    spec[s++] = conv;
+    spec[s] = '\0';
+    is_long = memchr(spec, 'l', s) != NULL;
+    value = arg < nargs ? get32(frame + DLOG_HDR_SZ + 4 * arg++) : 0;
+
+    if (conv == 's') {
+      l = snprintf(out + len, out_sz - len, spec, (const char *)(uintptr_t)value);
+    } else if (conv == 'p') {
+      l = snprintf(out + len, out_sz - len, spec, (void *)(uintptr_t)value);
+    } else if (conv == 'd' || conv == 'i') {
+      l = is_long ? snprintf(out + len, out_sz - len, spec, (long)(int32_t)value)
+                  : snprintf(out + len, out_sz - len, spec, (int)(int32_t)value);
+    } else {
+      l = is_long ? snprintf(out + len, out_sz - len, spec, (unsigned long)value)
+                  : snprintf(out + len, out_sz - len, spec, (unsigned int)value);
+    }
+    if (l < 0 || (size_t)l >= out_sz - len) {
+      return -1;
+    }
+    len += l;
+  }
+  return len;
+}
+
+/** Moves whole waiting messages into out (at most out_sz bytes), as
+ * binary frames or formatted text, and returns the length. out_sz
+ * should be at least DLOG_LINE_MAX; a text line longer than that is
+ * dropped.
+ */
+size_t dlog_flush(uint8_t *out, size_t out_sz) {
+  uint8_t frame[DLOG_FRAME_MAX];
+  size_t len = 0, flen, first;
+  uint8_t sum;
+  int l;
+
+  while (head != tail) {
+    flen = DLOG_HDR_SZ + 4 * ring[(tail + 1) & (DLOG_BUF_SZ - 1)];
+    first = DLOG_BUF_SZ - (tail & (DLOG_BUF_SZ - 1));
+    if (first > flen) {
+      first = flen;
+    }
+    memcpy(frame, &ring[tail & (DLOG_BUF_SZ - 1)], first);
+    memcpy(frame + first, ring, flen - first);
+
+    if (binary_mode) {
+      if (len + flen > out_sz) {
+        break;
+      }
+      sum = 0;
+      for (size_t i = 0; i < flen; i++) {
+        sum += frame[i];
+      }
+      frame[3] = -sum;
+      memcpy(out + len, frame, flen);
+      len += flen;
+      dlog_stats.frames++;
+    } else {
+      l = format_frame((char *)out + len, out_sz - len, frame);
+      if (l < 0) {
+        if (len > 0 || out_sz < DLOG_LINE_MAX) {
+          // Try again with more room
+          break;
+        }
+        // It will never fit
+        dlog_stats.dropped++;
+      } else {
+        len += l;
+        dlog_stats.lines++;
+      }
+    }
+    tail += flen;
+  }
+
+  dlog_stats.bytes += len;
+  return len;
+}
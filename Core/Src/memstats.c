@@ -0,0 +1,96 @@
+/*
+ * memstats.c
+ *
+ *  Created on: 2025-03-25
+ *  Updated on: 2025-03-25
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Measures memory use without destroying the system to find the
+ * limits (unlike alloc_test() and stack_overflow_test()), so that
+ * _DTCM_Stack_Size, _DMARAM_Size and the heap can be sized from data.
+ *
+ * Stack: at boot all of the stack below the current stack pointer is
+ * painted with a known pattern. The deepest the stack has ever been
+ * is then where the paint stops, scanning up from the bottom. This
+ * can under-report by a word if something happens to store the pattern.
+ *
+ * Heap: sysmem.c tracks the _sbrk() break, and newlib's mallinfo()
+ * says how much of that malloc has handed out.
+ *
+ * Static regions: from the linker script symbols.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <malloc.h>
+#include "stm32f7xx.h"
+#include "sysmem.h"
+#include "memstats.h"
+
+// Don't paint right up to the stack pointer
+#define PAINT_MARGIN 32
+
+// Linker script symbols - the addresses are the values
+extern uint32_t _estack;          // Top of the stack, start of FASTRAM
+extern uint8_t  _DTCM_Stack_Size;
+extern uint8_t  _DMARAM_Size;
+extern uint8_t  _sdata;           // Start of RAM, which is the end of DTCM
+extern uint8_t  _ebss;
+extern uint8_t  _efbss;
+extern uint8_t  _sdmadata;
+extern uint8_t  _edmabss;
+
+static inline uint32_t *stack_bottom(void) {
+  return (uint32_t *)((uint8_t *)&_estack - (size_t)&_DTCM_Stack_Size);
+}
+
+/** Paint everything below our caller's stack frame. This is a leaf,
+ * so it does not use any stack below where it starts painting.
+ */
+__attribute__((noinline))
+void memstats_paint_stack(void) {
+  uint32_t *p = stack_bottom();
+  uint32_t *end = (uint32_t *)(__get_MSP() - PAINT_MARGIN);
+
+  while (p < end) {
+    *p++ = MEMSTATS_STACK_PAINT;
+  }
+}
+
+/** Bytes of stack that have ever been used. */
+static size_t stack_peak(void) {
+  uint32_t *p = stack_bottom();
+
+  while (p < &_estack && *p == MEMSTATS_STACK_PAINT) {
+    p++;
+  }
+  return (uint8_t *)&_estack - (uint8_t *)p;
+}
+
+void memstats_get(memstats_t *ms) {
+  sysmem_stats_t ss;
+  struct mallinfo mi = mallinfo();
+
+  ms->stack_size = (size_t)&_DTCM_Stack_Size;
+  ms->stack_peak = stack_peak();
+  ms->stack_now = (uint8_t *)&_estack - (uint8_t *)__get_MSP();
+
+  sysmem_get_stats(&ss);
+  ms->heap_size = ss.heap_size;
+  ms->heap_brk = ss.heap_brk;
+  ms->heap_brk_peak = ss.heap_brk_peak;
+  ms->sbrk_failures = ss.sbrk_failures;
+
+  ms->malloc_in_use = mi.uordblks;
+  ms->malloc_free = mi.fordblks;
+
+  // FASTRAM runs from the top of the stack to the end of DTCM.
+  // Used includes the ._stack placeholder section the linker puts there.
+  ms->fastram_size = &_sdata - (uint8_t *)&_estack;
+  ms->fastram_used = &_efbss - (uint8_t *)&_estack;
+  ms->dmaram_size = (size_t)&_DMARAM_Size;
+  ms->dmaram_used = &_edmabss - &_sdmadata;
+  ms->ram_static = &_ebss - &_sdata;
+}
@@ -2,19 +2,24 @@
  * midi.c
  *
  *  Created on: 2024-09-08
- *  Updated on: 2025-01-18
+ *  Updated on: 2025-04-12
  *      Author: Douglas P. Fields, Jr.
- *   Copyright: 2024, Douglas P. Fields, Jr.
+ *   Copyright: 2024-2025, Douglas P. Fields, Jr.
  *     License: Apache 2.0
  *
  * Parses incoming MIDI messages into a persistent buffer, one
- * byte at a time. Handles running status.
+ * byte at a time or a span at a time. Handles running status.
+ * What each status byte means comes from midi_status_info[].
+ * SysEx payloads are streamed to a handler as they arrive, so
+ * large dumps never need a buffer of the full message size.
  *
  * For notes on MIDI: see MIDI.md
  */
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 #include "midi.h"
 
 // These are the frequencies of MIDI notes from
@@ -152,194 +157,247 @@ const uint32_t midi_note_freqX100[] = {
   1254385,
 };
 
+/* Status byte information, indexed by the byte. Data bytes are 0.
+ * Low bits are the number of data bytes; the rest is the class.
+ * Uses the GCC range designator extension.
+ */
+const uint8_t midi_status_info[256] = {
+    [0x80 ... 0xBF] = MIDI_SI_CHANNEL | 2, // Note off/on, poly AT, CC
+    [0xC0 ... 0xDF] = MIDI_SI_CHANNEL | 1, // Program change, channel AT
+    [0xE0 ... 0xEF] = MIDI_SI_CHANNEL | 2, // Pitch bend
+    [0xF0]          = MIDI_SI_SYSEX,
+    [0xF1]          = MIDI_SI_COMMON | 1,  // Time code quarter frame
+    [0xF2]          = MIDI_SI_COMMON | 2,  // Song position pointer
+    [0xF3]          = MIDI_SI_COMMON | 1,  // Song select
+    [0xF4 ... 0xF5] = MIDI_SI_UNDEFINED,
+    [0xF6]          = MIDI_SI_COMMON,      // Tune request
+    [0xF7]          = MIDI_SI_UNDEFINED,   // EOX
+    [0xF8 ... 0xFF] = MIDI_SI_REALTIME
+};
+
 /** Initializes a new MIDI data stream to start values.
  */
 void midi_stream_init(midi_stream *ms) {
-  ms->last_status = 0;
-  ms->received_data1 = 0;
+  memset(ms, 0, sizeof(*ms));
 }
 
-// FIXME: Fix all these magic numbers
-
-/** Receives a byte on a MIDI stream.
- * Returns true if we received a full message.
- * Puts the message in the specified location, if one is fully received.
+/** Sets how SysEx payloads are received; NULL to ignore them.
+ * Don't change this in the middle of a SysEx. A zero sized buffer
+ * is taken as no buffer, so the bytes always have somewhere to go.
  */
-int midi_stream_receive(midi_stream *ms, uint8_t b, midi_message *msg) {
+void midi_stream_set_sysex(midi_stream *ms, const midi_sysex_handler_t *handler) {
+  ms->sysex = handler;
+  ms->sysex_buffered = handler != NULL && handler->buf != NULL && handler->buf_sz > 0;
+}
 
-  if (b & 0x80) {
-    // Status byte
+/** Collects SysEx payload bytes, or hands them to the handler. */
+static void sysex_data(midi_stream *ms, const uint8_t *data, size_t len) {
+  const midi_sysex_handler_t *h = ms->sysex;
+  size_t room;
 
-    switch (b & 0xF0) {
-
-    // Channel Voice/Mode status bytes ///////////////////////////////////////
-    case 0x80: // Note off (2 bytes)
-    case 0x90: // Note on (2 bytes)
-    case 0xA0: // Poly aftertouch (2 bytes)
-    case 0xB0: // Control change (2 bytes) & Channel Mode (1st byte 120-127)
-    case 0xC0: // Program Change (1 byte)
-    case 0xD0: // Channel aftertouch (1 byte)
-    case 0xE0: // Pitch bend (2 bytes)
-      ms->last_status = b;
-      ms->received_data1 = 0;
-      return 0; // Expecting more later
-
-    // System status bytes ///////////////////////////////////////////////////
-    case 0xF0: // System: Exclusive, Common, Real-Time
-      // Real time messages do not interfere with running status
-      if (b >= 0xF8) {
-        // Real-time message does not change running status and has zero data bytes
-        msg->type = b;
-        return 1;
-      }
-      switch (b & 0x7) { // So, 0xFn where n = 0 - 7
-      case 0x0: // Start of SysEx - we ignore all data bytes from here
-        ms->last_status = b;
-        return 0;
-      case 0x1: // MIDI Time Code Quarter Frame - (1 byte)
-      case 0x2: // Song Position Pointer - (2 bytes)
-      case 0x3: // Song select (1 byte)
-        ms->last_status = b;
-        ms->received_data1 = 0;
-        return 0; // Expecting more later
-      case 0x4: // Undefined
-      case 0x5: // Undefined
-        ms->last_status = MIDI_NONE;
-        // We probably don't need to return anything
-        return 0; // Error
-      case 0x6: // Tune request (0 bytes)
-        ms->last_status = MIDI_NONE; // End running status
-        msg->type = b;
-        return 1;
-      case 0x7: // SysEx EOX (end of eXclusive) - we are ignoring this for now
-        ms->last_status = MIDI_NONE;
-        return 0;
+  ms->sysex_len += len;
+  if (h == NULL) {
+    return;
+  }
+  if (!ms->sysex_buffered) {
+    if (h->data != NULL) {
+      h->data(h->ctx, data, len);
+    }
+    return;
+  }
+
+  while (len > 0) {
+    room = h->buf_sz - ms->sysex_buf_used;
+    if (room == 0) {
+      if (h->data == NULL) {
+        ms->sysex_dropped += len;
+        if (!ms->sysex_overflowed) {
+          ms->sysex_overflowed = 1;
+          ms->sysex_overflows++;
+        }
+        return;
       }
+      // Hand over a full buffer
+      h->data(h->ctx, h->buf, ms->sysex_buf_used);
+      ms->sysex_buf_used = 0;
+      room = h->buf_sz;
+    }
+    if (room > len) {
+      room = len;
     }
+    memcpy(h->buf + ms->sysex_buf_used, data, room);
+    ms->sysex_buf_used += room;
+    data += room;
+    len -= room;
+  }
+}
 
-    // No fall through - should be unreachable
-    return 0;
+static void sysex_start(midi_stream *ms) {
+  ms->in_sysex = 1;
+  ms->sysex_overflowed = 0;
+  ms->sysex_len = 0;
+  ms->sysex_buf_used = 0;
+  if (ms->sysex != NULL && ms->sysex->start != NULL) {
+    ms->sysex->start(ms->sysex->ctx);
   }
+}
 
-  //////////////////////////////////////////////////////////////////////////////////
-  // Data byte Handling
-
-  switch (ms->last_status & 0xF0) {
-
-  case 0x80: // Note off (2 bytes)
-  case 0x90: // Note on (2 bytes)
-  case 0xA0: // Poly aftertouch (2 bytes)
-    if (ms->received_data1) {
-      msg->type = ms->last_status;
-      msg->note = ms->data1;
-      msg->velocity = b;
-      msg->channel = ms->last_status & 0x0F;
-      // Running status remains
-      ms->received_data1 = 0;
-      // If it's a note ON with velocity 0, let's convert it to
-      // a note OFF
-      if ((msg->type & 0xF0) == MIDI_NOTE_ON &&
-          msg->velocity == 0) {
-        msg->type = MIDI_NOTE_OFF | msg->channel;
-      }
+/** Ends a SysEx, with EOX (complete) or not. */
+static void sysex_end(midi_stream *ms, int complete) {
+  const midi_sysex_handler_t *h = ms->sysex;
+
+  ms->in_sysex = 0;
+  if (complete) {
+    ms->sysex_complete++;
+  } else {
+    ms->sysex_truncated++;
+  }
+  if (h == NULL) {
+    return;
+  }
+  if (ms->sysex_buffered && h->data != NULL && ms->sysex_buf_used > 0) {
+    h->data(h->ctx, h->buf, ms->sysex_buf_used);
+    ms->sysex_buf_used = 0;
+  }
+  if (h->end != NULL) {
+    h->end(h->ctx, ms->sysex_len, complete);
+  }
+}
+
+/** Receives one byte; see midi_stream_receive(). Only writes to msg
+ * when a message is complete.
+ */
+static inline int receive_byte(midi_stream *ms, uint8_t b, midi_message *msg) {
+  uint8_t status, info, len;
+
+  if (b & 0x80) {
+    // Status byte
+    info = midi_status_info[b];
+
+    if (info & MIDI_SI_REALTIME) {
+      // Real-time message does not change running status and has zero data bytes
+      msg->type = b;
+      msg->channel = 0;
       return 1;
     }
-    // Store data 1 for next time
-    ms->data1 = b;
-    ms->received_data1 = 1;
-    return 0;
 
-  case 0xB0: // Control change (2 bytes) & Channel Mode (1st byte 120-127)
-    if (ms->received_data1) {
-      if (ms->data1 >= 120) {
-        // Channel mode message
-        msg->type = ms->data1;
-        msg->data1 = b;
-        msg->data2 = b;
-        msg->channel = ms->last_status & 0x0F;
-        ms->received_data1 = 0;
-        return 1;
-      }
-      // Regular Control Change
-      msg->type = ms->last_status;
-      msg->control = ms->data1;
-      msg->cc_value = b;
-      msg->channel = ms->last_status & 0x0F;
-      ms->received_data1 = 0;
-      return 1;
+    if (ms->in_sysex) {
+      // Any status but real-time ends a SysEx; only EOX properly
+      sysex_end(ms, b == 0xF7);
+    }
+    if (info & MIDI_SI_SYSEX) {
+      sysex_start(ms);
     }
-    ms->data1 = b;
-    ms->received_data1 = 1;
-    return 0;
 
-  case 0xC0: // Program Change (1 byte)
-    msg->type = ms->received_data1;
-    msg->channel = ms->last_status & 0x0F;
-    msg->program = b;
-    return 1;
-
-  case 0xD0: // Channel aftertouch (1 byte)
-    msg->type = ms->received_data1;
-    msg->channel = ms->last_status & 0x0F;
-    msg->pressure = b;
-    return 1;
-
-  case 0xE0: // Pitch bend (2 bytes)
-    if (ms->received_data1) {
-      msg->type = ms->last_status;
-      msg->msb = b;
-      msg->lsb = ms->data1;
-      msg->channel = ms->last_status & 0x0F;
-      ms->received_data1 = 0;
+    ms->received_data1 = 0;
+    if (info == MIDI_SI_COMMON) {
+      // Tune request: complete with no data, and ends running status
+      ms->last_status = MIDI_NONE;
+      msg->type = b;
+      msg->channel = 0;
       return 1;
     }
-    ms->received_data1 = 1;
-    ms->data1 = b;
+
+    // Channel and system common statuses wait for data bytes,
+    // as does SysEx; undefined & EOX end running status
+    ms->last_status = (info & MIDI_SI_UNDEFINED) ? MIDI_NONE : b;
     return 0;
   }
 
-  switch (ms->last_status) {
+  // Data byte: SysEx payload, or ignored with no status
+  status = ms->last_status;
+  info = midi_status_info[status];
+  len = info & MIDI_SI_LENGTH;
+  if (len == 0) {
+    if (ms->in_sysex) {
+      sysex_data(ms, &b, 1);
+    }
+    return 0;
+  }
 
-  // System ////////////////////////////////////////////////////////////////////////
+  if (len == 2) {
+    if (!ms->received_data1) {
+      // Store data 1 for next time
+      ms->data1 = b;
+      ms->received_data1 = 1;
+      return 0;
+    }
+    msg->data1 = ms->data1;
+    msg->data2 = b;
+    ms->received_data1 = 0;
+  } else {
+    msg->data1 = b;
+    msg->data2 = 0;
+  }
+  msg->type = status;
 
-  case 0xF0: // SysEx - we're ignoring data in SysEx
-    return 0;
-  case 0xF1: // MIDI Time Code Quarter Frame - (1 byte)
-    msg->type = ms->last_status;
-    msg->tcqf_message_type = ((b & 0x70) >> 4);
-    msg->tcqf_value = (b & 0x0F);
-    ms->last_status = MIDI_NONE; // No running status
-    return 1;
-  case 0xF2: // Song Position Pointer - (2 bytes)
-    if (ms->received_data1) {
-      msg->type = ms->last_status;
-      msg->lsb = ms->data1;
-      msg->msb = b;
-      ms->last_status = MIDI_NONE;
-      return 1;
+  if (info & MIDI_SI_CHANNEL) {
+    // Running status remains
+    msg->channel = status & 0x0F;
+    // If it's a note ON with velocity 0, let's convert it to
+    // a note OFF
+    if ((status & 0xF0) == MIDI_NOTE_ON && msg->velocity == 0) {
+      msg->type = MIDI_NOTE_OFF | msg->channel;
+    }
+  } else {
+    // System common: no running status
+    msg->channel = 0;
+    if (status == 0xF1) {
+      // MIDI Time Code Quarter Frame
+      msg->tcqf_message_type = (b & 0x70) >> 4;
+      msg->tcqf_value = b & 0x0F;
     }
-    ms->received_data1 = 1;
-    ms->data1 = b;
-    return 0;
-  case 0xF3: // Song select (1 byte)
-    msg->type = ms->last_status;
-    msg->data1 = b; // Song number
-    ms->last_status = MIDI_NONE;
-    return 1;
-  case 0xF4: // Undefined - should never get here
-  case 0xF5: // Undefined - should never get here
-    ms->last_status = MIDI_NONE; // End running status
-    return 0; // Error
-  case 0xF6: // Tune request (0 bytes) - should never get here
-    ms->last_status = MIDI_NONE; // End running status
-    return 0;
-  case 0xF7: // SysEx EOX (end of eXclusive) - we are ignoring this for now
     ms->last_status = MIDI_NONE;
-    return 0;
+  }
+  return 1;
+}
+
+/** Forgets any partly received message and the running status, and
+ * ends any SysEx as truncated, as when input has been lost.
+ */
+void midi_stream_resync(midi_stream *ms) {
+  if (ms->in_sysex) {
+    sysex_end(ms, 0);
+  }
+  ms->last_status = MIDI_NONE;
+  ms->received_data1 = 0;
+}
+
+/** Receives a byte on a MIDI stream.
+ * Returns true if we received a full message.
+ * Puts the message in the specified location, if one is fully received.
+ */
+int midi_stream_receive(midi_stream *ms, uint8_t b, midi_message *msg) {
+  return receive_byte(ms, b, msg);
+}
+
+/** Receives a span of bytes on a MIDI stream, putting each full message
+ * received into msgs, up to max_msgs of them.
+ * Returns the number of messages received. Stops early when msgs is
+ * full; *consumed is set to the number of bytes used, so call again
+ * with the rest.
+ * Runs of SysEx payload are handed over a whole run at a time.
+ */
+size_t midi_stream_receive_buf(midi_stream *ms, const uint8_t *buf, size_t len,
+                               midi_message *msgs, size_t max_msgs, size_t *consumed) {
+  size_t i = 0;
+  size_t n = 0;
+
+  while (i < len && n < max_msgs) {
+    if (ms->in_sysex && buf[i] < 0x80) {
+      size_t run = i + 1;
+      while (run < len && buf[run] < 0x80) {
+        run++;
+      }
+      sysex_data(ms, &buf[i], run - i);
+      i = run;
+      continue;
+    }
+    n += receive_byte(ms, buf[i++], &msgs[n]);
   }
 
-  // We should never get here unless ms->last_status < 128
-  return 0;
+  *consumed = i;
+  return n;
 }
 
 // 0-101 inclusive
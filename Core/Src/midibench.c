@@ -0,0 +1,143 @@
+/*
+ * midibench.c
+ *
+ *  Created on: 2025-03-22
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Exercises the MIDI parser (midi.c) on the device:
+ *
+ * 1. Cross-check: a pseudo-random byte stream, heavy on running
+ *    status, interleaved real-time bytes, SysEx and stray data bytes,
+ *    goes through the checks in midicheck.c: the byte parser against
+ *    the reference decoder in midiref.c, then the bulk parser,
+ *    midi_stream_receive_buf(), against the byte parser. Every
+ *    message and SysEx payload has to match.
+ *
+ * 2. Encoder round trip (also in midicheck.c): random messages are
+ *    sent through midi_out (running status, and sometimes Note Off as
+ *    Note On velocity 0) with real-time bytes pushed in between,
+ *    drained in random sized chunks and parsed again. Everything has
+ *    to come back as sent.
+ *
+ * 3. Benchmark: the same kind of stream is parsed repeatedly and timed
+ *    with the DWT cycle counter, giving bytes/sec and messages/sec,
+ *    once a byte per call and once in spans of MIDIBENCH_SPAN_SZ.
+ *
+ * This is the guard rail for optimizing the parser: the cross-check
+ * must stay at zero mismatches while the benchmark numbers improve.
+ *
+ * Everything here runs synchronously, so audio output will glitch
+ * while it runs.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "midi.h"
+#include "midibench.h"
+#include "midiref.h"
+#include "midicheck.h"
+#include "cyclecount.h"
+
+// Size of the generated stream; the benchmark parses it several times
+#define MIDIBENCH_STREAM_SZ 2048
+#define MIDIBENCH_CHECK_ROUNDS 8
+#define MIDIBENCH_BENCH_ROUNDS 16
+// Span size and message array size for the bulk benchmark
+#define MIDIBENCH_SPAN_SZ 64
+#define MIDIBENCH_MSGS 16
+
+static uint8_t stream[MIDIBENCH_STREAM_SZ];
+
+/** Fills the stream with mostly data bytes and occasional status
+ * bytes of every kind, including the undefined ones.
+ */
+static void generate_stream(uint32_t *state) {
+  for (size_t i = 0; i < MIDIBENCH_STREAM_SZ; i++) {
+    uint32_t r = midicheck_random(state);
+    uint32_t pick = r % 100;
+
+    if (pick < 10) {
+      // Channel voice/mode status
+      stream[i] = 0x80 | ((r >> 8) % 0x70);
+    } else if (pick < 13) {
+      // Real-time
+      stream[i] = 0xF8 | ((r >> 8) & 0x07);
+    } else if (pick < 15) {
+      // System common & SysEx
+      stream[i] = 0xF0 | ((r >> 8) & 0x07);
+    } else {
+      stream[i] = (r >> 8) & 0x7F;
+    }
+  }
+}
+
+/** Run the cross-check and then the benchmark, starting from the
+ * specified PRNG seed (which must not be zero).
+ */
+void midibench_run(uint32_t seed, midibench_result_t *result) {
+  midicheck_t mc;
+  midi_stream ms;
+  midi_message mm;
+  uint32_t state = seed != 0 ? seed : 1;
+  uint32_t start;
+
+  // Cross-checks: byte by byte against the reference, then the bulk
+  // parser against the byte parser
+  midicheck_init(&mc);
+  for (int round = 0; round < MIDIBENCH_CHECK_ROUNDS; round++) {
+    generate_stream(&state);
+    midicheck_reference(&mc, stream, MIDIBENCH_STREAM_SZ);
+  }
+  for (int round = 0; round < MIDIBENCH_CHECK_ROUNDS; round++) {
+    generate_stream(&state);
+    midicheck_bulk(&mc, stream, MIDIBENCH_STREAM_SZ, &state);
+  }
+  midicheck_finish(&mc);
+  result->check_bytes = mc.bytes;
+  result->check_messages = mc.messages;
+  result->mismatches = mc.mismatches;
+  result->first_mismatch = mc.first_mismatch;
+  result->sysex_bytes = mc.ref_tally.bytes;
+  result->sysex_mismatch = mc.sysex_mismatch;
+  result->bulk_mismatches = mc.bulk_mismatches;
+
+  // Encoder round trip through the byte parser
+  for (int round = 0; round < MIDIBENCH_CHECK_ROUNDS; round++) {
+    midicheck_encoder(&mc, &state);
+  }
+  result->encode_messages = mc.encode_messages;
+  result->encode_mismatches = mc.encode_mismatches;
+  result->encode_bytes = mc.encode_bytes;
+  result->encode_raw_bytes = mc.encode_raw_bytes;
+
+  // Benchmark, over a single generated stream
+  generate_stream(&state);
+  midi_stream_init(&ms);
+  result->bench_messages = 0;
+  start = cyclecount_now();
+  for (int round = 0; round < MIDIBENCH_BENCH_ROUNDS; round++) {
+    for (size_t i = 0; i < MIDIBENCH_STREAM_SZ; i++) {
+      result->bench_messages += midi_stream_receive(&ms, stream[i], &mm);
+    }
+  }
+  result->bench_cycles = cyclecount_now() - start;
+  result->bench_bytes = MIDIBENCH_STREAM_SZ * MIDIBENCH_BENCH_ROUNDS;
+
+  // Same stream, in spans
+  midi_message msgs[MIDIBENCH_MSGS];
+  size_t used;
+  midi_stream_init(&ms);
+  result->bulk_messages = 0;
+  start = cyclecount_now();
+  for (int round = 0; round < MIDIBENCH_BENCH_ROUNDS; round++) {
+    for (size_t i = 0; i < MIDIBENCH_STREAM_SZ; i += used) {
+      size_t span = MIDIBENCH_STREAM_SZ - i < MIDIBENCH_SPAN_SZ ? MIDIBENCH_STREAM_SZ - i : MIDIBENCH_SPAN_SZ;
+      result->bulk_messages += midi_stream_receive_buf(&ms, &stream[i], span,
+                                                       msgs, MIDIBENCH_MSGS, &used);
+    }
+  }
+  result->bulk_cycles = cyclecount_now() - start;
+}
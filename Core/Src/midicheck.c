@@ -0,0 +1,275 @@
+/*
+ * midicheck.c
+ *
+ *  Created on: 2025-04-12
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Cross-checks of the MIDI parser, on any bytes:
+ *
+ * 1. midicheck_reference(): fed byte by byte to midi_stream_receive()
+ *    and to the reference decoder (midiref.c), every message emitted
+ *    by either one has to match the other. SysEx payloads are tallied
+ *    (length & hash) and compared at the end.
+ *
+ * 2. midicheck_bulk(): fed to midi_stream_receive_buf() in random
+ *    sized spans, with a small, random sized message array, it has to
+ *    produce exactly what the byte parser does, with SysEx delivered
+ *    as spans to one and through a small collecting buffer to the
+ *    other. It also has to consume some of every span, no more than
+ *    it was given, and never return more messages than asked for.
+ *
+ * 3. midicheck_encoder(): random messages are sent through midi_out
+ *    (midiout.c) with real-time bytes pushed in between, drained in
+ *    random sized chunks and parsed again by the byte parser.
+ *    Everything has to come back as sent, with Note Off as Note On
+ *    velocity 0 when the encoder does that.
+ *
+ * The device (midibench.c) counts the differences; the host fuzz
+ * harness (Tools/midifuzz) aborts on any. No hardware dependencies.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "midi.h"
+#include "midiout.h"
+#include "midiref.h"
+#include "midicheck.h"
+
+/** xorshift32 pseudo-random number generator - never give it 0 */
+uint32_t midicheck_random(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+void midicheck_init(midicheck_t *mc) {
+  midiref_tally_init(&mc->ref_tally);
+  midiref_init(&mc->rd);
+  mc->ref_sysex = (midi_sysex_handler_t){
+      .data = midiref_tally_data, .end = midiref_tally_end, .ctx = &mc->ref_tally,
+      .buf = mc->no_room, .buf_sz = 0 };
+  midi_stream_init(&mc->ref_ms);
+  midi_stream_set_sysex(&mc->ref_ms, &mc->ref_sysex);
+
+  midiref_tally_init(&mc->bulk_tally);
+  midiref_tally_init(&mc->byte_tally);
+  mc->bulk_sysex = (midi_sysex_handler_t){
+      .data = midiref_tally_data, .end = midiref_tally_end, .ctx = &mc->bulk_tally };
+  mc->byte_sysex = (midi_sysex_handler_t){
+      .data = midiref_tally_data, .end = midiref_tally_end, .ctx = &mc->byte_tally,
+      .buf = mc->sysex_buf, .buf_sz = sizeof(mc->sysex_buf) };
+  midi_stream_init(&mc->bulk_ms);
+  midi_stream_init(&mc->byte_ms);
+  midi_stream_set_sysex(&mc->bulk_ms, &mc->bulk_sysex);
+  midi_stream_set_sysex(&mc->byte_ms, &mc->byte_sysex);
+
+  mc->bytes = 0;
+  mc->messages = 0;
+  mc->mismatches = 0;
+  mc->first_mismatch = 0;
+  mc->sysex_mismatch = 0;
+  mc->bulk_bytes = 0;
+  mc->bulk_mismatches = 0;
+  mc->first_bulk_mismatch = 0;
+  mc->encode_messages = 0;
+  mc->encode_mismatches = 0;
+  mc->encode_bytes = 0;
+  mc->encode_raw_bytes = 0;
+}
+
+/** The byte parser against the reference decoder */
+void midicheck_reference(midicheck_t *mc, const uint8_t *data, size_t len) {
+  midi_message mm, ref_mm;
+  int got, ref_got;
+
+  for (size_t i = 0; i < len; i++, mc->bytes++) {
+    got = midi_stream_receive(&mc->ref_ms, data[i], &mm);
+    ref_got = midiref_receive(&mc->rd, data[i], &ref_mm);
+
+    if (got) {
+      mc->messages++;
+    }
+    if (got != ref_got || (got && !midiref_messages_match(&mm, &ref_mm))) {
+      if (mc->mismatches == 0) {
+        mc->first_mismatch = mc->bytes;
+      }
+      mc->mismatches++;
+    }
+  }
+}
+
+static void bulk_mismatch(midicheck_t *mc, uint32_t offset) {
+  if (mc->bulk_mismatches == 0) {
+    mc->first_bulk_mismatch = offset;
+  }
+  mc->bulk_mismatches++;
+}
+
+/** The bulk parser against the byte parser, in spans sized from the
+ * PRNG state.
+ */
+void midicheck_bulk(midicheck_t *mc, const uint8_t *data, size_t len, uint32_t *state) {
+  midi_message bulk_mm[MIDICHECK_SPAN_SZ], byte_mm[MIDICHECK_SPAN_SZ];
+  size_t pos = 0, span, done, used, max_msgs, n;
+  size_t bulk_n, byte_n;
+
+  while (pos < len) {
+    span = 1 + midicheck_random(state) % MIDICHECK_SPAN_SZ;
+    if (span > len - pos) {
+      span = len - pos;
+    }
+
+    // At most a message per byte, so the arrays cannot overflow
+    bulk_n = 0;
+    for (done = 0; done < span; done += used) {
+      max_msgs = 1 + midicheck_random(state) % MIDICHECK_MAX_MSGS;
+      used = 0;
+      n = midi_stream_receive_buf(&mc->bulk_ms, &data[pos + done], span - done,
+                                  &bulk_mm[bulk_n], max_msgs, &used);
+      if (n > max_msgs || used == 0 || used > span - done) {
+        // Can't trust where it got to; give up on this span
+        bulk_mismatch(mc, mc->bulk_bytes + pos + done);
+        break;
+      }
+      bulk_n += n;
+    }
+
+    byte_n = 0;
+    for (done = 0; done < span; done++) {
+      byte_n += midi_stream_receive(&mc->byte_ms, data[pos + done], &byte_mm[byte_n]);
+    }
+
+    if (bulk_n != byte_n) {
+      bulk_mismatch(mc, mc->bulk_bytes + pos);
+    } else {
+      for (size_t i = 0; i < bulk_n; i++) {
+        if (!midiref_messages_match(&bulk_mm[i], &byte_mm[i])) {
+          bulk_mismatch(mc, mc->bulk_bytes + pos);
+        }
+      }
+    }
+    pos += span;
+  }
+  mc->bulk_bytes += len;
+}
+
+/** Compares the SysEx tallies, once everything has been checked */
+void midicheck_finish(midicheck_t *mc) {
+  mc->sysex_mismatch = !midiref_tallies_match(&mc->ref_tally, &mc->rd.sysex);
+
+  // A SysEx still in progress may have bytes waiting in the buffer
+  if (mc->byte_ms.in_sysex) {
+    midiref_tally_bytes(&mc->byte_tally, mc->sysex_buf, mc->byte_ms.sysex_buf_used);
+    mc->byte_ms.sysex_buf_used = 0;
+  }
+  if (!midiref_tallies_match(&mc->bulk_tally, &mc->byte_tally)) {
+    bulk_mismatch(mc, mc->bulk_bytes);
+  }
+}
+
+/** Makes a random message that midi_out can send, mostly notes on
+ * two channels so running status gets used.
+ */
+static void random_message(uint32_t *state, midi_message *mm) {
+  static const uint8_t common[] = { 0xF1, 0xF2, 0xF3, 0xF6 };
+  uint32_t r = midicheck_random(state);
+  uint32_t pick = r % 16;
+
+  if (pick < 8) {
+    mm->type = (r & 0x10) ? MIDI_NOTE_ON : MIDI_NOTE_OFF;
+  } else if (pick < 14) {
+    mm->type = 0x80 + ((r >> 4) % 7) * 0x10;
+  } else {
+    mm->type = common[(r >> 4) & 0x03];
+  }
+  mm->channel = mm->type < 0xF0 ? ((r >> 8) & 0x01) : 0;
+  mm->type |= mm->channel;
+  mm->data1 = (r >> 12) & 0x7F;
+  mm->data2 = (r >> 20) & 0x7F;
+  if (mm->type == 0xF1) {
+    mm->tcqf_message_type &= 0x07;
+    mm->tcqf_value &= 0x0F;
+  }
+}
+
+/** What the parser should give back for a message sent through mo */
+static void expected_message(const midi_out_t *mo, const midi_message *sent, midi_message *mm) {
+  *mm = *sent;
+  if ((mm->type & 0xF0) == MIDI_NOTE_OFF && mo->off_as_zero_on) {
+    mm->velocity = 0;
+  } else if ((mm->type & 0xF0) == MIDI_NOTE_ON && mm->velocity == 0) {
+    mm->type = MIDI_NOTE_OFF | mm->channel;
+  }
+}
+
+/** Sends random messages through the encoder, with real-time bytes
+ * in between, and parses them back.
+ */
+void midicheck_encoder(midicheck_t *mc, uint32_t *state) {
+  midi_out_t mo;
+  midi_stream ms;
+  midi_message sent[MIDICHECK_ENCODE_MSGS], expect, got;
+  uint8_t chunk[MIDICHECK_DRAIN_SZ];
+  size_t queued = 0, received = 0, n;
+  uint32_t rt_received = 0, mismatches = 0;
+
+  midi_out_init(&mo);
+  midi_stream_init(&ms);
+  mo.off_as_zero_on = midicheck_random(state) & 1;
+
+  for (size_t i = 0; i < MIDICHECK_ENCODE_MSGS; i++) {
+    random_message(state, &sent[i]);
+    mc->encode_raw_bytes += 1 + (midi_status_info[sent[i].type] & MIDI_SI_LENGTH);
+  }
+
+  while (received < MIDICHECK_ENCODE_MSGS) {
+    // Queue a few, until the queue is full
+    for (int i = midicheck_random(state) % 8; i > 0 && queued < MIDICHECK_ENCODE_MSGS; i--) {
+      if (!midi_out_send(&mo, &sent[queued])) {
+        break;
+      }
+      queued++;
+    }
+    if (midicheck_random(state) % 4 == 0) {
+      midi_out_realtime(&mo, MIDI_RT_TIMING_CLOCK | (midicheck_random(state) & 0x07));
+    }
+
+    n = midi_out_drain(&mo, chunk, 1 + midicheck_random(state) % MIDICHECK_DRAIN_SZ, 0);
+    for (size_t i = 0; i < n; i++) {
+      if (!midi_stream_receive(&ms, chunk[i], &got)) {
+        continue;
+      }
+      if (got.type >= MIDI_RT_TIMING_CLOCK) {
+        rt_received++;
+      } else if (received >= queued) {
+        mismatches++;
+      } else {
+        expected_message(&mo, &sent[received++], &expect);
+        mismatches += !midiref_messages_match(&got, &expect);
+      }
+    }
+    if (n == 0 && queued == MIDICHECK_ENCODE_MSGS) {
+      // Everything sent, but not everything came back
+      mismatches += MIDICHECK_ENCODE_MSGS - received;
+      break;
+    }
+  }
+
+  // Real-time bytes still queued are drained and counted as well
+  while ((n = midi_out_drain(&mo, chunk, sizeof(chunk), 0)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      rt_received += midi_stream_receive(&ms, chunk[i], &got) && got.type >= MIDI_RT_TIMING_CLOCK;
+    }
+  }
+  mismatches += rt_received != mo.realtime;
+
+  mc->encode_messages += received;
+  mc->encode_mismatches += mismatches;
+  mc->encode_bytes += mo.bytes_sent - mo.realtime;
+}
@@ -0,0 +1,142 @@
+/*
+ * midimon.c
+ *
+ *  Created on: 2025-04-03
+ *  Updated on: 2025-04-03
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Rate-limited, coalescing MIDI monitor.
+ *
+ * Printing and drawing every received message as it arrives costs a
+ * snprintf, console queue space and a display string (with its SPI
+ * queue entries and allocations) per message, so a fast glissando
+ * floods both. Instead, received messages are only stored here, which
+ * is cheap, and formatted a few times a second:
+ *
+ * Console: the newest MIDIMON_CONSOLE_LINES messages are printed, with
+ * a "... N msgs" line summarizing any before them. Only whole lines
+ * that fit in the space the caller has are printed; while the console
+ * is backed up, the ring keeps the newest messages and drops the
+ * oldest.
+ *
+ * Display: only the latest message is drawn, with the number of
+ * messages since the last redraw.
+ *
+ * Everything dropped or summarized is counted.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "midi.h"
+#include "midimon.h"
+
+void midimon_init(midimon_t *m) {
+  memset(m, 0, sizeof(*m));
+}
+
+/** Stores a message for the console, dropping the oldest if full. */
+void midimon_console_add(midimon_t *m, const midi_message *mm) {
+  if (m->head - m->tail >= MIDIMON_SIZE) {
+    m->tail++;
+    m->skipped++;
+    m->overwritten++;
+  }
+  m->ring[m->head++ & (MIDIMON_SIZE - 1)] = *mm;
+  m->received++;
+}
+
+/** Notes the latest message for the display. */
+void midimon_display_add(midimon_t *m, const midi_message *mm) {
+  m->latest = *mm;
+  m->display_pending++;
+}
+
+/** If it is time, formats the waiting messages for the console into
+ * out (at most out_sz bytes, whole lines only) and returns the length;
+ * otherwise returns 0.
+ */
+size_t midimon_console_flush(midimon_t *m, uint32_t now_ms, char *out, size_t out_sz) {
+  char line[96];
+  size_t len = 0;
+  int l;
+  uint32_t waiting = m->head - m->tail;
+
+  if (waiting == 0 || now_ms - m->last_console < MIDIMON_CONSOLE_MS) {
+    return 0;
+  }
+
+  // Summarize all but the newest few
+  if (waiting > MIDIMON_CONSOLE_LINES) {
+    m->skipped += waiting - MIDIMON_CONSOLE_LINES;
+    m->summarized += waiting - MIDIMON_CONSOLE_LINES;
+    m->tail = m->head - MIDIMON_CONSOLE_LINES;
+  }
+  if (m->skipped > 0) {
+    l = snprintf(line, sizeof(line), "... %lu msgs\r\n", (unsigned long)m->skipped);
+    if ((size_t)l >= out_sz) {
+      // No room even for that; try again later
+      m->console_full++;
+      return 0;
+    }
+    memcpy(out, line, l);
+    len = l;
+    m->skipped = 0;
+  }
+
+  while (m->tail != m->head) {
+    l = midi_snprintf(line, sizeof(line) - 2, &m->ring[m->tail & (MIDIMON_SIZE - 1)]);
+    if (l < 0) {
+      l = 0;
+    } else if ((size_t)l > sizeof(line) - 3) {
+      l = sizeof(line) - 3;
+    }
+    line[l++] = '\r';
+    line[l++] = '\n';
+    if (len + l > out_sz) {
+      // The rest wait, and the oldest get dropped if more come
+      m->console_full++;
+      break;
+    }
+    memcpy(out + len, line, l);
+    len += l;
+    m->tail++;
+    m->printed++;
+  }
+
+  m->last_console = now_ms;
+  return len;
+}
+
+/** If it is time and there is something new, formats the latest
+ * message for the display, padded with spaces to out_sz - 1 so it
+ * overwrites whatever was there, and returns the length; otherwise 0.
+ */
+size_t midimon_display_flush(midimon_t *m, uint32_t now_ms, char *out, size_t out_sz) {
+  int l;
+
+  if (m->display_pending == 0 || out_sz < 2 || now_ms - m->last_display < MIDIMON_DISPLAY_MS) {
+    return 0;
+  }
+
+  memset(out, ' ', out_sz - 1);
+  out[out_sz - 1] = '\0';
+  l = midi_snprintf(out, out_sz, &m->latest);
+  if (l >= 0 && m->display_pending > 1 && (size_t)l < out_sz) {
+    l += snprintf(out + l, out_sz - l, " (%lu msgs)", (unsigned long)m->display_pending);
+  }
+  // Undo snprintf's terminator
+  if (l >= 0 && (size_t)l < out_sz - 1) {
+    out[l] = ' ';
+  }
+
+  m->coalesced += m->display_pending - 1;
+  m->display_pending = 0;
+  m->redraws++;
+  m->last_display = now_ms;
+  return out_sz - 1;
+}
@@ -0,0 +1,194 @@
+/*
+ * midiout.c
+ *
+ *  Created on: 2025-03-29
+ *  Updated on: 2025-03-29
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * MIDI output encoder.
+ *
+ * At 31,250 baud every byte costs 320us of wire time, so we send as
+ * few as possible: a channel message whose status byte is the same as
+ * the last one sent leaves it out (running status). Along with sending
+ * Note Off as Note On velocity 0, a run of notes costs 2 bytes each
+ * instead of 3.
+ *
+ * System common messages cancel running status, so the next channel
+ * message sends its status again. Real-time messages don't affect it
+ * and go into their own small queue, which is always drained first,
+ * so a clock byte never waits behind a backlog of notes. (Real-time
+ * bytes may legally appear even in the middle of another message.)
+ *
+ * Messages are queued whole or not at all, so a full queue never
+ * leaves the receiver with a partial message or the wrong running
+ * status. This is not interrupt safe; use it from the main loop.
+ *
+ * MIDI thru forwards received messages rather than bytes, so locally
+ * made messages merge in between them cleanly, and running status is
+ * worked out again for the merged stream. Forwarded messages are
+ * stamped with when they were received, and the latency is measured
+ * when their last byte is drained to the port. (Real-time bytes
+ * always go first and are not measured.)
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "midi.h"
+#include "midiout.h"
+
+void midi_out_init(midi_out_t *mo) {
+  memset(mo, 0, sizeof(*mo));
+}
+
+/** Encodes a non-real-time message into out (up to 3 bytes),
+ * leaving out the status byte if running status allows, and
+ * returns the number of bytes. Returns 0 for anything that cannot
+ * be sent this way (SysEx, undefined or data bytes as a type).
+ */
+size_t midi_out_encode(midi_out_t *mo, const midi_message *mm, uint8_t *out) {
+  uint8_t status = mm->type;
+  uint8_t d1 = mm->data1;
+  uint8_t d2 = mm->data2;
+  uint8_t info, len;
+  size_t n = 0;
+
+  if (status < 0x80) {
+    return 0;
+  }
+  info = midi_status_info[status];
+
+  if (info & MIDI_SI_CHANNEL) {
+    status = (status & 0xF0) | (mm->channel & 0x0F);
+    if (mo->off_as_zero_on && (status & 0xF0) == MIDI_NOTE_OFF) {
+      status = MIDI_NOTE_ON | (status & 0x0F);
+      d2 = 0;
+    }
+    if (status == mo->running_status) {
+      mo->status_saved++;
+    } else {
+      out[n++] = status;
+      mo->running_status = status;
+    }
+  } else if (info & MIDI_SI_COMMON) {
+    out[n++] = status;
+    mo->running_status = 0;
+    if (status == 0xF1) {
+      // Time code: message type and value nibbles
+      d1 = ((mm->tcqf_message_type & 0x07) << 4) | (mm->tcqf_value & 0x0F);
+    }
+  } else {
+    return 0;
+  }
+
+  len = info & MIDI_SI_LENGTH;
+  if (len >= 1) {
+    out[n++] = d1 & 0x7F;
+  }
+  if (len >= 2) {
+    out[n++] = d2 & 0x7F;
+  }
+  return n;
+}
+
+/** Queues a real-time byte ahead of all other output. */
+bool midi_out_realtime(midi_out_t *mo, uint8_t b) {
+  if (b < MIDI_RT_TIMING_CLOCK || mo->rt_head - mo->rt_tail >= MIDI_OUT_RT_SZ) {
+    mo->dropped++;
+    mo->dropped_bytes++;
+    return false;
+  }
+  mo->rt[mo->rt_head++ & (MIDI_OUT_RT_SZ - 1)] = b;
+  mo->realtime++;
+  return true;
+}
+
+/** Counts a message that did not fit, and the wire bytes it would have used */
+static void count_drop(midi_out_t *mo, const midi_message *mm) {
+  mo->dropped++;
+  mo->dropped_bytes += mm->type >= 0x80 ? 1 + (midi_status_info[mm->type] & MIDI_SI_LENGTH) : 1;
+}
+
+/** Encodes and queues a message; real-time messages go ahead of
+ * everything else. Returns false if it was dropped.
+ */
+bool midi_out_send(midi_out_t *mo, const midi_message *mm) {
+  uint8_t bytes[3];
+  uint8_t saved_status = mo->running_status;
+  uint32_t saved_saved = mo->status_saved;
+  size_t n;
+
+  if (mm->type >= MIDI_RT_TIMING_CLOCK) {
+    return midi_out_realtime(mo, mm->type);
+  }
+
+  n = midi_out_encode(mo, mm, bytes);
+  if (n == 0 || MIDI_OUT_BUF_SZ - (mo->head - mo->tail) < n) {
+    // Undo any running status change, as this never gets sent
+    mo->running_status = saved_status;
+    mo->status_saved = saved_saved;
+    count_drop(mo, mm);
+    return false;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    mo->buf[mo->head++ & (MIDI_OUT_BUF_SZ - 1)] = bytes[i];
+  }
+  mo->messages++;
+  return true;
+}
+
+/** Queues a received message to be passed on (MIDI thru), noting
+ * when it was received. Returns false if it was dropped.
+ */
+bool midi_out_forward(midi_out_t *mo, const midi_message *mm, uint32_t received) {
+  if (!midi_out_send(mo, mm)) {
+    return false;
+  }
+  mo->forwarded++;
+
+  // Real-time bytes are not measured; if there are too many
+  // outstanding stamps, this one just goes unmeasured
+  if (mm->type < MIDI_RT_TIMING_CLOCK && mo->stamp_head - mo->stamp_tail < MIDI_OUT_STAMPS) {
+    mo->stamp_pos[mo->stamp_head & (MIDI_OUT_STAMPS - 1)] = mo->head;
+    mo->stamp_time[mo->stamp_head & (MIDI_OUT_STAMPS - 1)] = received;
+    mo->stamp_head++;
+  }
+  return true;
+}
+
+/** Moves up to max queued bytes into dst, real-time bytes first,
+ * and returns how many. Everything drained is counted as sent.
+ * now is in the same units as the forwarded message timestamps.
+ */
+size_t midi_out_drain(midi_out_t *mo, uint8_t *dst, size_t max, uint32_t now) {
+  size_t n = 0;
+  uint32_t slot, latency;
+
+  while (n < max && mo->rt_tail != mo->rt_head) {
+    dst[n++] = mo->rt[mo->rt_tail++ & (MIDI_OUT_RT_SZ - 1)];
+  }
+  while (n < max && mo->tail != mo->head) {
+    dst[n++] = mo->buf[mo->tail++ & (MIDI_OUT_BUF_SZ - 1)];
+  }
+
+  // Forwarded messages which are now completely drained
+  while (mo->stamp_tail != mo->stamp_head) {
+    slot = mo->stamp_tail & (MIDI_OUT_STAMPS - 1);
+    if ((int32_t)(mo->tail - mo->stamp_pos[slot]) < 0) {
+      break;
+    }
+    latency = now - mo->stamp_time[slot];
+    mo->latency_count++;
+    mo->latency_total += latency;
+    if (latency > mo->latency_max) {
+      mo->latency_max = latency;
+    }
+    mo->stamp_tail++;
+  }
+
+  mo->bytes_sent += n;
+  return n;
+}
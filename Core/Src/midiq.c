@@ -0,0 +1,68 @@
+/*
+ * midiq.c
+ *
+ *  Created on: 2025-03-28
+ *  Updated on: 2025-04-10
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Lock-free single-producer/single-consumer queue of timestamped MIDI
+ * messages, so that MIDI input is parsed when it arrives and the synth
+ * takes it at audio block boundaries, decoupling the two.
+ *
+ * The producer and the consumer may be in different contexts (e.g.,
+ * main loop and an interrupt) but there can only be one of each.
+ * head and tail are free running, so the depth is simply head - tail
+ * (with unsigned wraparound). The release/acquire ordering makes sure
+ * an event is completely written before the other side sees it.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "midiq.h"
+
+void midiq_init(midiq_t *q) {
+  memset(q, 0, sizeof(*q));
+}
+
+/** Producer: adds an event. Returns false (and counts an overflow)
+ * if the queue is full.
+ */
+bool midiq_push(midiq_t *q, uint32_t timestamp, uint8_t port, const midi_message *msg) {
+  uint32_t head = q->head;
+  uint32_t depth = head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+  midiq_event_t *e;
+
+  if (depth >= MIDIQ_SIZE) {
+    q->overflows++;
+    return false;
+  }
+
+  e = &q->events[head & (MIDIQ_SIZE - 1)];
+  e->timestamp = timestamp;
+  e->port = port;
+  e->msg = *msg;
+  __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+  q->pushed++;
+  if (depth + 1 > q->high_water) {
+    q->high_water = depth + 1;
+  }
+  return true;
+}
+
+/** Consumer: takes the oldest event. Returns false if there is none. */
+bool midiq_pop(midiq_t *q, midiq_event_t *event) {
+  uint32_t tail = q->tail;
+
+  if (tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+
+  *event = q->events[tail & (MIDIQ_SIZE - 1)];
+  __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
@@ -0,0 +1,172 @@
+/*
+ * midiref.c
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-11
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Reference MIDI decoder: a byte at a time, with no tables and no
+ * bulk path, so it is easy to check against the spec by eye. It
+ * decodes what midi_stream_receive() should, with the same
+ * conventions (Note On velocity 0 is a Note Off, Time Code is split
+ * into its nibbles, system messages have channel 0), and tallies
+ * SysEx payloads instead of delivering them.
+ *
+ * No hardware dependencies, so it builds on a host too.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "midi.h"
+#include "midiref.h"
+
+#define FNV_OFFSET_BASIS 0x811C9DC5
+#define FNV_PRIME        0x01000193
+
+///////////////////////////////////////////////////////////////////////////////
+// SysEx tallies
+
+void midiref_tally_init(midiref_tally_t *t) {
+  t->bytes = 0;
+  t->hash = FNV_OFFSET_BASIS;
+  t->complete = 0;
+  t->truncated = 0;
+}
+
+void midiref_tally_bytes(midiref_tally_t *t, const uint8_t *data, size_t len) {
+  t->bytes += len;
+  for (size_t i = 0; i < len; i++) {
+    t->hash = (t->hash ^ data[i]) * FNV_PRIME;
+  }
+}
+
+void midiref_tally_data(void *ctx, const uint8_t *data, size_t len) {
+  midiref_tally_bytes((midiref_tally_t *)ctx, data, len);
+}
+
+void midiref_tally_end(void *ctx, size_t total_len, int complete) {
+  midiref_tally_t *t = (midiref_tally_t *)ctx;
+
+  if (complete) {
+    t->complete++;
+  } else {
+    t->truncated++;
+  }
+}
+
+int midiref_tallies_match(const midiref_tally_t *a, const midiref_tally_t *b) {
+  return a->bytes == b->bytes && a->hash == b->hash &&
+         a->complete == b->complete && a->truncated == b->truncated;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decoder
+
+void midiref_init(midiref_decoder_t *rd) {
+  rd->status = 0;
+  rd->count = 0;
+  midiref_tally_init(&rd->sysex);
+}
+
+/** Number of data bytes needed for a status byte, or -1 if data bytes
+ * following it should be ignored (SysEx, undefined, or none).
+ */
+int midiref_data_length(uint8_t status) {
+  if (status >= 0x80 && status < 0xF0) {
+    uint8_t hi = status & 0xF0;
+    return (hi == 0xC0 || hi == 0xD0) ? 1 : 2;
+  }
+  if (status == 0xF1 || status == 0xF3) {
+    return 1;
+  }
+  if (status == 0xF2) {
+    return 2;
+  }
+  return -1;
+}
+
+/** Returns 1 if a message was decoded into mm */
+int midiref_receive(midiref_decoder_t *rd, uint8_t b, midi_message *mm) {
+  int len;
+
+  if (b >= 0xF8) {
+    // Real-time: no effect on anything else
+    mm->type = b;
+    mm->channel = 0;
+    return 1;
+  }
+
+  if (b >= 0x80) {
+    rd->count = 0;
+    // Any status but real-time ends SysEx
+    if (rd->status == 0xF0) {
+      if (b == 0xF7) {
+        rd->sysex.complete++;
+      } else {
+        rd->sysex.truncated++;
+      }
+    }
+    // Tune request is complete with no data; undefined
+    // statuses and EOX simply end any running status
+    if (b == 0xF6) {
+      rd->status = 0;
+      mm->type = b;
+      mm->channel = 0;
+      return 1;
+    }
+    rd->status = (b == 0xF4 || b == 0xF5 || b == 0xF7) ? 0 : b;
+    return 0;
+  }
+
+  len = midiref_data_length(rd->status);
+  if (len < 0) {
+    if (rd->status == 0xF0) {
+      midiref_tally_bytes(&rd->sysex, &b, 1);
+    }
+    return 0;
+  }
+
+  rd->data[rd->count++] = b;
+  if (rd->count < len) {
+    return 0;
+  }
+  rd->count = 0;
+
+  mm->type = rd->status;
+  mm->channel = rd->status < 0xF0 ? (rd->status & 0x0F) : 0;
+  mm->data1 = rd->data[0];
+  mm->data2 = len == 2 ? rd->data[1] : 0;
+
+  if (rd->status == 0xF1) {
+    // Time code: message type and value nibbles
+    mm->data1 = (rd->data[0] >> 4) & 0x07;
+    mm->data2 = rd->data[0] & 0x0F;
+  } else if ((rd->status & 0xF0) == MIDI_NOTE_ON && mm->data2 == 0) {
+    mm->type = MIDI_NOTE_OFF | mm->channel;
+  }
+
+  if (rd->status >= 0xF0) {
+    // System common messages end running status
+    rd->status = 0;
+  }
+  return 1;
+}
+
+/** Compares the fields that are meaningful for the message type. */
+int midiref_messages_match(const midi_message *a, const midi_message *b) {
+  if (a->type != b->type || a->channel != b->channel) {
+    return 0;
+  }
+  if (a->type >= 0xF8 || a->type == 0xF6) {
+    return 1;
+  }
+  if (a->data1 != b->data1) {
+    return 0;
+  }
+  if (midiref_data_length(a->type) == 2 || a->type == 0xF1) {
+    return a->data2 == b->data2;
+  }
+  return 1;
+}
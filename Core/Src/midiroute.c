@@ -0,0 +1,332 @@
+/*
+ * midiroute.c
+ *
+ *  Created on: 2025-04-01
+ *  Updated on: 2025-04-01
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * MIDI filtering and routing.
+ *
+ * Each route (synth, thru, console monitor, display) has a rule of
+ * channels, message types, notes and controllers it accepts. Rather
+ * than checking every rule for every message, the rules are compiled
+ * into tables whose entries are route bitmasks:
+ *
+ *   by_status[status]: routes taking that type on that channel
+ *   by_data[row][data1]: routes taking that note (row 1) or
+ *                        controller (row 2); row 0 takes anything
+ *   data_row[status]: which row applies to the status
+ *
+ * so the routes for a message are
+ *   by_status[type] & by_data[data_row[type]][data1]
+ * whatever the rules are. Recompile after changing the rules.
+ *
+ * Rules are edited with text commands (from the console):
+ *
+ *   <route> all|none
+ *   <route> ch|type|note|cc <items>
+ *
+ * where route is synth, thru, mon or disp, and each item is a value
+ * or a lo-hi range (channels 1-16, notes & controllers 0-127, type
+ * names as in type_names[]). Items prefixed with + or - are added to
+ * or removed from what is there; otherwise the first item replaces it.
+ * For example: "synth ch 10", "mon type -clock -rt", "thru note 36-59".
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "midi.h"
+#include "midiroute.h"
+
+#define ALL_ROUTES ((uint8_t)((1 << MIDI_ROUTES) - 1))
+
+static const char *route_names[MIDI_ROUTES] = { "synth", "thru", "mon", "disp" };
+
+// In MIDI_ROUTE_T_xxx bit order
+static const char *type_names[] = {
+    "off", "on", "pat", "cc", "pc", "cat", "pb",
+    "sys", "clock", "transport", "rt"
+};
+#define NUM_TYPES (sizeof(type_names) / sizeof(type_names[0]))
+
+// Type bits of system messages 0xF0-0xFF. SysEx, EOX & undefined
+// never come as messages.
+static const uint16_t system_types[16] = {
+    0, MIDI_ROUTE_T_COMMON, MIDI_ROUTE_T_COMMON, MIDI_ROUTE_T_COMMON,
+    0, 0, MIDI_ROUTE_T_COMMON, 0,
+    MIDI_ROUTE_T_CLOCK, MIDI_ROUTE_T_OTHER_RT, MIDI_ROUTE_T_TRANSPORT, MIDI_ROUTE_T_TRANSPORT,
+    MIDI_ROUTE_T_TRANSPORT, MIDI_ROUTE_T_OTHER_RT, MIDI_ROUTE_T_OTHER_RT, MIDI_ROUTE_T_OTHER_RT
+};
+
+static inline int bit_get(const uint32_t *bits, int n) {
+  return (bits[n >> 5] >> (n & 31)) & 1;
+}
+
+static inline void bit_set(uint32_t *bits, int n, int value) {
+  if (value) {
+    bits[n >> 5] |= 1UL << (n & 31);
+  } else {
+    bits[n >> 5] &= ~(1UL << (n & 31));
+  }
+}
+
+static void rule_all(midi_route_rule_t *rule, int all) {
+  rule->channels = all ? 0xFFFF : 0;
+  rule->types = all ? MIDI_ROUTE_T_ALL : 0;
+  memset(rule->notes, all ? 0xFF : 0, sizeof(rule->notes));
+  memset(rule->ccs, all ? 0xFF : 0, sizeof(rule->ccs));
+}
+
+/** Everything goes to the synth and thru; the console monitor and
+ * display skip clock and active sensing, as they always have.
+ */
+void midi_router_init(midi_router_t *r) {
+  memset(r, 0, sizeof(*r));
+  for (int i = 0; i < MIDI_ROUTES; i++) {
+    rule_all(&r->rules[i], 1);
+  }
+  r->rules[2].types &= ~(MIDI_ROUTE_T_CLOCK | MIDI_ROUTE_T_OTHER_RT);
+  r->rules[3].types &= ~(MIDI_ROUTE_T_CLOCK | MIDI_ROUTE_T_OTHER_RT);
+  midi_router_compile(r);
+}
+
+/** Builds the lookup tables from the rules. */
+void midi_router_compile(midi_router_t *r) {
+  memset(r->by_status, 0, sizeof(r->by_status));
+  memset(r->data_row, MIDI_ROUTE_ROW_ANY, sizeof(r->data_row));
+  memset(r->by_data[MIDI_ROUTE_ROW_ANY], ALL_ROUTES, sizeof(r->by_data[0]));
+  memset(r->by_data[MIDI_ROUTE_ROW_NOTE], 0, sizeof(r->by_data[0]));
+  memset(r->by_data[MIDI_ROUTE_ROW_CC], 0, sizeof(r->by_data[0]));
+
+  for (int s = 0x80; s <= 0xFF; s++) {
+    if (s < 0xF0) {
+      r->data_row[s] = s < 0xB0 ? MIDI_ROUTE_ROW_NOTE :
+                       s < 0xC0 ? MIDI_ROUTE_ROW_CC : MIDI_ROUTE_ROW_ANY;
+    }
+  }
+
+  for (int i = 0; i < MIDI_ROUTES; i++) {
+    const midi_route_rule_t *rule = &r->rules[i];
+    uint8_t bit = 1 << i;
+
+    for (int s = 0x80; s <= 0xFF; s++) {
+      uint16_t type = s < 0xF0 ? (1 << ((s >> 4) - 8)) : system_types[s & 0x0F];
+      int channel_ok = s >= 0xF0 || ((rule->channels >> (s & 0x0F)) & 1);
+
+      if ((rule->types & type) && channel_ok) {
+        r->by_status[s] |= bit;
+      }
+    }
+    for (int n = 0; n < 128; n++) {
+      if (bit_get(rule->notes, n)) {
+        r->by_data[MIDI_ROUTE_ROW_NOTE][n] |= bit;
+      }
+      if (bit_get(rule->ccs, n)) {
+        r->by_data[MIDI_ROUTE_ROW_CC][n] |= bit;
+      }
+    }
+  }
+}
+
+const char *midi_router_name(int route) {
+  return route >= 0 && route < MIDI_ROUTES ? route_names[route] : "?";
+}
+
+/** Looks up a type name; returns its bit number or -1 */
+static int type_number(const char *name, size_t len) {
+  for (size_t i = 0; i < NUM_TYPES; i++) {
+    if (strlen(type_names[i]) == len && strncmp(type_names[i], name, len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/** Parses one value of an item; returns it, or -1 */
+static int parse_value(const char *s, size_t len, char field) {
+  char *end;
+  long v;
+
+  if (field == 't') {
+    return type_number(s, len);
+  }
+  v = strtol(s, &end, 10);
+  if (end != s + len) {
+    return -1;
+  }
+  if (field == 'c') {
+    // Channels are 1-16 on the console, 0-15 inside
+    return v >= 1 && v <= 16 ? v - 1 : -1;
+  }
+  return v >= 0 && v <= 127 ? v : -1;
+}
+
+/** Reads the next space separated word; returns its length (0 at the end) */
+static size_t next_word(const char **p) {
+  size_t len = 0;
+
+  while (**p == ' ') {
+    (*p)++;
+  }
+  while ((*p)[len] != '\0' && (*p)[len] != ' ') {
+    len++;
+  }
+  return len;
+}
+
+/** Applies a rule editing command (see above) and recompiles.
+ * Returns 0, or -EINVAL if the command is not understood (in which
+ * case nothing is changed).
+ */
+int midi_router_command(midi_router_t *r, const char *cmd) {
+  midi_route_rule_t rule;
+  const char *p = cmd;
+  size_t len;
+  int route = -1;
+  char field;
+  int first = 1;
+
+  len = next_word(&p);
+  for (int i = 0; i < MIDI_ROUTES; i++) {
+    if (strlen(route_names[i]) == len && strncmp(route_names[i], p, len) == 0) {
+      route = i;
+    }
+  }
+  if (route < 0) {
+    return -EINVAL;
+  }
+  p += len;
+  rule = r->rules[route];
+
+  len = next_word(&p);
+  if (len == 3 && strncmp(p, "all", 3) == 0) {
+    rule_all(&rule, 1);
+    p += len;
+  } else if (len == 4 && strncmp(p, "none", 4) == 0) {
+    rule_all(&rule, 0);
+    p += len;
+  } else {
+    if (len == 2 && strncmp(p, "ch", 2) == 0) {
+      field = 'c';
+    } else if (len == 4 && strncmp(p, "type", 4) == 0) {
+      field = 't';
+    } else if (len == 4 && strncmp(p, "note", 4) == 0) {
+      field = 'n';
+    } else if (len == 2 && strncmp(p, "cc", 2) == 0) {
+      field = 'k';
+    } else {
+      return -EINVAL;
+    }
+    p += len;
+
+    while ((len = next_word(&p)) > 0) {
+      const char *item = p;
+      const char *dash;
+      int add = 1, lo, hi;
+
+      if (*item == '+' || *item == '-') {
+        add = *item == '+';
+        item++;
+      } else if (first) {
+        // A bare first item replaces what was there
+        if (field == 'c') {
+          rule.channels = 0;
+        } else if (field == 't') {
+          rule.types = 0;
+        } else {
+          memset(field == 'n' ? rule.notes : rule.ccs, 0, sizeof(rule.notes));
+        }
+      }
+      first = 0;
+
+      dash = memchr(item, '-', p + len - item);
+      if (dash != NULL) {
+        lo = parse_value(item, dash - item, field);
+        hi = parse_value(dash + 1, p + len - dash - 1, field);
+      } else {
+        lo = hi = parse_value(item, p + len - item, field);
+      }
+      if (lo < 0 || hi < lo) {
+        return -EINVAL;
+      }
+
+      for (int v = lo; v <= hi; v++) {
+        if (field == 'c') {
+          rule.channels = add ? rule.channels | (1 << v) : rule.channels & ~(1 << v);
+        } else if (field == 't') {
+          rule.types = add ? rule.types | (1 << v) : rule.types & ~(1 << v);
+        } else {
+          bit_set(field == 'n' ? rule.notes : rule.ccs, v, add);
+        }
+      }
+      p += len;
+    }
+    if (first) {
+      // Nothing given
+      return -EINVAL;
+    }
+  }
+
+  if (next_word(&p) != 0) {
+    return -EINVAL;
+  }
+  r->rules[route] = rule;
+  midi_router_compile(r);
+  return 0;
+}
+
+/** Appends lo-hi ranges of set bits (shown + offset), like "1-4,10" */
+static int print_ranges(char *str, size_t size, const uint32_t *bits, int count, int offset) {
+  int l = 0, lo;
+
+  for (int n = 0; n < count; n++) {
+    if (!bit_get(bits, n)) {
+      continue;
+    }
+    lo = n;
+    while (n + 1 < count && bit_get(bits, n + 1)) {
+      n++;
+    }
+    l += snprintf(str + l, size > (size_t)l ? size - l : 0, "%s%d", l ? "," : "", lo + offset);
+    if (n > lo) {
+      l += snprintf(str + l, size > (size_t)l ? size - l : 0, "-%d", n + offset);
+    }
+  }
+  if (l == 0) {
+    l = snprintf(str, size, "none");
+  }
+  return l;
+}
+
+/** Describes one route's rule and count, like snprintf(). */
+int midi_router_snprintf(char *str, size_t size, const midi_router_t *r, int route) {
+  const midi_route_rule_t *rule = &r->rules[route];
+  uint32_t channels = rule->channels;
+  uint32_t types = rule->types;
+  int l;
+
+#define REMAIN (size > (size_t)l ? size - l : 0)
+  l = snprintf(str, size, "%-5s %lu msgs; ch ", route_names[route], r->routed[route]);
+  l += print_ranges(str + l, REMAIN, &channels, 16, 1);
+  l += snprintf(str + l, REMAIN, "; type ");
+  if (types == 0) {
+    l += snprintf(str + l, REMAIN, "none");
+  }
+  for (size_t i = 0, any = 0; i < NUM_TYPES; i++) {
+    if (types & (1 << i)) {
+      l += snprintf(str + l, REMAIN, "%s%s", any++ ? "," : "", type_names[i]);
+    }
+  }
+  l += snprintf(str + l, REMAIN, "; note ");
+  l += print_ranges(str + l, REMAIN, rule->notes, 128, 0);
+  l += snprintf(str + l, REMAIN, "; cc ");
+  l += print_ranges(str + l, REMAIN, rule->ccs, 128, 0);
+#undef REMAIN
+  return l;
+}
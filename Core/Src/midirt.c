@@ -0,0 +1,45 @@
+/*
+ * midirt.c
+ *
+ *  Created on: 2025-03-31
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * MIDI real-time fast path.
+ *
+ * System real-time bytes (0xF8-0xFF) can appear between any two bytes,
+ * even within other messages and SysEx, and don't change the state of
+ * anything around them. So they can be picked out of the received
+ * bytes right when those are read from the DMA buffer, and handled
+ * before the rest is parsed. Clock, Start and Stop then keep their
+ * timing while a long SysEx or a dense note stream is parsed and
+ * displayed; the parser's copies of them are ignored.
+ *
+ * Each one is stamped with when its byte came in, worked out from its
+ * place in what was read, like the parsed messages are, so how often
+ * the main loop reads doesn't show up as clock jitter.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "midirt.h"
+
+/** Hands each real-time byte in buf to handler, leaving buf alone (it
+ * may be the DMA buffer). last is when buf's last byte came in, and
+ * the bytes before it are taken as byte_cycles apart.
+ * Returns how many were found.
+ */
+size_t midirt_scan(const uint8_t *buf, size_t len, uint32_t last, uint32_t byte_cycles,
+                   midirt_handler_t handler, void *ctx) {
+  size_t found = 0;
+
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] >= 0xF8) {
+      handler(ctx, last - (uint32_t)(len - 1 - i) * byte_cycles, buf[i]);
+      found++;
+    }
+  }
+  return found;
+}
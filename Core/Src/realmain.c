@@ -5,7 +5,7 @@
  * auto-generated.
  *
  *  Created on: 2024-08-25
- *  Updated on: 2025-03-17
+ *  Updated on: 2025-04-12
  *      Author: Douglas P. Fields, Jr.
  *   Copyright: 2024-2025, Douglas P. Fields, Jr.
  *     License: Apache 2.0
@@ -26,6 +26,20 @@
 #include "fonts.h"
 #include "usartdma.h"
 #include "synth.h"
+#include "cyclecount.h"
+#include "midibench.h"
+#include "synthcheck.h"
+#include "trace.h"
+#include "memstats.h"
+#include "midiq.h"
+#include "midiout.h"
+#include "tempo.h"
+#include "midirt.h"
+#include "midiroute.h"
+#include "smf.h"
+#include "midimon.h"
+#include "dlog.h"
+#include "telem.h"
 
 #define SOFTWARE_VERSION "21"
 
@@ -34,41 +48,83 @@
                      "\t4/5. Read BTN1/2\r\n" \
                      "\t6.   Counters\r\n" \
                      "\t7.   SPI info\r\n" \
+                     "\t8.   SPI bus stats\r\n" \
+                     "\t9.   MIDI parser check/bench\r\n" \
+                     "\tS.   Synth golden audio check\r\n" \
+                     "\tt.   Dump binary event trace\r\n" \
+                     "\tl/L. Log binary/text\r\n" \
+                     "\tT/A. Telemetry stream/audio\r\n" \
+                     "\tM.   Serial MIDI (FD FD FD ends)\r\n" \
                      "\tqw.  Pause/start I2S\r\n" \
                      "\ter.  Start/stop a note\r\n" \
                      "\tdf.  Send note on/off\r\n" \
+                     "\th.   MIDI thru on/off\r\n" \
+                     "\tb.   MIDI clock tempo\r\n" \
+                     "\ti.   MIDI inputs/merge\r\n" \
+                     "\tu.   Show MIDI routes\r\n" \
+                     "\tR.   Edit a MIDI route\r\n" \
+                     "\tp.   Play/stop the demo song\r\n" \
                      "\ta.   Audio mute\r\n" \
                      "\tg/G. Gain 0/1\r\n" \
                      "\tx.   Show/clear MIDI1 flags\r\n" \
+                     "\tm.   Memory usage\r\n" \
                      "\t(.   Mem\r\n" \
                      "\t).   Stack\r\n" \
                      "\t~.   Menu"
 #define PROMPT "\r\n> "
-#define NOTE_ON_START  "\x90\x3C\x40"
-#define NOTE_ON_START_LEN 3
-#define NOTE_OFF_START "\x80\x3C\x40"
-#define NOTE_OFF_START_LEN 3
 
-// This is using LL API
-#if 1
-#define MIDI1_UART          USART1 // Low level USART - HAL would be huartN
-#define MIDI1_DMA_RX        DMA2
-#define MIDI1_DMA_RX_STREAM LL_DMA_STREAM_2
-#define MIDI1_DMA_TX        DMA2
-#define MIDI1_DMA_TX_STREAM LL_DMA_STREAM_7
-#elif 0
-#define MIDI1_UART          USART3 // Low level USART - HAL would be huartN
-#define MIDI1_DMA_RX        DMA1
-#define MIDI1_DMA_RX_STREAM LL_DMA_STREAM_1
-#define MIDI1_DMA_TX        DMA1
-#define MIDI1_DMA_TX_STREAM LL_DMA_STREAM_3
-#else
-#define MIDI1_UART          USART6 // Low level USART - HAL would be huartN
-#define MIDI1_DMA_RX        DMA2
-#define MIDI1_DMA_RX_STREAM LL_DMA_STREAM_1
-#define MIDI1_DMA_TX        DMA2
-#define MIDI1_DMA_TX_STREAM LL_DMA_STREAM_6
-#endif
+/* Wired MIDI ports, all receiving at once (this is using LL API).
+ * MIDI1 is also the MIDI output, and its clock drives the tempo.
+ */
+#define MIDI_PORTS 3
+#define MIDI1_PORT 0
+
+/* Receive buffer sizes, per port: big enough for the longest main
+ * loop stall at the port's traffic. The "peak" in the '6' RX line is
+ * the most that has waited, and bytes past the size are dropped. A
+ * MIDI port carries at most 3125 B/s, about 3 bytes a millisecond.
+ * A normal pass is well inside one 4 ms audio block.
+ *
+ * MIDI1 feeds the synth, THRU and the tempo, and can get sequencer
+ * streams and SysEx dumps at the full rate, so it holds 80 ms of
+ * them, for the console's one-pass diagnostics too (the 'S' golden
+ * check renders 0.4 s of audio at once). The others are for
+ * controllers, and hold 20 ms, five audio blocks.
+ */
+#define MIDI1_RX_BUF_SZ 256
+#define MIDI3_RX_BUF_SZ 64
+#define MIDI6_RX_BUF_SZ 64
+
+DMA_BSS uint8_t midi1_i_buff[MIDI1_RX_BUF_SZ];
+DMA_BSS uint8_t midi3_i_buff[MIDI3_RX_BUF_SZ];
+DMA_BSS uint8_t midi6_i_buff[MIDI6_RX_BUF_SZ];
+
+typedef struct midi_port_hw {
+  const char *name;
+  USART_TypeDef *usartx;    // Low level USART - HAL would be huartN
+  DMA_TypeDef *dma_rx;
+  uint32_t dma_rx_stream;
+  DMA_TypeDef *dma_tx;
+  uint32_t dma_tx_stream;
+  IRQn_Type irqn;
+  uint8_t *rx_buf;          // Circular DMA receive buffer
+  size_t rx_buf_sz;
+} midi_port_hw_t;
+
+static const midi_port_hw_t midi_port_hw[MIDI_PORTS] = {
+    { "USART1", USART1, DMA2, LL_DMA_STREAM_2, DMA2, LL_DMA_STREAM_7, USART1_IRQn,
+      midi1_i_buff, sizeof(midi1_i_buff) },
+    { "USART3", USART3, DMA1, LL_DMA_STREAM_1, DMA1, LL_DMA_STREAM_3, USART3_IRQn,
+      midi3_i_buff, sizeof(midi3_i_buff) },
+    { "USART6", USART6, DMA2, LL_DMA_STREAM_1, DMA2, LL_DMA_STREAM_6, USART6_IRQn,
+      midi6_i_buff, sizeof(midi6_i_buff) },
+};
+
+// Port tags of MIDI that does not come from a wired port
+#define MIDI_PORT_CONSOLE MIDI_PORTS // Serial MIDI; see SERIAL_MIDI_ESCAPE
+#define MIDI_PORT_LOCAL   0xFF       // Console keys
+// Inputs merged by check_midi_input(): the wired ports and the console
+#define MIDI_INPUTS (MIDI_PORTS + 1)
 
 // This is using LL API
 #define CONSOLE_UART          USART2 // Low level USART - HAL would be huart2
@@ -76,27 +132,32 @@
 #define CONSOLE_DMA_TX        DMA1
 #define CONSOLE_DMA_RX_STREAM LL_DMA_STREAM_5
 #define CONSOLE_DMA_TX_STREAM LL_DMA_STREAM_6
+#define CONSOLE_IRQn          USART2_IRQn
+#define CONSOLE_BAUD          115200 // As main.c sets it up
+
+#define MIDI_BAUD 31250
 
 // This is using HAL API
 #define I2S_BUFFER_SIZE 256
+#define AUDIO_SAMPLE_RATE 32000
 #define SOUND1          hi2s1
 
 // This is using HAL API
 #define DISPLAY_SPI  hspi2
 #define DISPLAY_DMA  hdma_spi2_tx
+#define DISPLAY_DMA_IRQn DMA1_Stream4_IRQn
 // TODO: Multiplex this with the Touch Screen SPI?
 
 // From main.c
 // These two are needed if we use HAL UARTs
 //extern UART_HandleTypeDef CONSOLE_UART; // Serial Console
-//extern UART_HandleTypeDef MIDI1_UART; // MIDI 1
 extern I2S_HandleTypeDef SOUND1;
+// From smfdemo.c (Tools/mid2c.py), in flash
+extern const uint8_t smf_demo[];
+extern const size_t smf_demo_len;
 extern SPI_HandleTypeDef DISPLAY_SPI;
 extern DMA_HandleTypeDef DISPLAY_DMA;
 
-const uint8_t NOTE_ON[] = NOTE_ON_START;
-const uint8_t NOTE_OFF[] = NOTE_OFF_START;
-
 static uint32_t overrun_errors = 0;
 // static uint32_t uart_error_callbacks = 0;
 static uint32_t usart3_interrupts = 0;
@@ -104,20 +165,151 @@ static uint32_t midi_overrun_errors = 0;
 static uint32_t loops_per_tick;
 static uint32_t midi_received = 0; // For receive interrupts
 
-// MIDI1 I/O buffers
-DMA_BSS uint8_t m1_o_buff1[32];
-DMA_BSS uint8_t m1_o_buff2[sizeof(m1_o_buff1)];
-DMA_BSS uint8_t m1_i_buff[32];
-FAST_BSS usart_dma_config_t midi1_io; // MIDI Input Receive
+// Console receive buffer size, as for the MIDI ports (above). The
+// console may carry MIDI (see SERIAL_MIDI_ESCAPE) at almost four
+// times the MIDI port rate.
+#define CONSOLE_RX_BUF_SZ 128
+// Transmit buffer sizes: how much can be copied in to send
+#define MIDI_TX_BUF_SZ    64
+#define CONSOLE_TX_BUF_SZ 1024
+
+// MIDI port I/O buffers
+DMA_BSS uint8_t midi_o_buff[MIDI_PORTS][MIDI_TX_BUF_SZ + UDCR_TX_BOUNCE_SZ];
+FAST_BSS usart_dma_config_t midi_io[MIDI_PORTS];
 
 // Console I/O
-DMA_BSS uint8_t c_i_buff[32];
-DMA_BSS uint8_t c_o_buff1[512];
-DMA_BSS uint8_t c_o_buff2[sizeof(c_o_buff1)];
+DMA_BSS uint8_t c_i_buff[CONSOLE_RX_BUF_SZ];
+DMA_BSS uint8_t c_o_buff[CONSOLE_TX_BUF_SZ + UDCR_TX_BOUNCE_SZ];
 FAST_BSS usart_dma_config_t console_io;
 
-// MIDI input parsers
-FAST_BSS midi_stream midi_stream_0;
+/* Console output priorities. Messages are queued whole or dropped
+ * whole, and each priority has to leave some of the output buffer
+ * free for the ones above it, so when the console backs up, chatter
+ * goes first and errors last.
+ */
+typedef enum con_pri {
+  CON_ERROR,     // Faults and lost data
+  CON_TELEMETRY, // Statistics and diagnostics, including the log
+  CON_CHATTER,   // Echo, prompts, menus and progress dots
+  CON_PRIORITIES
+} con_pri_t;
+
+// Bytes of the console output buffer each priority leaves free
+static const size_t con_reserve[CON_PRIORITIES] = {
+    0, CONSOLE_TX_BUF_SZ / 8, CONSOLE_TX_BUF_SZ / 4
+};
+
+typedef struct con_stats {
+  uint32_t sent[CON_PRIORITIES];          // Messages
+  uint32_t dropped[CON_PRIORITIES];       // Messages
+  uint32_t dropped_bytes[CON_PRIORITIES];
+} con_stats_t;
+
+static con_stats_t con_stats;
+
+// Longest we wait for boot messages to go out
+#define CONSOLE_BOOT_FLUSH_MS 500
+
+/* Serial MIDI: option 'M' makes the console carry raw MIDI bytes, as
+ * a Hairless-style MIDI<->serial bridge sends them, until it receives
+ * SERIAL_MIDI_ESCAPE_LEN SERIAL_MIDI_ESCAPEs in a row. 0xFD is an
+ * undefined real-time status, which MIDI sources never send.
+ */
+#define SERIAL_MIDI_ESCAPE     0xFD
+#define SERIAL_MIDI_ESCAPE_LEN 3
+
+typedef struct serial_midi {
+  bool active;
+  uint8_t escape_run;    // SERIAL_MIDI_ESCAPEs in a row so far
+  bool escaped;          // Ends the session once what came before is handled
+  uint32_t bytes;        // Since boot
+  uint32_t sessions;
+
+  // This session
+  uint32_t start_ms;
+  uint32_t max_pass;     // Most bytes handled in one main loop pass
+  // Counts as the session started, to show what it changed
+  uint32_t start_bytes;
+  uint32_t start_messages;
+  uint32_t start_rx_lost;
+  uint32_t start_queued;
+  uint32_t start_queue_dropped;
+  synth_stats_t start_synth;
+} serial_midi_t;
+
+static serial_midi_t serial_midi;
+
+/* A MIDI input: a wired port, or the console. Each has a parser of
+ * its own, so a message half received on one is never mixed up with
+ * another's.
+ */
+typedef struct midi_input {
+  const char *name;
+  usart_dma_config_t *io;
+  uint32_t byte_cycles;   // How long one byte takes to come in
+  midi_stream stream;
+  midi_sysex_handler_t sysex;
+
+  // What check_midi_input() is merging
+  udcr_spans_t spans;
+  size_t total;           // Bytes in spans
+  size_t parsed;          // Of those, parsed so far
+  int span;               // Where parsing is up to
+  size_t pos;
+  uint32_t received;      // When spans was read
+  bool pending;           // next holds the next message
+  midiq_event_t next;
+
+  // Statistics
+  uint32_t messages;      // Handled, since boot
+  uint32_t rt_messages;   // ... of those, real-time
+  // Since 'i' last showed them; times are from when a message came in
+  uint32_t wait_max;      // Longest until it was handled (cycles)
+  uint32_t synth_count;   // Messages the synth took
+  uint64_t synth_total;   // Cycles until the synth took them
+  uint32_t synth_max;
+} midi_input_t;
+
+FAST_BSS midi_input_t midi_inputs[MIDI_INPUTS];
+
+typedef struct midi_merge_stats {
+  uint32_t passes;        // Main loop passes with messages to merge
+  uint32_t shared;        // ... from more than one input
+  uint32_t switches;      // Messages handled right after another input's
+  uint32_t max_messages;  // Most messages in one pass
+} midi_merge_stats_t;
+
+static midi_merge_stats_t midi_merge;
+// The input that wins ties; they take turns
+static uint8_t merge_first;
+
+// MIDI messages on their way to the synth
+FAST_BSS midiq_t synth_queue;
+
+// MIDI output encoder
+FAST_BSS midi_out_t midi1_out;
+// Pass MIDI1 input on to the MIDI1 output
+static bool midi1_thru = false;
+
+// Tempo from the MIDI1 clock
+FAST_BSS tempo_t midi1_tempo;
+
+// Where MIDI1 input goes
+FAST_BSS midi_router_t midi1_router;
+
+// What MIDI1 received, for the console and display
+FAST_BSS midimon_t midi1_mon;
+
+// Song player, and how long its audio blocks take to render
+FAST_BSS smf_player_t smf_player;
+static bool smf_playing = false;
+static uint32_t smf_fill_max_cycles;
+static uint32_t smf_blocks;
+
+// Console line entry for editing routes
+static char route_line[48];
+static size_t route_line_len = 0;
+static bool route_line_active = false;
 
 // Test Fast Data
 FAST_DATA char test_fast_string[] = "Fast string!";
@@ -140,20 +332,26 @@ FAST_DATA static volatile int16_t *i2s_buff_write;
 FAST_DATA int i2s_write_available;
 
 void init_usart_dma_io() {
-  // MIDI Port
-  midi1_io.usartx = MIDI1_UART;
-  midi1_io.dma_rx = MIDI1_DMA_RX;
-  midi1_io.dma_rx_stream = MIDI1_DMA_RX_STREAM;
-  midi1_io.dma_tx = MIDI1_DMA_TX;
-  midi1_io.dma_tx_stream = MIDI1_DMA_TX_STREAM;
-  midi1_io.rx_buf = m1_i_buff;
-  midi1_io.rx_buf_sz = sizeof(m1_i_buff);
-  midi1_io.tx_buf1 = m1_o_buff1;
-  midi1_io.tx_buf2 = m1_o_buff2;
-  midi1_io.tx_buf_sz = sizeof(m1_o_buff1);
-
-  // TODO: Check return value
-  udcr_init(&midi1_io);
+  // MIDI ports
+  for (int p = 0; p < MIDI_PORTS; p++) {
+    usart_dma_config_t *io = &midi_io[p];
+
+    io->usartx = midi_port_hw[p].usartx;
+    io->dma_rx = midi_port_hw[p].dma_rx;
+    io->dma_rx_stream = midi_port_hw[p].dma_rx_stream;
+    io->dma_tx = midi_port_hw[p].dma_tx;
+    io->dma_tx_stream = midi_port_hw[p].dma_tx_stream;
+    io->rx_buf = midi_port_hw[p].rx_buf;
+    io->rx_buf_sz = midi_port_hw[p].rx_buf_sz;
+    io->tx_buf = midi_o_buff[p];
+    io->tx_buf_sz = sizeof(midi_o_buff[p]);
+    // Only look at the receive buffer after an interrupt says so
+    io->rx_events = true;
+    io->usart_irqn = midi_port_hw[p].irqn;
+
+    // TODO: Check return value
+    udcr_init(io);
+  }
 
   // Console
   console_io.usartx = CONSOLE_UART;
@@ -163,26 +361,157 @@ void init_usart_dma_io() {
   console_io.dma_tx_stream = CONSOLE_DMA_TX_STREAM;
   console_io.rx_buf = c_i_buff;
   console_io.rx_buf_sz = sizeof(c_i_buff);
-  console_io.tx_buf1 = c_o_buff1;
-  console_io.tx_buf2 = c_o_buff2;
-  console_io.tx_buf_sz = sizeof(c_o_buff1);
+  console_io.tx_buf = c_o_buff;
+  console_io.tx_buf_sz = sizeof(c_o_buff);
+  console_io.rx_events = true;
+  console_io.usart_irqn = CONSOLE_IRQn;
 
   // TODO: Check return value
   udcr_init(&console_io);
 }
 
+/** Reports each SysEx received on the console. */
+static void sysex_received(void *ctx, size_t total_len, int complete);
+
 /** initialize our MIDI parsers */
 void init_midi_buffers() {
-  midi_stream_init(&midi_stream_0);
+  for (int i = 0; i < MIDI_INPUTS; i++) {
+    midi_input_t *in = &midi_inputs[i];
+
+    memset(in, 0, sizeof(*in));
+    if (i < MIDI_PORTS) {
+      in->name = midi_port_hw[i].name;
+      in->io = &midi_io[i];
+      in->byte_cycles = SystemCoreClock / (MIDI_BAUD / 10);
+      in->sysex.end = sysex_received;
+      in->sysex.ctx = in;
+    } else {
+      // Serial MIDI, which has nobody to tell about SysEx
+      in->name = "console";
+      in->io = &console_io;
+      in->byte_cycles = SystemCoreClock / (CONSOLE_BAUD / 10);
+    }
+    midi_stream_init(&in->stream);
+    midi_stream_set_sysex(&in->stream, in->sysex.end != NULL ? &in->sysex : NULL);
+  }
+  midiq_init(&synth_queue);
+  midi_out_init(&midi1_out);
+  tempo_init(&midi1_tempo, SystemCoreClock);
+  midi_router_init(&midi1_router);
+  midimon_init(&midi1_mon);
+  // The synth ignores release velocity, so save the status bytes
+  midi1_out.off_as_zero_on = true;
+}
+
+/** Bytes of console output a message of priority pri may use now */
+static inline size_t serial_space(con_pri_t pri) {
+  size_t space = udcr_queue_space(&console_io);
+
+  if (serial_midi.active) {
+    // Text would go to the MIDI bridge
+    return 0;
+  }
+  return space > con_reserve[pri] ? space - con_reserve[pri] : 0;
+}
+
+/** Counts a message that was not sent */
+static inline size_t serial_drop(con_pri_t pri, size_t size) {
+  con_stats.dropped[pri]++;
+  con_stats.dropped_bytes[pri] += size;
+  return 0;
+}
+
+/** Moves waiting log messages into the console output buffer,
+ * whole ones only, as many as fit. They wait if there is no room.
+ */
+static void send_log(void) {
+  uint8_t buf[256];
+  size_t space;
+
+  if (trace_dump_active() || dlog_pending() == 0) {
+    return;
+  }
+  space = serial_space(CON_TELEMETRY);
+  if (space > sizeof(buf)) {
+    space = sizeof(buf);
+  }
+  udcr_queue_bytes(&console_io, buf, dlog_flush(buf, space));
+}
+
+/** Queues a message to be sent over our serial output, all of it or
+ * none of it (see con_pri_t).
+ * Returns # of bytes queued to send.
+ */
+static inline size_t serial_transmit(con_pri_t pri, const uint8_t *msg, uint16_t size) {
+  // Text would corrupt a binary trace dump in progress
+  if (trace_dump_active()) {
+    return 0;
+  }
+  // Keep it in order after any log messages
+  send_log();
+  if (size > serial_space(pri)) {
+    return serial_drop(pri, size);
+  }
+  con_stats.sent[pri]++;
+  return udcr_queue_bytes(&console_io, msg, size);
 }
 
-/** Queues data to be sent over our serial output.
+/** Queues constant text (in flash) to be sent over our serial output
+ * without copying it, so long menus don't fill the output buffer.
  * Returns # of bytes queued to send.
  */
-static inline size_t serial_transmit(const uint8_t *msg, uint16_t size) {
-  // TODO: Check for send buffer overflow - if sent < size
-  size_t sent = udcr_queue_bytes(&console_io, msg, size);
-  return sent;
+static inline size_t serial_transmit_const(con_pri_t pri, const char *msg) {
+  size_t size = strlen(msg);
+
+  if (trace_dump_active()) {
+    return 0;
+  }
+  send_log();
+  // It takes no buffer space, but give way to the others all the same
+  if (serial_midi.active || (con_reserve[pri] > 0 && serial_space(pri) == 0)) {
+    return serial_drop(pri, size);
+  }
+  if (udcr_queue_const(&console_io, (const uint8_t *)msg, size) == 0) {
+    return serial_drop(pri, size);
+  }
+  con_stats.sent[pri]++;
+  return size;
+}
+
+/** Queues as much of a trace dump in progress as will fit
+ * into the console output buffer.
+ */
+static void send_trace_dump(void) {
+  const uint8_t *data;
+  size_t avail, queued;
+
+  // Held until serial MIDI is over
+  if (serial_midi.active) {
+    return;
+  }
+  while ((avail = trace_dump_peek(&data)) > 0) {
+    queued = udcr_queue_bytes(&console_io, data, avail);
+    trace_dump_consume(queued);
+    if (queued < avail) {
+      // Console buffer is full
+      break;
+    }
+  }
+}
+
+/** Moves encoded MIDI output into the MIDI port queue, as much as fits.
+ * Real-time bytes are always first in line.
+ */
+static void midi_out_pump(void) {
+  uint8_t buf[MIDI_TX_BUF_SZ];
+  size_t space = udcr_queue_space(&midi_io[MIDI1_PORT]);
+
+  if (space > sizeof(buf)) {
+    space = sizeof(buf);
+  }
+  if (space > 0 && midi_out_pending(&midi1_out) > 0) {
+    udcr_queue_bytes(&midi_io[MIDI1_PORT], buf, midi_out_drain(&midi1_out, buf, space, cyclecount_now()));
+  }
 }
 
 /*
@@ -191,53 +520,290 @@ static inline size_t serial_transmit(const uint8_t *msg, uint16_t size) {
  */
 void check_io() {
   // Serial port
+  send_trace_dump();
+  send_log();
   udcr_send_from_queue(&console_io);
 
   // MIDI port
-  udcr_send_from_queue(&midi1_io);
+  midi_out_pump();
+  udcr_send_from_queue(&midi_io[MIDI1_PORT]);
 }
 
-/** Queues data to be sent over our MIDI output.
- * Returns bytes queued. */
-static inline size_t midi_transmit(const uint8_t *msg, uint16_t size) {
-  // TODO: Check for send buffer overflow
-  return udcr_queue_bytes(&midi1_io, msg, size);
+/** Waits until all the console output (including the log and any
+ * trace dump) has been sent, or timeout_ms goes by. Nothing else gets
+ * done meanwhile, audio included, so this is only for boot.
+ * Returns false if it timed out.
+ */
+static bool serial_flush_blocking(uint32_t timeout_ms) {
+  uint32_t start = HAL_GetTick();
+
+  while (udcr_tx_pending(&console_io) || dlog_pending() > 0 || trace_dump_active()) {
+    if (HAL_GetTick() - start >= timeout_ms) {
+      return false;
+    }
+    send_trace_dump();
+    send_log();
+    udcr_send_from_queue(&console_io);
+  }
+  return true;
 }
 
 /** Returns >= 256 if there is nothing to be read;
  * otherwise returns a uint8_t of what is next to be read.
  */
 static inline uint16_t serial_read() {
+  if (!udcr_rx_ready(&console_io)) {
+    return 0x100;
+  }
   return udcr_read_byte(&console_io);
 }
 
 void printWelcomeMessage(void) {
-  serial_transmit((uint8_t *)"\r\n\r\n", 4);
-  serial_transmit((uint8_t *)">", 1);
-  serial_transmit((uint8_t *)test_fast_string, tfs_len);
-  serial_transmit((uint8_t *)"<\r\n>", 4);
-  serial_transmit((uint8_t *)test_dma_string, tds_len);
-  serial_transmit((uint8_t *)"<\r\n", 3);
-  serial_transmit((uint8_t *)WELCOME_MSG, strlen(WELCOME_MSG));
-  serial_transmit((uint8_t *)MAIN_MENU, strlen(MAIN_MENU));
+  serial_transmit(CON_CHATTER, (uint8_t *)"\r\n\r\n", 4);
+  serial_transmit(CON_CHATTER, (uint8_t *)">", 1);
+  serial_transmit(CON_CHATTER, (uint8_t *)test_fast_string, tfs_len);
+  serial_transmit(CON_CHATTER, (uint8_t *)"<\r\n>", 4);
+  serial_transmit(CON_CHATTER, (uint8_t *)test_dma_string, tds_len);
+  serial_transmit(CON_CHATTER, (uint8_t *)"<\r\n", 3);
+  serial_transmit_const(CON_CHATTER, WELCOME_MSG);
+  serial_transmit_const(CON_CHATTER, MAIN_MENU);
 }
 
 static void print_spi_queue_info(spidma_config_t *spi) {
+  DLOG("ql: %d, qr: %d, sdqf: %lu, iliqf: %lu, ilics: %lu; "
+       "fqf: %lu, bfqf: %lu; "
+       "maf: %lu, sz: %u; ili_allocs: %lu, sd_frees: %lu\r\n",
+
+       spidma_queue_length(spi), spidma_queue_remaining(spi),
+       spi->entry_queue_failures,
+       ili_queue_failures, ili_characters_skipped,
+
+       spi->free_queue_failures, spi->backup_free_queue_failures,
+
+       ili_mem_alloc_failures, ili_last_alloc_failure_size,
+       ili_mem_allocs, spi->mem_frees);
+}
+
+/** Shows the SPI bus timing statistics since they were last shown,
+ * then starts a new measurement window.
+ */
+static void print_spi_bus_stats(spidma_config_t *spi) {
+#ifdef SPIDMA_STATISTICS
+  spidma_stats_t *st = &spi->stats;
+  uint64_t elapsed = spidma_stats_elapsed(spi);
+  uint32_t elapsed_ms = (uint32_t)(elapsed * 1000 / SystemCoreClock);
+  uint32_t starts = st->dma_starts > 0 ? st->dma_starts : 1;
+
+  if (elapsed == 0) {
+    elapsed = 1;
+  }
+
+  // Effective bandwidth is over the whole window; bus bandwidth only while DMA is busy
+  DLOG("\r\nSPI %lu ms: DMAs: %lu, bytes: %lu, eff: %lu B/s, "
+       "bus: %lu B/s, busy: %lu%%\r\n",
+       elapsed_ms, st->dma_starts, (uint32_t)st->bytes_sent,
+       (uint32_t)(st->bytes_sent * SystemCoreClock / elapsed),
+       st->busy_cycles > 0 ? (uint32_t)(st->bytes_sent * SystemCoreClock / st->busy_cycles) : 0,
+       (uint32_t)(st->busy_cycles * 100 / elapsed));
+
+  // Per-entry overhead, in CPU cycles
+  DLOG("setup/DMA: %lu cyc, gap/DMA: %lu cyc, max gap: %lu cyc, "
+       "starved: %lu ms, max depth: %u\r\ndepth hist:",
+       (uint32_t)(st->setup_cycles / starts),
+       (uint32_t)(st->backlogged_gap_cycles / starts),
+       st->max_backlogged_gap,
+       (uint32_t)(st->starved_gap_cycles * 1000 / SystemCoreClock),
+       st->max_depth);
+
+  for (int i = 0; i < SPIDMA_DEPTH_BUCKETS; i++) {
+    DLOG(" %lu", st->depth_histogram[i]);
+  }
+  DLOG("\r\n");
+
+  spidma_stats_reset(spi);
+#else
+  const char *msg = "\r\nNo SPIDMA_STATISTICS\r\n";
+  serial_transmit(CON_TELEMETRY, (uint8_t *)msg, strlen(msg));
+#endif
+}
+
+/** Cross-checks the MIDI parser against the reference decoder and
+ * measures its throughput. Uses a new PRNG seed each time.
+ */
+static void midi_parser_bench(void) {
+  static uint32_t seed = 0x1234567;
+  midibench_result_t r;
   char buf[200];
-  snprintf(buf, sizeof(buf),
-              "ql: %d, qr: %d, sdqf: %lu, iliqf: %lu, ilics: %lu; "
-              "fqf: %lu, bfqf: %lu; "
-              "maf: %lu, sz: %u; ili_allocs: %lu, sd_frees: %lu\r\n",
+  int l;
+
+  seed += HAL_GetTick() | 1;
+  midibench_run(seed, &r);
+  uint32_t us = cyclecount_to_us(r.bench_cycles);
+  uint32_t bulk_us = cyclecount_to_us(r.bulk_cycles);
+  if (us == 0) {
+    us = 1;
+  }
+  if (bulk_us == 0) {
+    bulk_us = 1;
+  }
 
-              spidma_queue_length(spi), spidma_queue_remaining(spi),
-              spi->entry_queue_failures,
-              ili_queue_failures, ili_characters_skipped,
+  l = snprintf(buf, sizeof(buf),
+               "\r\nSeed %08lX: %lu bytes, %lu msgs, %lu mismatches (first @%lu), %lu bulk, "
+               "SysEx %lu bytes %s\r\n"
+               "Bench: %lu bytes, %lu msgs, %lu us: %lu B/s, %lu msg/s\r\n",
+               seed, r.check_bytes, r.check_messages, r.mismatches, r.first_mismatch,
+               r.bulk_mismatches, r.sysex_bytes, r.sysex_mismatch ? "MISMATCH" : "ok",
+               r.bench_bytes, r.bench_messages, us,
+               (uint32_t)((uint64_t)r.bench_bytes * 1000000 / us),
+               (uint32_t)((uint64_t)r.bench_messages * 1000000 / us));
+  serial_transmit(CON_TELEMETRY, (uint8_t *)buf, l);
+
+  l = snprintf(buf, sizeof(buf),
+               "Bulk:  %lu bytes, %lu msgs, %lu us: %lu B/s, %lu msg/s\r\n",
+               r.bench_bytes, r.bulk_messages, bulk_us,
+               (uint32_t)((uint64_t)r.bench_bytes * 1000000 / bulk_us),
+               (uint32_t)((uint64_t)r.bulk_messages * 1000000 / bulk_us));
+  serial_transmit(CON_TELEMETRY, (uint8_t *)buf, l);
+
+  l = snprintf(buf, sizeof(buf),
+               "Encoder: %lu msgs, %lu mismatches, %lu bytes sent for %lu\r\n",
+               r.encode_messages, r.encode_mismatches, r.encode_bytes, r.encode_raw_bytes);
+  serial_transmit(CON_TELEMETRY, (uint8_t *)buf, l);
+}
 
-              spi->free_queue_failures, spi->backup_free_queue_failures,
+/** Shows what the MIDI clock tempo tracker sees */
+static void print_tempo(void) {
+  uint32_t bpm = tempo_bpm_x100(&midi1_tempo);
+  uint64_t beat = synth_beat();
 
-              ili_mem_alloc_failures, ili_last_alloc_failure_size,
-              ili_mem_allocs, spi->mem_frees);
-  serial_transmit((uint8_t *)buf, strlen(buf));
+  DLOG("\r\nTempo: %lu.%02lu BPM, %s, beat %lu.%03lu; %lu clocks, "
+       "jitter max %lu us, %lu resyncs\r\n",
+       bpm / 100, bpm % 100, midi1_tempo.running ? "running" : "stopped",
+       (uint32_t)(beat >> 32), (uint32_t)(((beat & 0xFFFFFFFF) * 1000) >> 32),
+       midi1_tempo.clocks, cyclecount_to_us(midi1_tempo.jitter_max), midi1_tempo.resyncs);
+}
+
+/** Renders the fixed synth scenarios and compares them with the
+ * golden hashes. Silences the synth.
+ */
+static void synth_golden_check(void) {
+  synthcheck_result_t r;
+  char buf[120];
+  int l;
+
+  synthcheck_run(&r);
+
+  if (r.failures == 0) {
+    l = snprintf(buf, sizeof(buf), "\r\nSynth: all %lu scenarios bit-exact\r\n", r.scenarios);
+  } else {
+    l = snprintf(buf, sizeof(buf),
+                 "\r\nSynth: %lu of %lu FAILED; first: %s, samples %lu-%lu\r\n",
+                 r.failures, r.scenarios,
+                 synthcheck_scenario_names[r.failed_scenario],
+                 r.first_bad_sample, r.last_bad_sample);
+  }
+  serial_transmit(r.failures == 0 ? CON_TELEMETRY : CON_ERROR, (uint8_t *)buf, l);
+}
+
+/** Shows stack, heap and static RAM usage, including the high-water
+ * marks since boot.
+ */
+static void print_memory_usage(void) {
+  memstats_t ms;
+
+  memstats_get(&ms);
+
+  DLOG("\r\nStack: peak %u of %u (%u%%), now %u\r\n",
+       ms.stack_peak, ms.stack_size, ms.stack_peak * 100 / ms.stack_size, ms.stack_now);
+  DLOG("Heap: brk %u, peak %u of %u; malloc used %u, free %u; sbrk fails %lu\r\n",
+       ms.heap_brk, ms.heap_brk_peak, ms.heap_size,
+       ms.malloc_in_use, ms.malloc_free, ms.sbrk_failures);
+  DLOG("FASTRAM: %u of %u; DMARAM: %u of %u; RAM static: %u\r\n",
+       ms.fastram_used, ms.fastram_size, ms.dmaram_used, ms.dmaram_size,
+       ms.ram_static);
+}
+
+/** Makes the console carry MIDI, merged with the ports' by
+ * check_midi_input().
+ */
+static void serial_midi_begin(void) {
+  serial_transmit_const(CON_TELEMETRY, "\r\nSerial MIDI; FD FD FD to end\r\n");
+
+  serial_midi.active = true;
+  serial_midi.escape_run = 0;
+  serial_midi.escaped = false;
+  serial_midi.sessions++;
+  serial_midi.start_ms = HAL_GetTick();
+  serial_midi.max_pass = 0;
+  serial_midi.start_bytes = serial_midi.bytes;
+  serial_midi.start_messages = midi_inputs[MIDI_PORT_CONSOLE].messages;
+  serial_midi.start_rx_lost = console_io.rx_lost;
+  serial_midi.start_queued = synth_queue.pushed;
+  serial_midi.start_queue_dropped = synth_queue.overflows;
+  serial_midi.start_synth = synth_stats;
+  // Whatever was left half parsed last time is long gone
+  midi_stream_resync(&midi_inputs[MIDI_PORT_CONSOLE].stream);
+  // A different clock now; lock on to it afresh
+  tempo_init(&midi1_tempo, SystemCoreClock);
+}
+
+/** Goes back to the console menu, and shows what the session took in
+ * and how the parser, synth queue and voices kept up.
+ */
+static void serial_midi_end(void) {
+  uint32_t ms = HAL_GetTick() - serial_midi.start_ms;
+  uint32_t bytes = serial_midi.bytes - serial_midi.start_bytes;
+  uint32_t msgs = midi_inputs[MIDI_PORT_CONSOLE].messages - serial_midi.start_messages;
+
+  serial_midi.active = false;
+  serial_midi.escaped = false;
+  // Back to the MIDI1 clock
+  tempo_init(&midi1_tempo, SystemCoreClock);
+  if (ms == 0) {
+    ms = 1;
+  }
+
+  DLOG("\r\nSerial MIDI: %lu B, %lu msgs in %lu ms: %lu B/s, %lu msg/s; max %lu B/pass\r\n",
+       bytes, msgs, ms, (uint32_t)((uint64_t)bytes * 1000 / ms),
+       (uint32_t)((uint64_t)msgs * 1000 / ms), serial_midi.max_pass);
+  DLOG("RX lost %lu B; synth queue %lu queued, %lu dropped, %lu max\r\n",
+       console_io.rx_lost - serial_midi.start_rx_lost,
+       synth_queue.pushed - serial_midi.start_queued,
+       synth_queue.overflows - serial_midi.start_queue_dropped, synth_queue.high_water);
+  DLOG("Voices: %lu on, %lu off, %lu retriggered, %lu no voice, %lu stray off\r\n",
+       synth_stats.note_ons - serial_midi.start_synth.note_ons,
+       synth_stats.note_offs - serial_midi.start_synth.note_offs,
+       synth_stats.retriggers - serial_midi.start_synth.retriggers,
+       synth_stats.no_voice - serial_midi.start_synth.no_voice,
+       synth_stats.stray_offs - serial_midi.start_synth.stray_offs);
+}
+
+/** Takes what the console received as MIDI, up to and including the
+ * escape; anything after that is for the menu.
+ */
+static void serial_midi_take(midi_input_t *in) {
+  bool escaped = false;
+
+  in->total = 0;
+  for (int s = 0; s < 2; s++) {
+    for (size_t i = 0; i < in->spans.len[s] && !escaped; i++) {
+      serial_midi.escape_run = in->spans.buf[s][i] == SERIAL_MIDI_ESCAPE ? serial_midi.escape_run + 1 : 0;
+      if (serial_midi.escape_run == SERIAL_MIDI_ESCAPE_LEN) {
+        in->spans.len[s] = i + 1;
+        escaped = true;
+      }
+    }
+    if (escaped && s == 0) {
+      in->spans.len[1] = 0;
+    }
+    in->total += in->spans.len[s];
+  }
+
+  serial_midi.escaped = escaped;
+  serial_midi.bytes += in->total;
+  if (in->total > serial_midi.max_pass) {
+    serial_midi.max_pass = in->total;
+  }
 }
 
 static int prompted = 0;
@@ -249,8 +815,12 @@ static int prompted = 0;
 uint8_t read_user_input(void) {
   uint16_t c;
 
-  if (!prompted) {
-    serial_transmit((uint8_t*)PROMPT, strlen(PROMPT));
+  // The console is carrying MIDI; see check_midi_input()
+  if (serial_midi.active) {
+    return 0;
+  }
+  if (!prompted && !route_line_active) {
+    serial_transmit(CON_CHATTER, (uint8_t*)PROMPT, strlen(PROMPT));
     prompted = 1;
   }
 
@@ -291,7 +861,7 @@ void alloc_test() {
       total += amount;
       snprintf(msg, sizeof(msg) - 1, "Addr: %08lX; amt: %u; total: %lx\r\n", (uint32_t)m, amount, (uint32_t)total);
     }
-    serial_transmit((uint8_t *)msg, strlen(msg));
+    serial_transmit(m == NULL ? CON_ERROR : CON_TELEMETRY, (uint8_t *)msg, strlen(msg));
 
     // Send I/O and delay before doing this again
     t = HAL_GetTick();
@@ -302,20 +872,21 @@ void alloc_test() {
 }
 
 void clear_uart_flags() {
+  USART_TypeDef *u = midi_io[MIDI1_PORT].usartx;
   char msg[64];
   snprintf(msg, sizeof(msg), "\r\nLBD: %c, PE: %c, NE: %c, ORE: %c, IDLE: %c\r\n",
-           LL_USART_IsActiveFlag_LBD(MIDI1_UART) ? 'A' : '-',
-           LL_USART_IsActiveFlag_PE(MIDI1_UART) ? 'A' : '-',
-           LL_USART_IsActiveFlag_NE(MIDI1_UART) ? 'A' : '-',
-           LL_USART_IsActiveFlag_ORE(MIDI1_UART) ? 'A' : '-',
-           LL_USART_IsActiveFlag_IDLE(MIDI1_UART) ? 'A' : '-');
-  serial_transmit((uint8_t *)msg,  strlen(msg));
-
-  LL_USART_ClearFlag_LBD(MIDI1_UART);
-  LL_USART_ClearFlag_PE(MIDI1_UART);
-  LL_USART_ClearFlag_NE(MIDI1_UART);
-  LL_USART_ClearFlag_ORE(MIDI1_UART);
-  LL_USART_ClearFlag_IDLE(MIDI1_UART);
+           LL_USART_IsActiveFlag_LBD(u) ? 'A' : '-',
+           LL_USART_IsActiveFlag_PE(u) ? 'A' : '-',
+           LL_USART_IsActiveFlag_NE(u) ? 'A' : '-',
+           LL_USART_IsActiveFlag_ORE(u) ? 'A' : '-',
+           LL_USART_IsActiveFlag_IDLE(u) ? 'A' : '-');
+  serial_transmit(CON_TELEMETRY, (uint8_t *)msg,  strlen(msg));
+
+  LL_USART_ClearFlag_LBD(u);
+  LL_USART_ClearFlag_PE(u);
+  LL_USART_ClearFlag_NE(u);
+  LL_USART_ClearFlag_ORE(u);
+  LL_USART_ClearFlag_IDLE(u);
 }
 
 /*
@@ -352,6 +923,116 @@ void ll_usart_interrupt_handler(USART_TypeDef *u) {
   }
 }
 
+/** Shows how the song played: how much, and the worst case block
+ * render time against the time there is for a block.
+ */
+static void print_smf_stats(void) {
+  char buf[160];
+  int l;
+
+  l = snprintf(buf, sizeof(buf),
+               "\r\nSMF: %lu events, %lu tempo changes, %lu errors, %lu blocks; "
+               "max fill %lu us of %lu us\r\n",
+               smf_player.events, smf_player.tempo_changes, smf_player.errors, smf_blocks,
+               cyclecount_to_us(smf_fill_max_cycles),
+               (uint32_t)((uint64_t)1000000 * (I2S_BUFFER_SIZE / 2) / AUDIO_SAMPLE_RATE));
+  serial_transmit(CON_TELEMETRY, (uint8_t *)buf, l);
+}
+
+/** Starts the demo song from the beginning, or stops it. */
+static void smf_play_toggle(void) {
+  char buf[80];
+  int l;
+
+  if (smf_playing) {
+    smf_playing = false;
+    // Silence whatever was left playing
+    synth_init(AUDIO_SAMPLE_RATE);
+    print_smf_stats();
+    return;
+  }
+
+  if (smf_open(&smf_player, smf_demo, smf_demo_len, AUDIO_SAMPLE_RATE) != 0) {
+    l = snprintf(buf, sizeof(buf), "\r\nSMF: not a file we can play\r\n");
+    serial_transmit(CON_ERROR, (uint8_t *)buf, l);
+    return;
+  }
+  smf_fill_max_cycles = 0;
+  smf_blocks = 0;
+  smf_playing = true;
+  l = snprintf(buf, sizeof(buf), "\r\nSMF: playing %u tracks, %u ticks/quarter\r\n",
+               smf_player.num_tracks, smf_player.division);
+  serial_transmit(CON_TELEMETRY, (uint8_t *)buf, l);
+}
+
+/** Shows each MIDI route's rule and message count */
+static void print_midi_routes(void) {
+  char buf[200];
+  int l;
+
+  serial_transmit(CON_TELEMETRY, (uint8_t *)"\r\n", 2);
+  for (int i = 0; i < MIDI_ROUTES; i++) {
+    l = midi_router_snprintf(buf, sizeof(buf) - 2, &midi1_router, i);
+    if (l > (int)sizeof(buf) - 3) {
+      l = sizeof(buf) - 3;
+    }
+    buf[l++] = '\r';
+    buf[l++] = '\n';
+    serial_transmit(CON_TELEMETRY, (uint8_t *)buf, l);
+  }
+  l = snprintf(buf, sizeof(buf), "rejected %lu msgs\r\n", midi1_router.rejected);
+  serial_transmit(CON_TELEMETRY, (uint8_t *)buf, l);
+}
+
+/** Shows how each MIDI input's messages fared in the merge, then
+ * starts the waits and latencies over.
+ */
+static void print_midi_inputs(void) {
+  DLOG("\r\nMerge: %lu passes, %lu shared, %lu switches, %lu msgs max\r\n",
+       midi_merge.passes, midi_merge.shared, midi_merge.switches, midi_merge.max_messages);
+  for (int i = 0; i < MIDI_INPUTS; i++) {
+    midi_input_t *in = &midi_inputs[i];
+
+    DLOG("%s: %lu msgs, %lu lost B; wait max %lu us; synth %lu, avg %lu max %lu us\r\n",
+         in->name, in->messages, in->io->rx_lost, cyclecount_to_us(in->wait_max),
+         in->synth_count,
+         in->synth_count == 0 ? 0 : cyclecount_to_us((uint32_t)(in->synth_total / in->synth_count)),
+         cyclecount_to_us(in->synth_max));
+    in->wait_max = 0;
+    in->synth_count = 0;
+    in->synth_total = 0;
+    in->synth_max = 0;
+  }
+}
+
+/** Takes console characters for a route command until Enter (or
+ * Escape to cancel), then applies it.
+ */
+static void route_line_input(uint8_t c) {
+  const char *result;
+
+  if (c == '\r' || c == '\n') {
+    route_line_active = false;
+    route_line[route_line_len] = '\0';
+    if (route_line_len == 0) {
+      return;
+    }
+    result = midi_router_command(&midi1_router, route_line) == 0 ? "\r\nOK" :
+        "\r\nUse: synth|thru|mon|disp all|none, or ch|type|note|cc [+-]item[-item]...";
+    serial_transmit(CON_CHATTER, (uint8_t *)result, strlen(result));
+  } else if (c == 0x1B) {
+    route_line_active = false;
+  } else if (c == '\b' || c == 0x7F) {
+    if (route_line_len > 0) {
+      route_line_len--;
+      serial_transmit(CON_CHATTER, (uint8_t *)"\b \b", 3);
+    }
+  } else if (c >= ' ' && c < 0x7F && route_line_len < sizeof(route_line) - 1) {
+    route_line[route_line_len++] = c;
+    serial_transmit(CON_CHATTER, &c, 1);
+  }
+}
+
 /** Interprets numbers as menu options.
  * Interprets letters as notes to send via MIDI.
  * Ignores the rest.
@@ -366,10 +1047,15 @@ uint8_t process_user_input(uint8_t opt) {
     return 0;
   }
 
+  if (route_line_active) {
+    route_line_input(opt);
+    return 1;
+  }
+
   char msg[100];
   midi_message mm;
 
-  serial_transmit(&opt, 1);
+  serial_transmit(CON_CHATTER, &opt, 1);
 
   switch (opt) {
   case '1':
@@ -385,22 +1071,104 @@ uint8_t process_user_input(uint8_t opt) {
     l = snprintf(msg, sizeof(msg) - 1, "\r\nBTN1 status: %s",
                   // Button pressed pulls it down to 0
                   HAL_GPIO_ReadPin(BTN1_GPIO_Port, BTN1_Pin) == GPIO_PIN_RESET ? "PRESSED" : "RELEASED");
-    serial_transmit((uint8_t*)msg, l);
+    serial_transmit(CON_TELEMETRY, (uint8_t*)msg, l);
     break;
   case '5':
     l = snprintf(msg, sizeof(msg) - 1, "\r\nBTN2 status: %s",
                   // Button pressed pulls it down to 0
                   HAL_GPIO_ReadPin(BTN2_GPIO_Port, BTN2_Pin) == GPIO_PIN_RESET ? "PRESSED" : "RELEASED");
-    serial_transmit((uint8_t*)msg, l);
+    serial_transmit(CON_TELEMETRY, (uint8_t*)msg, l);
     break;
   case '6':
-    l = snprintf(msg, sizeof(msg) - 1, "\r\nUA3I: %lu, ORE: %lu, MIDI_ORE: %lu, MIDI_RX: %lu, LPT: %lu\r\n",
-                  usart3_interrupts, overrun_errors, midi_overrun_errors, midi_received, loops_per_tick);
-    serial_transmit((uint8_t*)msg, l);
+    DLOG("\r\nUA3I: %lu, ORE: %lu, MIDI_ORE: %lu, MIDI_RX: %lu, LPT: %lu\r\n",
+         usart3_interrupts, overrun_errors, midi_overrun_errors, midi_received, loops_per_tick);
+    DLOG("Synth queue: %lu now, %lu max of %u; %lu queued, %lu dropped\r\n",
+         midiq_depth(&synth_queue), synth_queue.high_water, MIDIQ_SIZE,
+         synth_queue.pushed, synth_queue.overflows);
+    for (int p = 0; p < MIDI_PORTS; p++) {
+      const midi_input_t *in = &midi_inputs[p];
+
+      DLOG("RX %s: %lu B, %lu events (%lu B last), peak %lu of %u, %lu overruns, %lu lost, %lu line errors\r\n",
+           in->name, in->io->rx_total, in->io->rx_notify, in->io->rx_available,
+           in->io->rx_peak, in->io->rx_buf_sz, in->io->rx_overruns, in->io->rx_lost,
+           in->io->rx_line_errors);
+      DLOG("  SysEx %lu ok, %lu truncated, %lu overflowed (%lu B); RT %lu\r\n",
+           in->stream.sysex_complete, in->stream.sysex_truncated,
+           in->stream.sysex_overflows, in->stream.sysex_dropped,
+           in->rt_messages);
+    }
+    DLOG("RX console: %lu B, %lu events, peak %lu of %u, %lu overruns, %lu lost, %lu line errors\r\n",
+         console_io.rx_total, console_io.rx_notify, console_io.rx_peak, console_io.rx_buf_sz,
+         console_io.rx_overruns, console_io.rx_lost, console_io.rx_line_errors);
+    DLOG("TX console: %lu copied, %lu borrowed, %lu bounced, %lu lost, %lu chain\r\n",
+         console_io.tx_copied, console_io.tx_borrowed, console_io.tx_bounced,
+         console_io.tx_dropped, console_io.tx_chained);
+    DLOG("Monitor: %lu printed, %lu summarized, %lu overwritten, %lu full\r\n",
+         midi1_mon.printed, midi1_mon.summarized, midi1_mon.overwritten, midi1_mon.console_full);
+    DLOG("Display: %lu redraws, %lu msgs coalesced\r\n",
+         midi1_mon.redraws, midi1_mon.coalesced);
+    DLOG("MIDI out: %lu msgs, %lu RT, %lu dropped, %lu saved, %lu B, %lu ms\r\n",
+         midi1_out.messages, midi1_out.realtime, midi1_out.dropped, midi1_out.status_saved,
+         midi1_out.bytes_sent, midi_out_wire_ms(&midi1_out));
+    DLOG("MIDI thru %s: %lu fwd, %lu B dropped, latency avg %lu max %lu us\r\n",
+         midi1_thru ? "on" : "off", midi1_out.forwarded, midi1_out.dropped_bytes,
+         midi1_out.latency_count == 0 ? 0 :
+             cyclecount_to_us(midi1_out.latency_total / midi1_out.latency_count),
+         cyclecount_to_us(midi1_out.latency_max));
+    DLOG("Log %s: %lu msgs, %lu dropped, %lu frames, %lu lines, %lu B\r\n",
+         dlog_binary() ? "binary" : "text", dlog_stats.logged, dlog_stats.dropped,
+         dlog_stats.frames, dlog_stats.lines, dlog_stats.bytes);
+    DLOG("Console drops: %lu/%lu error, %lu/%lu telemetry, %lu/%lu chatter, %lu B\r\n",
+         con_stats.dropped[CON_ERROR], con_stats.sent[CON_ERROR],
+         con_stats.dropped[CON_TELEMETRY], con_stats.sent[CON_TELEMETRY],
+         con_stats.dropped[CON_CHATTER], con_stats.sent[CON_CHATTER],
+         con_stats.dropped_bytes[CON_ERROR] + con_stats.dropped_bytes[CON_TELEMETRY] +
+             con_stats.dropped_bytes[CON_CHATTER]);
+    DLOG("Telemetry %s: %lu frames, %lu dropped, %lu B\r\n",
+         telem.streaming ? (telem.audio ? "on+audio" : "on") : "off",
+         telem.frames, telem.dropped, telem.bytes);
+    DLOG("Serial MIDI: %lu sessions, %lu B, %lu msgs\r\n",
+         serial_midi.sessions, serial_midi.bytes, midi_inputs[MIDI_PORT_CONSOLE].messages);
+    DLOG("Voices: %lu on, %lu off, %lu retriggered, %lu no voice, %lu stray off\r\n",
+         synth_stats.note_ons, synth_stats.note_offs, synth_stats.retriggers,
+         synth_stats.no_voice, synth_stats.stray_offs);
     break;
   case '7':
     print_spi_queue_info(spip);
     break;
+  case '8':
+    print_spi_bus_stats(spip);
+    break;
+  case '9':
+    midi_parser_bench();
+    break;
+  case 'S':
+    synth_golden_check();
+    break;
+  case 't':
+    // Sent a bit at a time by check_io(); see Tools/trace2chrome.py
+    trace_dump_begin();
+    break;
+  case 'l':
+    // Log frames for Tools/dlogdecode.py from here on
+    dlog_set_binary(true);
+    DLOG("\r\nLog binary\r\n");
+    break;
+  case 'L':
+    dlog_set_binary(false);
+    DLOG("\r\nLog text\r\n");
+    break;
+  case 'T':
+    // Frames for Tools/telemrx.py
+    telem_set_streaming(!telem.streaming, HAL_GetTick());
+    break;
+  case 'A':
+    telem.audio = !telem.audio;
+    break;
+  case 'M':
+    // For a MIDI<->serial bridge or Tools/serialmidi.py
+    serial_midi_begin();
+    break;
   case 'a':
     HAL_GPIO_TogglePin(AUDIO_MUTE_GPIO_Port, AUDIO_MUTE_Pin);
     break;
@@ -417,22 +1185,56 @@ uint8_t process_user_input(uint8_t opt) {
     mm.type = MIDI_NOTE_ON;
     mm.note = 64;
     mm.velocity = 80;
-    synth_process_midi(&mm);
+    midiq_push(&synth_queue, cyclecount_now(), MIDI_PORT_LOCAL, &mm);
     break;
   case 'r':
     // Stop that same note
     mm.type = MIDI_NOTE_OFF;
     mm.note = 64;
     mm.velocity = 77;
-    synth_process_midi(&mm);
+    midiq_push(&synth_queue, cyclecount_now(), MIDI_PORT_LOCAL, &mm);
     break;
   case 'd':
     // Send note on
-    midi_transmit(NOTE_ON, NOTE_ON_START_LEN);
+    mm.type = MIDI_NOTE_ON;
+    mm.channel = 0;
+    mm.note = 60;
+    mm.velocity = 64;
+    midi_out_send(&midi1_out, &mm);
     break;
   case 'f':
     // Send note off
-    midi_transmit(NOTE_OFF, NOTE_OFF_START_LEN);
+    mm.type = MIDI_NOTE_OFF;
+    mm.channel = 0;
+    mm.note = 60;
+    mm.velocity = 64;
+    midi_out_send(&midi1_out, &mm);
+    break;
+  case 'b':
+    print_tempo();
+    break;
+  case 'p':
+    smf_play_toggle();
+    break;
+  case 'i':
+    print_midi_inputs();
+    break;
+  case 'u':
+    print_midi_routes();
+    break;
+  case 'R':
+    // The rest of the line is a route command; see midiroute.c
+    serial_transmit(CON_CHATTER, (uint8_t *)"\r\nroute> ", strlen("\r\nroute> "));
+    route_line_len = 0;
+    route_line_active = true;
+    break;
+  case 'h':
+    midi1_thru = !midi1_thru;
+    l = snprintf(msg, sizeof(msg) - 1, "\r\nMIDI thru %s\r\n", midi1_thru ? "on" : "off");
+    serial_transmit(CON_TELEMETRY, (uint8_t*)msg, l);
+    break;
+  case 'm':
+    print_memory_usage();
     break;
   case '(':
     // Use all memory
@@ -449,14 +1251,14 @@ uint8_t process_user_input(uint8_t opt) {
     HAL_GPIO_TogglePin(HP_GAIN0_GPIO_Port, HP_GAIN0_Pin);
     l = snprintf(msg, sizeof(msg) - 1, "\r\nGAIN0 now: %d\r\n",
                  HAL_GPIO_ReadPin(HP_GAIN0_GPIO_Port, HP_GAIN0_Pin));
-    serial_transmit((uint8_t *)msg, l);
+    serial_transmit(CON_TELEMETRY, (uint8_t *)msg, l);
     // TODO: Show gain status on display
     break;
   case 'G':
     HAL_GPIO_TogglePin(HP_GAIN1_GPIO_Port, HP_GAIN1_Pin);
     l = snprintf(msg, sizeof(msg) - 1, "\r\nGAIN1 now: %d\r\n",
                  HAL_GPIO_ReadPin(HP_GAIN1_GPIO_Port, HP_GAIN1_Pin));
-    serial_transmit((uint8_t *)msg, l);
+    serial_transmit(CON_TELEMETRY, (uint8_t *)msg, l);
     break;
   case '~':
   case '`':
@@ -469,14 +1271,6 @@ uint8_t process_user_input(uint8_t opt) {
   return 1;
 }
 
-/** Reads from our MIDI input ring buffer.
- * Returns 0-255 when byte received.
- * Returns 256+ when no byte received.
- */
-static inline uint16_t read_midi(void) {
-  return udcr_read_byte(&midi1_io);
-}
-
 // I2S Callbacks ///////////////////////////////////////////////////////////////
 
 /** We have transmitted half the data; we can now re-fill the front
@@ -499,62 +1293,369 @@ void HAL_I2S_TxCpltCallback(I2S_HandleTypeDef *hi2s) {
  * amount of stuff to do.
  */
 void fill_i2s_data() {
+  uint32_t audio_block_cycles = (uint64_t)SystemCoreClock * (I2S_BUFFER_SIZE / 2) / AUDIO_SAMPLE_RATE;
+  uint8_t half = i2s_buff_write != i2s_buff;
+  midiq_event_t ev;
+
+  TRACE(TRACE_AUDIO_FILL_BEGIN, half, I2S_BUFFER_SIZE / 2);
+
+  // Everything received since the last block takes effect at this block boundary
+  while (midiq_pop(&synth_queue, &ev)) {
+    if (ev.port < MIDI_INPUTS) {
+      midi_input_t *in = &midi_inputs[ev.port];
+      uint32_t latency = cyclecount_now() - ev.timestamp;
+
+      in->synth_count++;
+      in->synth_total += latency;
+      if (latency > in->synth_max) {
+        in->synth_max = latency;
+      }
+    }
+    synth_process_midi(&ev.msg);
+  }
+
+  // Aim the synth beat at where the tempo says the end of this block is
+  synth_set_beat(tempo_beat(&midi1_tempo, cyclecount_now() + audio_block_cycles),
+                 midi1_tempo.epoch, I2S_BUFFER_SIZE / 2);
+
   // Cast to remove volatility
-  synth_fill((int16_t *)i2s_buff_write, I2S_BUFFER_SIZE / 2);
+  if (smf_playing) {
+    uint32_t start = cyclecount_now();
+    smf_playing = smf_play_block(&smf_player, (int16_t *)i2s_buff_write, I2S_BUFFER_SIZE / 2);
+    uint32_t cycles = cyclecount_now() - start;
+    if (cycles > smf_fill_max_cycles) {
+      smf_fill_max_cycles = cycles;
+    }
+    smf_blocks++;
+    if (!smf_playing) {
+      print_smf_stats();
+    }
+  } else {
+    synth_fill((int16_t *)i2s_buff_write, I2S_BUFFER_SIZE / 2);
+  }
+  telem_audio_add((int16_t *)i2s_buff_write, I2S_BUFFER_SIZE / 2);
 
   // TODO: Deal with race condition - what if the buffer empties
   // while we're doing this? Should we set the flag to 0 at the
   // very start?
   i2s_write_available = 0;
+  TRACE(TRACE_AUDIO_FILL_END, half, 0);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-/** Reads any pending MIDI inputs.
- *
- * For note On: Sets the frequency and amplitude and switches
- * the tone generator to that. Records the current playing note number.
+/** The input the tempo tracker takes its clock from */
+static inline uint8_t tempo_port(void) {
+  return serial_midi.active ? MIDI_PORT_CONSOLE : MIDI1_PORT;
+}
+
+/** Handles one received MIDI message from port (a MIDI_PORT_ tag):
+ * queues it for the synth and shows it on the console and the display.
+ */
+static void handle_midi_message(midi_message *mm, uint32_t received, uint8_t port) {
+  uint8_t routes;
+
+  TRACE(TRACE_MIDI_MESSAGE, mm->type, mm->data1 | (mm->data2 << 8));
+
+  // The tempo tracker follows one clock: MIDI1's, or serial MIDI's
+  // while that stands in for it
+  if (port == tempo_port()) {
+    tempo_process_midi(&midi1_tempo, mm, received);
+  }
+
+  routes = midi_route(&midi1_router, mm);
+
+  // Thru is MIDI1 in to MIDI1 out only; the other inputs would swamp it
+  if (midi1_thru && port == MIDI1_PORT && (routes & MIDI_ROUTE_THRU)) {
+    midi_out_forward(&midi1_out, mm, received);
+  }
+
+  if (routes & MIDI_ROUTE_SYNTH) {
+    // The synth takes it at the next audio block
+    midiq_push(&synth_queue, received, port, mm);
+  }
+
+  // Shown a few times a second by check_midi_monitor()
+  if (routes & MIDI_ROUTE_MONITOR) {
+    midimon_console_add(&midi1_mon, mm);
+  }
+  if (routes & MIDI_ROUTE_DISPLAY) {
+    midimon_display_add(&midi1_mon, mm);
+  }
+}
+
+/** Shows what MIDI1 has received on the console and the display,
+ * no more often than midimon allows, and only when there is room.
+ */
+static void check_midi_monitor(void) {
+  char buf[256];
+  // Two full rows of Font_7x10 (320 / 7 = 45 wide) plus the NUL.
+  // Writing the whole width every time overwrites the previous
+  // message without a flickering black fill first.
+  char line[91];
+  size_t space = serial_space(CON_TELEMETRY);
+  size_t l;
+
+  l = midimon_console_flush(&midi1_mon, HAL_GetTick(), buf, space < sizeof(buf) ? space : sizeof(buf));
+  if (l > 0) {
+    serial_transmit(CON_TELEMETRY, (uint8_t *)buf, l);
+  }
+
+  // Wait for the previous drawing to finish, so the SPI queue never floods
+  if (spidma_queue_length(spip) == 0 &&
+      midimon_display_flush(&midi1_mon, HAL_GetTick(), line, sizeof(line)) > 0) {
+    spidma_ili9341_write_string(spip, 0, 0, line, Font_7x10, ILI9341_CYAN, ILI9341_BLACK);
+  }
+}
+
+/** Queues one telemetry frame, whole or not at all. */
+static void send_telemetry(const void *payload, size_t len) {
+  // Big enough for the largest payload, the snapshot
+  uint8_t frame[TELEM_FRAME_MAX(sizeof(telem_snapshot_t))];
+  size_t l = telem_frame(frame, sizeof(frame), payload, len);
+
+  if (l > 0 && serial_transmit(CON_TELEMETRY, frame, l) == l) {
+    telem.frames++;
+    telem.bytes += l;
+  } else {
+    telem.dropped++;
+  }
+}
+
+/** While streaming, sends decimated audio as it is collected, and a
+ * snapshot every TELEM_PERIOD_MS.
+ */
+static void check_telemetry(void) {
+  telem_snapshot_t snap;
+  const telem_audio_t *audio;
+  uint32_t now = HAL_GetTick();
+
+  if (!telem.streaming) {
+    return;
+  }
+  if ((audio = telem_audio_take(now)) != NULL) {
+    send_telemetry(audio, sizeof(*audio));
+  }
+  if (now - telem.last_ms < TELEM_PERIOD_MS) {
+    return;
+  }
+  telem.last_ms = now;
+
+  telem_header(&snap.hdr, TELEM_SNAPSHOT, now);
+  snap.cpu_hz = SystemCoreClock;
+  for (int v = 0; v < SYNTH_POLYPHONY; v++) {
+    snap.voices[v].on = voices[v].state != voice_off;
+    snap.voices[v].note = voices[v].note;
+    snap.voices[v].ampl = voices[v].tonegen.desired_ampl;
+    snap.voices[v].freq = voices[v].tonegen.desired_freq;
+  }
+
+  snap.midi_rx_bytes = 0;
+  snap.midi_rx_lost = 0;
+  snap.rt_msgs = 0;
+  for (int p = 0; p < MIDI_PORTS; p++) {
+    snap.midi_rx_bytes += midi_io[p].rx_total;
+    snap.midi_rx_lost += midi_io[p].rx_lost;
+    snap.rt_msgs += midi_inputs[p].rt_messages;
+  }
+  snap.synth_msgs = synth_queue.pushed;
+  snap.synth_dropped = synth_queue.overflows;
+  snap.midi_out_msgs = midi1_out.messages;
+  snap.midi_out_dropped = midi1_out.dropped;
+  snap.console_dropped = con_stats.dropped[CON_ERROR] + con_stats.dropped[CON_TELEMETRY] +
+      con_stats.dropped[CON_CHATTER];
+  snap.log_dropped = dlog_stats.dropped;
+  snap.spi_queue_failures = spip->entry_queue_failures;
+  snap.loops_per_tick = loops_per_tick;
+
+  snap.synth_queue = midiq_depth(&synth_queue);
+  snap.midi_out_queue = midi_out_pending(&midi1_out);
+  snap.console_tx = console_io.tx_buf_head - console_io.tx_buf_tail;
+  snap.spi_queue = spidma_queue_length(spip);
+  snap.log_queue = dlog_pending();
+
+  telem_take_zones(&snap);
+  send_telemetry(&snap, sizeof(snap));
+}
+
+static void sysex_received(void *ctx, size_t total_len, int complete) {
+  const midi_input_t *in = ctx;
+  char msg[48];
+  int l;
+
+  l = snprintf(msg, sizeof(msg), "SysEx %s: %u bytes%s\r\n",
+               in->name, total_len, complete ? "" : " (truncated)");
+  serial_transmit(complete ? CON_TELEMETRY : CON_ERROR, (uint8_t *)msg, l);
+}
+
+/** midirt_scan() handler: handles a real-time message right away */
+static void midi_input_rt(void *ctx, uint32_t timestamp, uint8_t status) {
+  midi_input_t *in = ctx;
+  midi_message mm = { .type = status };
+
+  // Undefined ones (including SERIAL_MIDI_ESCAPE) are to be ignored
+  if (status == 0xF9 || status == 0xFD) {
+    return;
+  }
+  handle_midi_message(&mm, timestamp, in - midi_inputs);
+  in->messages++;
+  in->rt_messages++;
+}
+
+/** Reads what an input has received, right where the DMA put it, and
+ * handles its real-time bytes, ahead of whatever they arrived among.
+ * Returns how many bytes there are; midi_input_next() parses them.
+ */
+static size_t midi_input_begin(midi_input_t *in) {
+  uint8_t port = in - midi_inputs;
+
+  in->total = 0;
+  in->pending = false;
+  if (port == MIDI_PORT_CONSOLE && !serial_midi.active) {
+    // The menu has the console
+    return 0;
+  }
+  if (!udcr_rx_ready(in->io)) {
+    // No receive interrupt since we last read everything
+    return 0;
+  }
+  in->total = udcr_peek_spans(in->io, &in->spans);
+  if (in->spans.lost > 0) {
+    // Whatever was partly received is gone
+    midi_stream_resync(&in->stream);
+  }
+  if (in->total == 0) {
+    return 0;
+  }
+  in->received = cyclecount_now();
+  in->parsed = 0;
+  in->span = 0;
+  in->pos = 0;
+
+  if (port == MIDI_PORT_CONSOLE) {
+    serial_midi_take(in);
+  }
+
+  // The last byte came in at in->received, at the latest
+  midirt_scan(in->spans.buf[0], in->spans.len[0],
+              in->received - in->spans.len[1] * in->byte_cycles, in->byte_cycles,
+              midi_input_rt, in);
+  midirt_scan(in->spans.buf[1], in->spans.len[1], in->received, in->byte_cycles,
+              midi_input_rt, in);
+  return in->total;
+}
+
+/** Parses an input's next message (other than real-time ones) into
+ * in->next. Its timestamp is when its last byte came in: all of the
+ * bytes after it came in one byte time apart before in->received, at
+ * the latest. Returns false when there are no more.
+ */
+static bool midi_input_next(midi_input_t *in) {
+  size_t used, len;
+
+  while (in->span < 2) {
+    len = in->spans.len[in->span];
+    if (in->pos >= len) {
+      in->span++;
+      in->pos = 0;
+      continue;
+    }
+    // One at a time, so used ends right after the message
+    if (midi_stream_receive_buf(&in->stream, in->spans.buf[in->span] + in->pos, len - in->pos,
+                                &in->next.msg, 1, &used) == 0) {
+      in->pos += used;
+      in->parsed += used;
+      continue;
+    }
+    in->pos += used;
+    in->parsed += used;
+    // The parser finds the real-time messages again; skip those
+    if (in->next.msg.type < MIDI_RT_TIMING_CLOCK) {
+      in->next.timestamp = in->received - (in->total - in->parsed) * in->byte_cycles;
+      in->next.port = in - midi_inputs;
+      in->pending = true;
+      return true;
+    }
+  }
+  in->pending = false;
+  return false;
+}
+
+/** Handles all pending MIDI input from every port (and the console, in
+ * serial MIDI mode) at once, with one read of each DMA position.
  *
- * For note Off: If currently playing note number, turns it off.
- * Otherwise ignores it.
+ * The inputs are merged into one stream in the order the messages came
+ * in: each input's messages are in order already, so the next one is
+ * always the earliest of the inputs' next ones. Ties go to each input
+ * in turn. So a port that is flooded cannot hold up a message that
+ * came in before its flood on another port.
  */
-void check_midi_synth() {
-  uint16_t midi_in = read_midi();
-  midi_message mm;
-  char msg[91];
-  int msg_len;
-
-  if (midi_in <= 0xFF) {
-    /*
-    snprintf(msg, sizeof(msg), "_%02X_", midi_in);
-    serial_transmit((uint8_t *)msg, strlen(msg));
-    */
-    if (midi_stream_receive(&midi_stream_0, midi_in, &mm)) {
-      // Received a full MIDI message
-
-      synth_process_midi(&mm);
-
-      if (mm.type != 0xF8 && mm.type != 0xFE) {
-        // And show what we received if it's not a clock message or Active Sensing message
-        memset(msg, ' ', sizeof(msg));
-        msg_len = midi_snprintf(msg, sizeof(msg) - 1, &mm);
-        serial_transmit((uint8_t *)msg, strlen(msg));
-        serial_transmit((uint8_t *)"\r\n", 2);
-        // Extend message to full length
-        msg[msg_len] = ' ';
-        msg[sizeof(msg) - 1] = '\0';
-
-        // And display it on the screen
-        // Instead of filling a rectangle and then writing the string:
-        // Always expand the string to the necessary length (2 full rows?) so it draws it correctly.
-        // 320w x 240h
-        // 320 at 7 per character = 45 wide
-        // so we need 91 character long message including terminal NUL
-        // This looks much better as there is no "black fill flicker"
-        // spidma_ili9341_fill_rectangle(spip, 0, 0, ILI9341_WIDTH, Font_7x10.height * 2, ILI9341_BLACK);
-        spidma_ili9341_write_string(spip, 0, 0, msg, Font_7x10, ILI9341_CYAN, ILI9341_BLACK);
+void check_midi_input() {
+  midi_input_t *in, *first;
+  uint32_t inputs = 0, messages = 0, wait;
+  uint8_t last = MIDI_PORT_LOCAL;
+
+  for (int i = 0; i < MIDI_INPUTS; i++) {
+    in = &midi_inputs[i];
+    if (midi_input_begin(in) > 0) {
+      midi_input_next(in);
+      inputs++;
+    }
+  }
+  if (inputs == 0) {
+    return;
+  }
+
+  while (true) {
+    first = NULL;
+    for (int i = 0; i < MIDI_INPUTS; i++) {
+      in = &midi_inputs[(merge_first + i) % MIDI_INPUTS];
+      if (in->pending &&
+          (first == NULL || (int32_t)(in->next.timestamp - first->next.timestamp) < 0)) {
+        first = in;
       }
     }
+    if (first == NULL) {
+      break;
+    }
+
+    wait = cyclecount_now() - first->next.timestamp;
+    if (wait > first->wait_max) {
+      first->wait_max = wait;
+    }
+    first->messages++;
+    handle_midi_message(&first->next.msg, first->next.timestamp, first->next.port);
+    if (last != first->next.port && last != MIDI_PORT_LOCAL) {
+      midi_merge.switches++;
+    }
+    last = first->next.port;
+    messages++;
+    midi_input_next(first);
+  }
+  merge_first = (merge_first + 1) % MIDI_INPUTS;
+
+  for (int i = 0; i < MIDI_INPUTS; i++) {
+    in = &midi_inputs[i];
+    if (in->total > 0) {
+      udcr_consume(in->io, in->total);
+    }
+  }
+  if (serial_midi.escaped) {
+    serial_midi_end();
+  }
+
+  midi_merge.passes++;
+  if (inputs > 1) {
+    midi_merge.shared++;
+  }
+  if (messages > midi_merge.max_messages) {
+    midi_merge.max_messages = messages;
+  }
+
+  if (midi1_thru) {
+    // Don't wait for check_io() to start sending
+    midi_out_pump();
+    udcr_send_from_queue(&midi_io[MIDI1_PORT]);
   }
 }
 
@@ -576,6 +1677,7 @@ void display_init() {
   spi_config.use_reset = 1;
   spi_config.spi = &DISPLAY_SPI;
   spi_config.dma_tx = &DISPLAY_DMA;
+  spi_config.dma_tx_irqn = DISPLAY_DMA_IRQn;
 
   spip = &spi_config;
 
@@ -689,44 +1791,57 @@ void realmain() {
   uint32_t last_tick = HAL_GetTick();
   uint32_t tick_counter = 0;
 
+  memstats_paint_stack();
+  cyclecount_init();
+  trace_init();
+  dlog_init();
+  telem_init();
   init_usart_dma_io();
   init_midi_buffers();
-  synth_init(32000); // FIXME: Magic number
+  synth_init(AUDIO_SAMPLE_RATE);
 
-  // Start our USART receiving and error interrupts
-  LL_USART_EnableIT_RXNE(MIDI1_UART);
-  LL_USART_EnableIT_RXNE(CONSOLE_UART);
-  LL_USART_EnableIT_ERROR(MIDI1_UART);
-  LL_USART_EnableIT_ERROR(CONSOLE_UART);
-  // LL_USART_EnableIT_PE(MIDI1_UART);
-  // LL_USART_EnableIT_PE(CONSOLE_UART);
+  // The MIDI and console USARTs are all DMA driven, and
+  // init_usart_dma_io() turned on their IDLE interrupts: no RXNE or
+  // error interrupts, see usart_rx_idle()
 
   display_init();
   show_intro(spip);
 
+  // Nothing needs the main loop yet, so see all of this sent
+  printWelcomeMessage();
+  serial_flush_blocking(CONSOLE_BOOT_FLUSH_MS);
+
   // Start the DMA streams for I²S
   HAL_I2S_Transmit_DMA(&SOUND1, (uint16_t *)i2s_buff, I2S_BUFFER_SIZE);
 
-  printMessage:
-  printWelcomeMessage();
-
   while (1) {
+    uint32_t loop_start = telem_zone_begin();
+    uint32_t zone_start;
+
     // Always check for I/O available for read/write
     check_io();
 
     // Handle our MIDI state machine
-    check_midi_synth();
+    zone_start = telem_zone_begin();
+    check_midi_input();
+    telem_zone_end(TELEM_ZONE_MIDI_IN, zone_start);
 
     if (i2s_write_available) {
+      zone_start = telem_zone_begin();
       fill_i2s_data();
+      telem_zone_end(TELEM_ZONE_AUDIO, zone_start);
     }
 
     // Now do everything in an entirely non-blocking way
     opt = read_user_input();
     processed_input = process_user_input(opt);
 
-    // Handle our display
+    // Show received MIDI, then handle our display
+    check_midi_monitor();
+    zone_start = telem_zone_begin();
     spidma_check_activity(spip);
+    telem_zone_end(TELEM_ZONE_DISPLAY, zone_start);
+    check_telemetry();
 
     // Update our mute display and gain status
     draw_mute();
@@ -737,7 +1852,7 @@ void realmain() {
     counter++;
     if (counter >= end_counter) {
       counter = 0;
-      serial_transmit((uint8_t *)".", 1);
+      serial_transmit(CON_CHATTER, (uint8_t *)".", 1);
     }
 
     // count how many times through the loop we get per tick
@@ -755,17 +1870,18 @@ void realmain() {
     if (overrun_errors != last_overrun_errors) {
       snprintf(msg, sizeof(msg) - 1, "\r\nORE: %lu\r\n", overrun_errors);
       last_overrun_errors = overrun_errors;
-      serial_transmit((uint8_t *)msg, strlen(msg));
+      serial_transmit(CON_ERROR, (uint8_t *)msg, strlen(msg));
     }
     if (usart3_interrupts != last_usart3_interrupts) {
       snprintf(msg, sizeof(msg) - 1, "\r\nUA3I: %lu\r\n", usart3_interrupts);
       last_usart3_interrupts = usart3_interrupts;
-      serial_transmit((uint8_t *)msg, strlen(msg));
+      serial_transmit(CON_ERROR, (uint8_t *)msg, strlen(msg));
     }
 
     if (processed_input == 2) {
-      goto printMessage;
+      printWelcomeMessage();
     }
+    telem_zone_end(TELEM_ZONE_LOOP, loop_start);
   }
 } // realmain()
 
@@ -0,0 +1,333 @@
+/*
+ * smf.c
+ *
+ *  Created on: 2025-04-02
+ *  Updated on: 2025-04-02
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Standard MIDI File player.
+ *
+ * The file image is parsed where it is - normally a const array
+ * linked into flash - a track at a time, one event ahead, so nothing
+ * is copied to RAM. The tracks of a type 1 file are merged by keeping
+ * them in a small min-heap keyed on the absolute tick of each one's
+ * next event (ties go to the lower track number, so the tempo track
+ * comes first and playback is deterministic).
+ *
+ * Ticks are converted to samples through the tempo map: each Set
+ * Tempo meta event starts a new segment, and an event's sample is
+ * computed from the start of its segment, so rounding never adds up.
+ *
+ * smf_play_block() renders synth output, splitting the block at each
+ * event so every one takes effect on its exact sample.
+ *
+ * Only ticks-per-quarter-note timing is supported, not SMPTE. SysEx
+ * and meta events other than Set Tempo and End of Track are skipped.
+ * Nothing here depends on the hardware, so it builds on a host too.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include "midi.h"
+#include "synth.h"
+#include "smf.h"
+
+#define META_END_OF_TRACK 0x2F
+#define META_SET_TEMPO    0x51
+
+static inline uint32_t be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint16_t be16(const uint8_t *p) {
+  return (p[0] << 8) | p[1];
+}
+
+/** Reads a variable length quantity; returns false if it runs off the end */
+static bool read_vlq(smf_track_t *t, uint32_t *value) {
+  uint32_t v = 0;
+
+  for (int i = 0; i < 4; i++) {
+    if (t->pos >= t->end) {
+      return false;
+    }
+    v = (v << 7) | (*t->pos & 0x7F);
+    if ((*t->pos++ & 0x80) == 0) {
+      *value = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+/** Reads the delta time of the track's next event; false at the end */
+static bool read_delta(smf_player_t *p, smf_track_t *t) {
+  uint32_t delta;
+
+  if (t->pos >= t->end) {
+    return false;
+  }
+  if (!read_vlq(t, &delta)) {
+    p->errors++;
+    return false;
+  }
+  t->next_tick += delta;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Min-heap of track numbers
+
+static inline bool heap_before(const smf_player_t *p, uint8_t a, uint8_t b) {
+  uint32_t ta = p->tracks[a].next_tick;
+  uint32_t tb = p->tracks[b].next_tick;
+  return ta < tb || (ta == tb && a < b);
+}
+
+static void heap_down(smf_player_t *p, size_t i) {
+  size_t least, l, r;
+  uint8_t tmp;
+
+  while (1) {
+    least = i;
+    l = 2 * i + 1;
+    r = l + 1;
+    if (l < p->heap_size && heap_before(p, p->heap[l], p->heap[least])) {
+      least = l;
+    }
+    if (r < p->heap_size && heap_before(p, p->heap[r], p->heap[least])) {
+      least = r;
+    }
+    if (least == i) {
+      return;
+    }
+    tmp = p->heap[i];
+    p->heap[i] = p->heap[least];
+    p->heap[least] = tmp;
+    i = least;
+  }
+}
+
+static void heap_up(smf_player_t *p, size_t i) {
+  uint8_t tmp;
+
+  while (i > 0 && heap_before(p, p->heap[i], p->heap[(i - 1) / 2])) {
+    tmp = p->heap[i];
+    p->heap[i] = p->heap[(i - 1) / 2];
+    p->heap[(i - 1) / 2] = tmp;
+    i = (i - 1) / 2;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/** When a tick happens, in samples, under the current tempo segment */
+static uint64_t tick_to_sample(const smf_player_t *p, uint32_t tick) {
+  uint64_t us = (uint64_t)(tick - p->tempo_tick) * p->tempo / p->division;
+  return p->tempo_sample + us * p->sample_rate / 1000000;
+}
+
+/** Opens a file image, which has to stay where it is while playing.
+ * Returns 0, or -EINVAL if it is not a file we can play.
+ */
+int smf_open(smf_player_t *p, const uint8_t *image, size_t len, uint32_t sample_rate) {
+  const uint8_t *pos, *end = image + len;
+  uint32_t chunk_len;
+  uint16_t declared;
+
+  memset(p, 0, sizeof(*p));
+  p->sample_rate = sample_rate;
+  p->tempo = SMF_DEFAULT_TEMPO;
+
+  if (len < 14 || memcmp(image, "MThd", 4) != 0 || be32(image + 4) < 6) {
+    return -EINVAL;
+  }
+  p->format = be16(image + 8);
+  declared = be16(image + 10);
+  p->division = be16(image + 12);
+  if (p->format > 1 || p->division == 0 || (p->division & 0x8000)) {
+    return -EINVAL;
+  }
+
+  // Find the track chunks, skipping any others
+  pos = image + 8 + be32(image + 4);
+  while (pos + 8 <= end && p->num_tracks < declared && p->num_tracks < SMF_MAX_TRACKS) {
+    chunk_len = be32(pos + 4);
+    if (chunk_len > (size_t)(end - pos - 8)) {
+      // Cut off; play what there is
+      chunk_len = end - pos - 8;
+      p->errors++;
+    }
+    if (memcmp(pos, "MTrk", 4) == 0) {
+      smf_track_t *t = &p->tracks[p->num_tracks];
+      t->pos = pos + 8;
+      t->end = t->pos + chunk_len;
+      if (read_delta(p, t)) {
+        p->heap[p->heap_size++] = p->num_tracks;
+        heap_up(p, p->heap_size - 1);
+      }
+      p->num_tracks++;
+    }
+    pos += 8 + chunk_len;
+  }
+
+  return p->num_tracks > 0 ? 0 : -EINVAL;
+}
+
+/** Parses the event at the track's position. Returns true if it is a
+ * MIDI event (in mm); false for anything else, or if the track ends.
+ * done is set when the track has ended.
+ */
+static bool parse_event(smf_player_t *p, smf_track_t *t, midi_message *mm, bool *done) {
+  uint8_t status, info, len;
+  uint32_t meta_len;
+
+  *done = false;
+  if (t->pos >= t->end) {
+    p->errors++;
+    *done = true;
+    return false;
+  }
+
+  status = *t->pos;
+  if (status & 0x80) {
+    t->pos++;
+  } else {
+    status = t->running_status;
+  }
+
+  if (status == 0xFF) {
+    // Meta event
+    uint8_t type;
+    t->running_status = 0;
+    if (t->pos >= t->end) {
+      p->errors++;
+      *done = true;
+      return false;
+    }
+    type = *t->pos++;
+    if (!read_vlq(t, &meta_len) || meta_len > (size_t)(t->end - t->pos)) {
+      p->errors++;
+      *done = true;
+      return false;
+    }
+    if (type == META_SET_TEMPO && meta_len == 3) {
+      uint32_t tempo = ((uint32_t)t->pos[0] << 16) | (t->pos[1] << 8) | t->pos[2];
+      // New segment starting here
+      p->tempo_sample = tick_to_sample(p, t->next_tick);
+      p->tempo_tick = t->next_tick;
+      p->tempo = tempo > 0 ? tempo : 1;
+      p->tempo_changes++;
+    } else if (type == META_END_OF_TRACK) {
+      *done = true;
+    }
+    t->pos += meta_len;
+    return false;
+  }
+
+  if (status == 0xF0 || status == 0xF7) {
+    // SysEx (or escaped bytes): skip
+    t->running_status = 0;
+    if (!read_vlq(t, &meta_len) || meta_len > (size_t)(t->end - t->pos)) {
+      p->errors++;
+      *done = true;
+      return false;
+    }
+    t->pos += meta_len;
+    return false;
+  }
+
+  info = midi_status_info[status];
+  if (!(info & MIDI_SI_CHANNEL)) {
+    // No running status, or something that can't be in a file
+    p->errors++;
+    *done = true;
+    return false;
+  }
+  t->running_status = status;
+
+  len = info & MIDI_SI_LENGTH;
+  if ((size_t)(t->end - t->pos) < len) {
+    p->errors++;
+    *done = true;
+    return false;
+  }
+  mm->type = status;
+  mm->channel = status & 0x0F;
+  mm->data1 = t->pos[0] & 0x7F;
+  mm->data2 = len == 2 ? t->pos[1] & 0x7F : 0;
+  t->pos += len;
+
+  // Like the parser: a Note On with velocity 0 is a Note Off
+  if ((status & 0xF0) == MIDI_NOTE_ON && mm->velocity == 0) {
+    mm->type = MIDI_NOTE_OFF | mm->channel;
+  }
+  return true;
+}
+
+/** Gets the next MIDI event of the song, in time order, applying
+ * tempo changes along the way. Returns false at the end.
+ */
+bool smf_next_event(smf_player_t *p, smf_event_t *ev) {
+  smf_track_t *t;
+  uint8_t track;
+  bool is_midi, done;
+
+  while (p->heap_size > 0) {
+    track = p->heap[0];
+    t = &p->tracks[track];
+
+    ev->tick = t->next_tick;
+    is_midi = parse_event(p, t, &ev->msg, &done);
+    if (is_midi) {
+      ev->sample = tick_to_sample(p, ev->tick);
+    }
+
+    // Put the track back in order by its next event, or drop it
+    if (done || !read_delta(p, t)) {
+      p->heap[0] = p->heap[--p->heap_size];
+    }
+    heap_down(p, 0);
+
+    if (is_midi) {
+      p->events++;
+      return true;
+    }
+  }
+  return false;
+}
+
+/** Renders the next block of synth output, playing each event due
+ * in it at its sample. Returns false once the song has ended.
+ */
+bool smf_play_block(smf_player_t *p, int16_t *buf, size_t samples) {
+  uint64_t end = p->sample_now + samples;
+  size_t run;
+
+  while (1) {
+    if (!p->have_event) {
+      p->have_event = smf_next_event(p, &p->event);
+    }
+    if (!p->have_event || p->event.sample >= end) {
+      break;
+    }
+    // Render up to the event, then let it take effect
+    if (p->event.sample > p->sample_now) {
+      run = p->event.sample - p->sample_now;
+      synth_fill(buf, run);
+      buf += run;
+      p->sample_now += run;
+    }
+    synth_process_midi(&p->event.msg);
+    p->have_event = false;
+  }
+
+  synth_fill(buf, end - p->sample_now);
+  p->sample_now = end;
+  return !smf_done(p);
+}
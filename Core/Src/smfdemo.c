@@ -0,0 +1,103 @@
+/*
+ * Generated by Tools/mid2c.py from the built-in demo song - do not edit.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+const uint8_t smf_demo[] = {
+    0x4D, 0x54, 0x68, 0x64, 0x00, 0x00, 0x00, 0x06, 0x00, 0x01, 0x00, 0x04, 0x00, 0x60, 0x4D, 0x54,
+    0x72, 0x6B, 0x00, 0x00, 0x00, 0x23, 0x00, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20, 0x00, 0xFF, 0x58,
+    0x04, 0x04, 0x02, 0x18, 0x08, 0x98, 0x00, 0xFF, 0x51, 0x03, 0x06, 0x8A, 0x1B, 0x8C, 0x00, 0xFF,
+    0x51, 0x03, 0x09, 0x27, 0xC0, 0x00, 0xFF, 0x2F, 0x00, 0x4D, 0x54, 0x72, 0x6B, 0x00, 0x00, 0x03,
+    0x05, 0x00, 0x90, 0x3C, 0x5A, 0x28, 0x3C, 0x00, 0x08, 0x40, 0x56, 0x28, 0x40, 0x00, 0x08, 0x43,
+    0x52, 0x28, 0x43, 0x00, 0x08, 0x3C, 0x4E, 0x28, 0x3C, 0x00, 0x08, 0x4C, 0x4A, 0x28, 0x4C, 0x00,
+    0x08, 0x4F, 0x46, 0x28, 0x4F, 0x00, 0x08, 0x48, 0x42, 0x28, 0x48, 0x00, 0x08, 0x4C, 0x3E, 0x28,
+    0x4C, 0x00, 0x08, 0x39, 0x5A, 0x28, 0x39, 0x00, 0x08, 0x3C, 0x56, 0x28, 0x3C, 0x00, 0x08, 0x40,
+    0x52, 0x28, 0x40, 0x00, 0x08, 0x39, 0x4E, 0x28, 0x39, 0x00, 0x08, 0x48, 0x4A, 0x28, 0x48, 0x00,
+    0x08, 0x4C, 0x46, 0x28, 0x4C, 0x00, 0x08, 0x45, 0x42, 0x28, 0x45, 0x00, 0x08, 0x48, 0x3E, 0x28,
+    0x48, 0x00, 0x08, 0x35, 0x5A, 0x28, 0x35, 0x00, 0x08, 0x39, 0x56, 0x28, 0x39, 0x00, 0x08, 0x3C,
+    0x52, 0x28, 0x3C, 0x00, 0x08, 0x35, 0x4E, 0x28, 0x35, 0x00, 0x08, 0x45, 0x4A, 0x28, 0x45, 0x00,
+    0x08, 0x48, 0x46, 0x28, 0x48, 0x00, 0x08, 0x41, 0x42, 0x28, 0x41, 0x00, 0x08, 0x45, 0x3E, 0x28,
+    0x45, 0x00, 0x08, 0x37, 0x5A, 0x28, 0x37, 0x00, 0x08, 0x3B, 0x56, 0x28, 0x3B, 0x00, 0x08, 0x3E,
+    0x52, 0x28, 0x3E, 0x00, 0x08, 0x37, 0x4E, 0x28, 0x37, 0x00, 0x08, 0x47, 0x4A, 0x28, 0x47, 0x00,
+    0x08, 0x4A, 0x46, 0x28, 0x4A, 0x00, 0x08, 0x43, 0x42, 0x28, 0x43, 0x00, 0x08, 0x47, 0x3E, 0x28,
+    0x47, 0x00, 0x08, 0x3C, 0x5A, 0x28, 0x3C, 0x00, 0x08, 0x40, 0x56, 0x28, 0x40, 0x00, 0x08, 0x43,
+    0x52, 0x28, 0x43, 0x00, 0x08, 0x3C, 0x4E, 0x28, 0x3C, 0x00, 0x08, 0x4C, 0x4A, 0x28, 0x4C, 0x00,
+    0x08, 0x4F, 0x46, 0x28, 0x4F, 0x00, 0x08, 0x48, 0x42, 0x28, 0x48, 0x00, 0x08, 0x4C, 0x3E, 0x28,
+    0x4C, 0x00, 0x08, 0x39, 0x5A, 0x28, 0x39, 0x00, 0x08, 0x3C, 0x56, 0x28, 0x3C, 0x00, 0x08, 0x40,
+    0x52, 0x28, 0x40, 0x00, 0x08, 0x39, 0x4E, 0x28, 0x39, 0x00, 0x08, 0x48, 0x4A, 0x28, 0x48, 0x00,
+    0x08, 0x4C, 0x46, 0x28, 0x4C, 0x00, 0x08, 0x45, 0x42, 0x28, 0x45, 0x00, 0x08, 0x48, 0x3E, 0x28,
+    0x48, 0x00, 0x08, 0x35, 0x5A, 0x28, 0x35, 0x00, 0x08, 0x39, 0x56, 0x28, 0x39, 0x00, 0x08, 0x3C,
+    0x52, 0x28, 0x3C, 0x00, 0x08, 0x35, 0x4E, 0x28, 0x35, 0x00, 0x08, 0x45, 0x4A, 0x28, 0x45, 0x00,
+    0x08, 0x48, 0x46, 0x28, 0x48, 0x00, 0x08, 0x41, 0x42, 0x28, 0x41, 0x00, 0x08, 0x45, 0x3E, 0x28,
+    0x45, 0x00, 0x08, 0x37, 0x5A, 0x28, 0x37, 0x00, 0x08, 0x3B, 0x56, 0x28, 0x3B, 0x00, 0x08, 0x3E,
+    0x52, 0x28, 0x3E, 0x00, 0x08, 0x37, 0x4E, 0x28, 0x37, 0x00, 0x08, 0x47, 0x4A, 0x28, 0x47, 0x00,
+    0x08, 0x4A, 0x46, 0x28, 0x4A, 0x00, 0x08, 0x43, 0x42, 0x28, 0x43, 0x00, 0x08, 0x47, 0x3E, 0x28,
+    0x47, 0x00, 0x08, 0x3C, 0x5A, 0x28, 0x3C, 0x00, 0x08, 0x40, 0x56, 0x28, 0x40, 0x00, 0x08, 0x43,
+    0x52, 0x28, 0x43, 0x00, 0x08, 0x3C, 0x4E, 0x28, 0x3C, 0x00, 0x08, 0x4C, 0x4A, 0x28, 0x4C, 0x00,
+    0x08, 0x4F, 0x46, 0x28, 0x4F, 0x00, 0x08, 0x48, 0x42, 0x28, 0x48, 0x00, 0x08, 0x4C, 0x3E, 0x28,
+    0x4C, 0x00, 0x08, 0x39, 0x5A, 0x28, 0x39, 0x00, 0x08, 0x3C, 0x56, 0x28, 0x3C, 0x00, 0x08, 0x40,
+    0x52, 0x28, 0x40, 0x00, 0x08, 0x39, 0x4E, 0x28, 0x39, 0x00, 0x08, 0x48, 0x4A, 0x28, 0x48, 0x00,
+    0x08, 0x4C, 0x46, 0x28, 0x4C, 0x00, 0x08, 0x45, 0x42, 0x28, 0x45, 0x00, 0x08, 0x48, 0x3E, 0x28,
+    0x48, 0x00, 0x08, 0x35, 0x5A, 0x28, 0x35, 0x00, 0x08, 0x39, 0x56, 0x28, 0x39, 0x00, 0x08, 0x3C,
+    0x52, 0x28, 0x3C, 0x00, 0x08, 0x35, 0x4E, 0x28, 0x35, 0x00, 0x08, 0x45, 0x4A, 0x28, 0x45, 0x00,
+    0x08, 0x48, 0x46, 0x28, 0x48, 0x00, 0x08, 0x41, 0x42, 0x28, 0x41, 0x00, 0x08, 0x45, 0x3E, 0x28,
+    0x45, 0x00, 0x08, 0x37, 0x5A, 0x28, 0x37, 0x00, 0x08, 0x3B, 0x56, 0x28, 0x3B, 0x00, 0x08, 0x3E,
+    0x52, 0x28, 0x3E, 0x00, 0x08, 0x37, 0x4E, 0x28, 0x37, 0x00, 0x08, 0x47, 0x4A, 0x28, 0x47, 0x00,
+    0x08, 0x4A, 0x46, 0x28, 0x4A, 0x00, 0x08, 0x43, 0x42, 0x28, 0x43, 0x00, 0x08, 0x47, 0x3E, 0x28,
+    0x47, 0x00, 0x08, 0x3C, 0x5A, 0x28, 0x3C, 0x00, 0x08, 0x40, 0x56, 0x28, 0x40, 0x00, 0x08, 0x43,
+    0x52, 0x28, 0x43, 0x00, 0x08, 0x3C, 0x4E, 0x28, 0x3C, 0x00, 0x08, 0x4C, 0x4A, 0x28, 0x4C, 0x00,
+    0x08, 0x4F, 0x46, 0x28, 0x4F, 0x00, 0x08, 0x48, 0x42, 0x28, 0x48, 0x00, 0x08, 0x4C, 0x3E, 0x28,
+    0x4C, 0x00, 0x08, 0x39, 0x5A, 0x28, 0x39, 0x00, 0x08, 0x3C, 0x56, 0x28, 0x3C, 0x00, 0x08, 0x40,
+    0x52, 0x28, 0x40, 0x00, 0x08, 0x39, 0x4E, 0x28, 0x39, 0x00, 0x08, 0x48, 0x4A, 0x28, 0x48, 0x00,
+    0x08, 0x4C, 0x46, 0x28, 0x4C, 0x00, 0x08, 0x45, 0x42, 0x28, 0x45, 0x00, 0x08, 0x48, 0x3E, 0x28,
+    0x48, 0x00, 0x08, 0x35, 0x5A, 0x28, 0x35, 0x00, 0x08, 0x39, 0x56, 0x28, 0x39, 0x00, 0x08, 0x3C,
+    0x52, 0x28, 0x3C, 0x00, 0x08, 0x35, 0x4E, 0x28, 0x35, 0x00, 0x08, 0x45, 0x4A, 0x28, 0x45, 0x00,
+    0x08, 0x48, 0x46, 0x28, 0x48, 0x00, 0x08, 0x41, 0x42, 0x28, 0x41, 0x00, 0x08, 0x45, 0x3E, 0x28,
+    0x45, 0x00, 0x08, 0x37, 0x5A, 0x28, 0x37, 0x00, 0x08, 0x3B, 0x56, 0x28, 0x3B, 0x00, 0x08, 0x3E,
+    0x52, 0x28, 0x3E, 0x00, 0x08, 0x37, 0x4E, 0x28, 0x37, 0x00, 0x08, 0x47, 0x4A, 0x28, 0x47, 0x00,
+    0x08, 0x4A, 0x46, 0x28, 0x4A, 0x00, 0x08, 0x43, 0x42, 0x28, 0x43, 0x00, 0x08, 0x47, 0x3E, 0x28,
+    0x47, 0x00, 0x00, 0xFF, 0x2F, 0x00, 0x4D, 0x54, 0x72, 0x6B, 0x00, 0x00, 0x00, 0xE5, 0x00, 0x91,
+    0x30, 0x64, 0x81, 0x38, 0x30, 0x00, 0x08, 0x37, 0x5A, 0x81, 0x38, 0x37, 0x00, 0x08, 0x2D, 0x64,
+    0x81, 0x38, 0x2D, 0x00, 0x08, 0x34, 0x5A, 0x81, 0x38, 0x34, 0x00, 0x08, 0x29, 0x64, 0x81, 0x38,
+    0x29, 0x00, 0x08, 0x30, 0x5A, 0x81, 0x38, 0x30, 0x00, 0x08, 0x2B, 0x64, 0x81, 0x38, 0x2B, 0x00,
+    0x08, 0x32, 0x5A, 0x81, 0x38, 0x32, 0x00, 0x08, 0x30, 0x64, 0x81, 0x38, 0x30, 0x00, 0x08, 0x37,
+    0x5A, 0x81, 0x38, 0x37, 0x00, 0x08, 0x2D, 0x64, 0x81, 0x38, 0x2D, 0x00, 0x08, 0x34, 0x5A, 0x81,
+    0x38, 0x34, 0x00, 0x08, 0x29, 0x64, 0x81, 0x38, 0x29, 0x00, 0x08, 0x30, 0x5A, 0x81, 0x38, 0x30,
+    0x00, 0x08, 0x2B, 0x64, 0x81, 0x38, 0x2B, 0x00, 0x08, 0x32, 0x5A, 0x81, 0x38, 0x32, 0x00, 0x08,
+    0x30, 0x64, 0x81, 0x38, 0x30, 0x00, 0x08, 0x37, 0x5A, 0x81, 0x38, 0x37, 0x00, 0x08, 0x2D, 0x64,
+    0x81, 0x38, 0x2D, 0x00, 0x08, 0x34, 0x5A, 0x81, 0x38, 0x34, 0x00, 0x08, 0x29, 0x64, 0x81, 0x38,
+    0x29, 0x00, 0x08, 0x30, 0x5A, 0x81, 0x38, 0x30, 0x00, 0x08, 0x2B, 0x64, 0x81, 0x38, 0x2B, 0x00,
+    0x08, 0x32, 0x5A, 0x81, 0x38, 0x32, 0x00, 0x08, 0x30, 0x64, 0x81, 0x38, 0x30, 0x00, 0x08, 0x37,
+    0x5A, 0x81, 0x38, 0x37, 0x00, 0x08, 0x2D, 0x64, 0x81, 0x38, 0x2D, 0x00, 0x08, 0x34, 0x5A, 0x81,
+    0x38, 0x34, 0x00, 0x08, 0x29, 0x64, 0x81, 0x38, 0x29, 0x00, 0x08, 0x30, 0x5A, 0x81, 0x38, 0x30,
+    0x00, 0x08, 0x2B, 0x64, 0x81, 0x38, 0x2B, 0x00, 0x08, 0x32, 0x5A, 0x81, 0x38, 0x32, 0x00, 0x00,
+    0xFF, 0x2F, 0x00, 0x4D, 0x54, 0x72, 0x6B, 0x00, 0x00, 0x01, 0x85, 0x00, 0x92, 0x30, 0x32, 0x00,
+    0x34, 0x32, 0x00, 0x37, 0x32, 0x60, 0xB2, 0x01, 0x00, 0x82, 0x10, 0x92, 0x30, 0x00, 0x00, 0x34,
+    0x00, 0x00, 0x37, 0x00, 0x10, 0x2D, 0x32, 0x00, 0x30, 0x32, 0x00, 0x34, 0x32, 0x60, 0xB2, 0x01,
+    0x08, 0x82, 0x10, 0x92, 0x2D, 0x00, 0x00, 0x30, 0x00, 0x00, 0x34, 0x00, 0x10, 0x29, 0x32, 0x00,
+    0x2D, 0x32, 0x00, 0x30, 0x32, 0x60, 0xB2, 0x01, 0x10, 0x82, 0x10, 0x92, 0x29, 0x00, 0x00, 0x2D,
+    0x00, 0x00, 0x30, 0x00, 0x10, 0x2B, 0x32, 0x00, 0x2F, 0x32, 0x00, 0x32, 0x32, 0x60, 0xB2, 0x01,
+    0x18, 0x82, 0x10, 0x92, 0x2B, 0x00, 0x00, 0x2F, 0x00, 0x00, 0x32, 0x00, 0x10, 0x30, 0x32, 0x00,
+    0x34, 0x32, 0x00, 0x37, 0x32, 0x60, 0xB2, 0x01, 0x20, 0x82, 0x10, 0x92, 0x30, 0x00, 0x00, 0x34,
+    0x00, 0x00, 0x37, 0x00, 0x10, 0x2D, 0x32, 0x00, 0x30, 0x32, 0x00, 0x34, 0x32, 0x60, 0xB2, 0x01,
+    0x28, 0x82, 0x10, 0x92, 0x2D, 0x00, 0x00, 0x30, 0x00, 0x00, 0x34, 0x00, 0x10, 0x29, 0x32, 0x00,
+    0x2D, 0x32, 0x00, 0x30, 0x32, 0x60, 0xB2, 0x01, 0x30, 0x82, 0x10, 0x92, 0x29, 0x00, 0x00, 0x2D,
+    0x00, 0x00, 0x30, 0x00, 0x10, 0x2B, 0x32, 0x00, 0x2F, 0x32, 0x00, 0x32, 0x32, 0x60, 0xB2, 0x01,
+    0x38, 0x82, 0x10, 0x92, 0x2B, 0x00, 0x00, 0x2F, 0x00, 0x00, 0x32, 0x00, 0x10, 0x30, 0x32, 0x00,
+    0x34, 0x32, 0x00, 0x37, 0x32, 0x60, 0xB2, 0x01, 0x40, 0x82, 0x10, 0x92, 0x30, 0x00, 0x00, 0x34,
+    0x00, 0x00, 0x37, 0x00, 0x10, 0x2D, 0x32, 0x00, 0x30, 0x32, 0x00, 0x34, 0x32, 0x60, 0xB2, 0x01,
+    0x48, 0x82, 0x10, 0x92, 0x2D, 0x00, 0x00, 0x30, 0x00, 0x00, 0x34, 0x00, 0x10, 0x29, 0x32, 0x00,
+    0x2D, 0x32, 0x00, 0x30, 0x32, 0x60, 0xB2, 0x01, 0x50, 0x82, 0x10, 0x92, 0x29, 0x00, 0x00, 0x2D,
+    0x00, 0x00, 0x30, 0x00, 0x10, 0x2B, 0x32, 0x00, 0x2F, 0x32, 0x00, 0x32, 0x32, 0x60, 0xB2, 0x01,
+    0x58, 0x82, 0x10, 0x92, 0x2B, 0x00, 0x00, 0x2F, 0x00, 0x00, 0x32, 0x00, 0x10, 0x30, 0x32, 0x00,
+    0x34, 0x32, 0x00, 0x37, 0x32, 0x60, 0xB2, 0x01, 0x60, 0x82, 0x10, 0x92, 0x30, 0x00, 0x00, 0x34,
+    0x00, 0x00, 0x37, 0x00, 0x10, 0x2D, 0x32, 0x00, 0x30, 0x32, 0x00, 0x34, 0x32, 0x60, 0xB2, 0x01,
+    0x68, 0x82, 0x10, 0x92, 0x2D, 0x00, 0x00, 0x30, 0x00, 0x00, 0x34, 0x00, 0x10, 0x29, 0x32, 0x00,
+    0x2D, 0x32, 0x00, 0x30, 0x32, 0x60, 0xB2, 0x01, 0x70, 0x82, 0x10, 0x92, 0x29, 0x00, 0x00, 0x2D,
+    0x00, 0x00, 0x30, 0x00, 0x10, 0x2B, 0x32, 0x00, 0x2F, 0x32, 0x00, 0x32, 0x32, 0x60, 0xB2, 0x01,
+    0x78, 0x82, 0x10, 0x92, 0x2B, 0x00, 0x00, 0x2F, 0x00, 0x00, 0x32, 0x00, 0x00, 0xFF, 0x2F, 0x00,
+};
+
+const size_t smf_demo_len = sizeof(smf_demo);
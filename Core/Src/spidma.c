@@ -2,7 +2,7 @@
  * spidma.c
  *
  *  Created on: 2024-11-11
- *  Updated on: 2024-11-16
+ *  Updated on: 2025-04-12
  *      Author: Douglas P. Fields, Jr. - symbolics@lisp.engineer
  *   Copyright: 2024, Douglas P. Fields, Jr.
  *     License: Apache 2.0
@@ -31,6 +31,13 @@
  * Non-features:
  * * Thread safety
  *
+ * Bus timing statistics (SPIDMA_STATISTICS):
+ * * Bytes sent, DMA busy time, and effective bandwidth
+ * * HAL setup time per transfer
+ * * Bus idle time between transfers, split by whether the
+ *   queue had work waiting (per-entry overhead) or not
+ * * Queue depth at each transfer start (maximum and histogram)
+ *
  * Any request for an SPI event with auto-freeing that could not be queued is
  * instead now queued
  * into a backup freeing queue, and whenever the SPI queue is empty we free
@@ -42,32 +49,32 @@
  * 1. This currently is not remotely thread safe, but that's
  *    okay for now because the current target is non-threaded
  *    and single-core
- * 2. This currently will NOT work with multiple instances
- *    due to having a single interrupt handler with no way to
- *    determine which spidma_config_t's interrupt is being handled.
- *    (Not having closures in plain C is a bit annoying.)
+ * 2. The HAL completion callback only gets the SPI_HandleTypeDef,
+ *    and plain C has no closures, so each instance is given one of
+ *    NUM_SPI_CHANNELS slots with its own little callback function
+ *    that passes that slot's spidma_config_t on. So up to that many
+ *    instances (on different SPIs) work at once, with no searching
+ *    in the interrupt handler.
  *
  */
 
 #include <stdlib.h> // free()
+#include <string.h> // memset()
 #include <stdbool.h>
 #include "stm32f7xx_hal.h"
 #include "spidma.h"
+#include "cyclecount.h"
+#include "trace.h"
 
 // Our console U(S)ART
 // extern UART_HandleTypeDef huart2;
 
-typedef struct spidma_callback_map_entry {
-  SPI_HandleTypeDef *spi_handle;
-  spidma_config_t *spidma_handle;
-} spidma_callback_map_entry_t;
-
 #define NUM_SPI_CHANNELS 4
 /* Our callbacks only have n SPI_HandleTypeDef in the HAL implementation,
- * so we have to map that to our spidma_config_t somehow.
+ * so each spidma_config_t gets a slot, whose callback passes it on.
  */
 // TODO: Make this live in fast data RAM
-static spidma_callback_map_entry_t callback_map[NUM_SPI_CHANNELS] = { 0 };
+static spidma_config_t *callback_slots[NUM_SPI_CHANNELS] = { 0 };
 
 /*
  * Callback function when an SPI DMA transfer has completed,
@@ -80,18 +87,7 @@ static spidma_callback_map_entry_t callback_map[NUM_SPI_CHANNELS] = { 0 };
  * FIXME: Remove LED blinking.
  */
 // TODO: Make this live in fast code RAM
-static void spi_transfer_complete(SPI_HandleTypeDef *hspi) {
-  spidma_config_t *spi = NULL;
-
-  // Find our spidma_config_t from hspi
-  // (hopefully the optimizer will unroll this loop)
-  for (int i = 0; i < NUM_SPI_CHANNELS; i++) {
-    if (callback_map[i].spi_handle == hspi) {
-      spi = callback_map[i].spidma_handle;
-      break;
-    }
-  }
-
+static void spi_transfer_complete(spidma_config_t *spi) {
   // If we're not the sending SPI interrupt, do nothing
   if (spi == NULL) {
     return;
@@ -103,15 +99,44 @@ static void spi_transfer_complete(SPI_HandleTypeDef *hspi) {
     spidma_free_queue(spi, spi->current_entry.buff);
   }
 
+#ifdef SPIDMA_STATISTICS
+  // Record how long the bus was busy, and whether anything is
+  // waiting behind us so the next gap counts as overhead
+  uint32_t now = cyclecount_now();
+  spi->stats.busy_cycles += now - spi->stats.last_start;
+  spi->stats.last_complete = now;
+  spi->stats.last_backlogged = spi->head_entry != spi->tail_entry;
+  spi->stats.seen_complete = 1;
+#endif
+
   // Flash or transmit stuff for gratuitous purposes
 #ifdef TOGGLE_LEDS
   HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_14); // Green LED
   // HAL_UART_Transmit(&huart2, (uint8_t *)"+", 1, HAL_MAX_DELAY);
 #endif
 
+  TRACE(TRACE_DMA_COMPLETE, trace_hal_dma_id(spi->dma_tx->Instance), 0);
   spi->is_sending = 0;
 }
 
+// The HAL callback for each slot
+static void spi_transfer_complete_0(SPI_HandleTypeDef *hspi) {
+  spi_transfer_complete(callback_slots[0]);
+}
+static void spi_transfer_complete_1(SPI_HandleTypeDef *hspi) {
+  spi_transfer_complete(callback_slots[1]);
+}
+static void spi_transfer_complete_2(SPI_HandleTypeDef *hspi) {
+  spi_transfer_complete(callback_slots[2]);
+}
+static void spi_transfer_complete_3(SPI_HandleTypeDef *hspi) {
+  spi_transfer_complete(callback_slots[3]);
+}
+static void (*const slot_callbacks[NUM_SPI_CHANNELS])(SPI_HandleTypeDef *hspi) = {
+    spi_transfer_complete_0, spi_transfer_complete_1,
+    spi_transfer_complete_2, spi_transfer_complete_3
+};
+
 /**
  * Initialize the DMA transfers and the
  * state of the SPI-supporting GPIO pins,
@@ -119,8 +144,8 @@ static void spi_transfer_complete(SPI_HandleTypeDef *hspi) {
  * freeing queue, and in_delay flag.
  *
  * There can be only ONE spidma_config_t for each
- * (SPI_HandleTypeDef *) because we use that to look up the
- * spidma_config_t later in an interrupt function.
+ * (SPI_HandleTypeDef *) because the HAL has one callback per
+ * handle, and at most NUM_SPI_CHANNELS altogether.
  *
  * If the return value is not SDRV_OK, then you can't use
  * these routines!
@@ -136,27 +161,24 @@ static void spi_transfer_complete(SPI_HandleTypeDef *hspi) {
   DISPLAY_SPI.use_reset = 1;
   DISPLAY_SPI.spi = &ILI9341_SPI_PORT;
   DISPLAY_SPI.dma_tx = &DISPLAY_DMA;
+  DISPLAY_SPI.dma_tx_irqn = DMA1_Stream4_IRQn;
  */
 spidma_return_value_t spidma_init(spidma_config_t *spi) {
-  // TODO: Make this a closure that knows which spidma_config_t was in use
-  // (or at the least, a lookup table from the hspi to the spidma_config_t)
-
   if (NULL == spi) {
     return SDRV_IGNORED;
   }
 
-  // Update our callback map so we can handle this new spidma_config_t
+  // Take a callback slot for this new spidma_config_t
   int i;
   for (i = 0; i < NUM_SPI_CHANNELS; i++) {
-    if (callback_map[i].spi_handle == spi->spi) {
+    if (callback_slots[i] != NULL && callback_slots[i]->spi == spi->spi) {
       return SDRV_IN_USE;
     }
   }
   for (i = 0; i < NUM_SPI_CHANNELS; i++) {
-    if (callback_map[i].spi_handle == NULL) {
+    if (callback_slots[i] == NULL) {
       // Allocate this one
-      callback_map[i].spi_handle = spi->spi;
-      callback_map[i].spidma_handle = spi;
+      callback_slots[i] = spi;
       break;
     }
   }
@@ -165,8 +187,8 @@ spidma_return_value_t spidma_init(spidma_config_t *spi) {
     return SDRV_FULL;
   }
 
-  // And register the callback
-  HAL_SPI_RegisterCallback(spi->spi, HAL_SPI_TX_COMPLETE_CB_ID, spi_transfer_complete);
+  // And register its callback, which goes right to us
+  HAL_SPI_RegisterCallback(spi->spi, HAL_SPI_TX_COMPLETE_CB_ID, slot_callbacks[i]);
   // TODO: Check return value
   spi->is_sending = 0;
 
@@ -186,6 +208,8 @@ spidma_return_value_t spidma_init(spidma_config_t *spi) {
   // Set up the status flags
   spi->in_delay = 0;
 
+  spidma_stats_reset(spi);
+
   return SDRV_OK;
 }
 
@@ -233,6 +257,46 @@ bool spidma_is_dma_ready(spidma_config_t *spi) {
   // return HAL_DMA_GetState(spi->dma_tx) == HAL_DMA_STATE_READY;
 }
 
+#ifdef SPIDMA_STATISTICS
+/** Update the bus statistics for a DMA which is about to be started
+ * at time "start". This has to be done before the DMA is started,
+ * because short transfers (e.g., 1 byte commands) complete and run
+ * the completion interrupt before HAL_SPI_Transmit_DMA() even returns.
+ */
+static void spidma_stats_record_start(spidma_config_t *spi, uint32_t start, size_t buff_size) {
+  spidma_stats_t *st = &spi->stats;
+  uint32_t gap;
+  spiq_size_t depth = (spi->tail_entry - spi->head_entry) & SPI_ENTRY_MASK;
+  int bucket = 0;
+
+  st->last_start = start;
+  st->dma_starts++;
+  st->bytes_sent += buff_size;
+
+  if (st->seen_complete) {
+    gap = start - st->last_complete;
+    if (st->last_backlogged) {
+      st->backlogged_gap_cycles += gap;
+      if (gap > st->max_backlogged_gap) {
+        st->max_backlogged_gap = gap;
+      }
+    } else {
+      st->starved_gap_cycles += gap;
+    }
+  }
+
+  // The queue entry being sent is still on the queue here
+  if (depth > st->max_depth) {
+    st->max_depth = depth;
+  }
+  while (depth > 0 && bucket < SPIDMA_DEPTH_BUCKETS - 1) {
+    depth >>= 1;
+    bucket++;
+  }
+  st->depth_histogram[bucket]++;
+}
+#endif // SPIDMA_STATISTICS
+
 /** Send a buffer of data over the SPI connection via DMA.
  *
  * This is a low-level routine and just starts the DMA transfer.
@@ -259,11 +323,20 @@ spidma_return_value_t spidma_write(spidma_config_t *spi, uint8_t *buff, size_t b
     return SDRV_DMA_BUSY;
   }
 
+#ifdef SPIDMA_STATISTICS
+  uint32_t start = cyclecount_now();
+  spidma_stats_record_start(spi, start, buff_size);
+#endif
+
   // Start a DMA transfer; set our status for the send complete callback
+  TRACE(TRACE_DMA_START, trace_hal_dma_id(spi->dma_tx->Instance), buff_size);
   spi->is_sending = 1;
   HAL_StatusTypeDef retval = HAL_SPI_Transmit_DMA(spi->spi, buff, buff_size);
 
   if (retval == HAL_OK) {
+#ifdef SPIDMA_STATISTICS
+    spi->stats.setup_cycles += cyclecount_now() - start;
+#endif
     return SDRV_OK;
   }
 
@@ -553,6 +626,7 @@ spidma_activity_status_t spidma_check_activity(spidma_config_t *spi) {
   // Take an entry off the queue and start doing it
   spidma_entry_t *e = &(spi->entries[spi->head_entry]);
   spi->current_entry = *e;
+  TRACE(TRACE_SPI_ENTRY, e->type, e->buff_size);
 
   // Do our action
   switch (e->type) {
@@ -573,6 +647,10 @@ spidma_activity_status_t spidma_check_activity(spidma_config_t *spi) {
   case SPIDMA_DELAY:
     spi->in_delay = 1;
     spi->delay_until = HAL_GetTick() + e->buff_size;
+#ifdef SPIDMA_STATISTICS
+    // A requested delay is not bus overhead
+    spi->stats.last_backlogged = 0;
+#endif
     retval = SDAS_DELAY_STARTED;
     break;
   case SPIDMA_RESET:
@@ -624,6 +702,41 @@ uint32_t spidma_empty_queue(spidma_config_t *spi) {
   return retval;
 }
 
+/** Clears the bus statistics and starts a new measurement window.
+ * The transfer complete interrupt updates them too, so it is masked
+ * meanwhile; one that comes then is taken right after.
+ */
+void spidma_stats_reset(spidma_config_t *spi) {
+#ifdef SPIDMA_STATISTICS
+  uint32_t irq_enabled = NVIC_GetEnableIRQ(spi->dma_tx_irqn);
+
+  NVIC_DisableIRQ(spi->dma_tx_irqn);
+  memset(&spi->stats, 0, sizeof(spi->stats));
+  spi->stats.window_start = cyclecount_now();
+  spi->stats.window_start_tick = HAL_GetTick();
+  if (irq_enabled) {
+    NVIC_EnableIRQ(spi->dma_tx_irqn);
+  }
+#endif
+}
+
+/** Cycles since the statistics were reset. The cycle counter wraps
+ * every ~20 seconds, so the HAL tick tells how many times it has:
+ * the tick's estimate only has to be within half a wrap.
+ */
+uint64_t spidma_stats_elapsed(spidma_config_t *spi) {
+#ifdef SPIDMA_STATISTICS
+  uint32_t cycles = cyclecount_now() - spi->stats.window_start;
+  uint64_t estimate = (uint64_t)(HAL_GetTick() - spi->stats.window_start_tick)
+                      * (SystemCoreClock / 1000);
+  uint64_t wraps = estimate > cycles ? (estimate - cycles + (1ULL << 31)) >> 32 : 0;
+
+  return (wraps << 32) + cycles;
+#else
+  return 0;
+#endif
+}
+
 spiq_size_t spidma_queue_length(spidma_config_t *spi) {
   return (spi->tail_entry - spi->head_entry) & SPI_ENTRY_MASK;
 }
@@ -1,6 +1,6 @@
 /*
  *  Created on: 2024-11-14
- *  Updated on: 2024-11-16
+ *  Updated on: 2025-04-12
  *      Author: Douglas P. Fields, Jr.
  *   Copyright: 2024, Douglas P. Fields, Jr.
  *     License: Apache 2.0
@@ -230,6 +230,7 @@ void spimain(void) {
   DISPLAY_SPI.use_reset = 1;
   DISPLAY_SPI.spi = &ILI9341_SPI_PORT;
   DISPLAY_SPI.dma_tx = &DISPLAY_DMA;
+  DISPLAY_SPI.dma_tx_irqn = DMA1_Stream4_IRQn;
 
   if (spidma_init(DISPLAY_SPIP) != SDRV_OK) {
     console_printf("spidma_init failed\r\n");
@@ -22,6 +22,8 @@
 #include "stm32f7xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "trace.h"
+#include "usartdma.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -206,9 +208,16 @@ void SysTick_Handler(void)
 void DMA1_Stream1_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Stream1_IRQn 0 */
-  // USART3 RX
+  TRACE(TRACE_ISR_ENTER, DMA1_Stream1_IRQn, 0);
+  // USART3 RX, with its receive events on
+  if (LL_DMA_IsActiveFlag_HT1(DMA1) || LL_DMA_IsActiveFlag_TC1(DMA1)) {
+    LL_DMA_ClearFlag_HT1(DMA1);
+    LL_DMA_ClearFlag_TC1(DMA1);
+    usart_dma_rx_event(udcr_slots[UDCR_SLOT(DMA1, 1)]);
+  }
   /* USER CODE END DMA1_Stream1_IRQn 0 */
   /* USER CODE BEGIN DMA1_Stream1_IRQn 1 */
+  TRACE(TRACE_ISR_EXIT, DMA1_Stream1_IRQn, 0);
 
   /* USER CODE END DMA1_Stream1_IRQn 1 */
 }
@@ -219,11 +228,18 @@ void DMA1_Stream1_IRQHandler(void)
 void DMA1_Stream3_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Stream3_IRQn 0 */
-  // Per configuration (.ioc file), this is USART 3 RX
-  usart_dma_transfer_complete(USART3);
+  TRACE(TRACE_ISR_ENTER, DMA1_Stream3_IRQn, 0);
+  // Per configuration (.ioc file), this is USART 3 TX
+  if (LL_DMA_IsActiveFlag_TC3(DMA1)) {
+    LL_DMA_ClearFlag_TC3(DMA1);
+    usart_dma_transfer_complete(udcr_slots[UDCR_SLOT(DMA1, 3)]);
+  }
+  if (LL_DMA_IsActiveFlag_TE3(DMA1)) {
+    LL_DMA_ClearFlag_TE3(DMA1);
+  }
   /* USER CODE END DMA1_Stream3_IRQn 0 */
   /* USER CODE BEGIN DMA1_Stream3_IRQn 1 */
-
+  TRACE(TRACE_ISR_EXIT, DMA1_Stream3_IRQn, 0);
   /* USER CODE END DMA1_Stream3_IRQn 1 */
 }
 
@@ -233,11 +249,12 @@ void DMA1_Stream3_IRQHandler(void)
 void DMA1_Stream4_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Stream4_IRQn 0 */
+  TRACE(TRACE_ISR_ENTER, DMA1_Stream4_IRQn, 0);
   // This is for SPI2
   /* USER CODE END DMA1_Stream4_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_spi2_tx);
   /* USER CODE BEGIN DMA1_Stream4_IRQn 1 */
-
+  TRACE(TRACE_ISR_EXIT, DMA1_Stream4_IRQn, 0);
   /* USER CODE END DMA1_Stream4_IRQn 1 */
 }
 
@@ -247,17 +264,19 @@ void DMA1_Stream4_IRQHandler(void)
 void DMA1_Stream5_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Stream5_IRQn 0 */
-  // USART2_RX
+  TRACE(TRACE_ISR_ENTER, DMA1_Stream5_IRQn, 0);
+  // USART2_RX, with its receive events on
   // We seem to be unable to receive more than a full buffer worth,
   // even with circular buffers turned on,
   // if TC interrupts are enabled, unless we clear these interrupts.
-  /*
-  if (LL_DMA_IsActiveFlag_TC5(DMA1)) {
+  if (LL_DMA_IsActiveFlag_HT5(DMA1) || LL_DMA_IsActiveFlag_TC5(DMA1)) {
+    LL_DMA_ClearFlag_HT5(DMA1);
     LL_DMA_ClearFlag_TC5(DMA1);
+    usart_dma_rx_event(udcr_slots[UDCR_SLOT(DMA1, 5)]);
   }
-  */
   /* USER CODE END DMA1_Stream5_IRQn 0 */
   /* USER CODE BEGIN DMA1_Stream5_IRQn 1 */
+  TRACE(TRACE_ISR_EXIT, DMA1_Stream5_IRQn, 0);
 
   /* USER CODE END DMA1_Stream5_IRQn 1 */
 }
@@ -268,17 +287,18 @@ void DMA1_Stream5_IRQHandler(void)
 void DMA1_Stream6_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Stream6_IRQn 0 */
+  TRACE(TRACE_ISR_ENTER, DMA1_Stream6_IRQn, 0);
   // Per configuration (.ioc file), this is USART 2 TX, our serial console.
   if (LL_DMA_IsActiveFlag_TC6(DMA1)) {
     LL_DMA_ClearFlag_TC6(DMA1);
-    usart_dma_transfer_complete(USART2);
+    usart_dma_transfer_complete(udcr_slots[UDCR_SLOT(DMA1, 6)]);
   }
   if (LL_DMA_IsActiveFlag_TE6(DMA1)) {
     LL_DMA_ClearFlag_TE6(DMA1);
   }
   /* USER CODE END DMA1_Stream6_IRQn 0 */
   /* USER CODE BEGIN DMA1_Stream6_IRQn 1 */
-
+  TRACE(TRACE_ISR_EXIT, DMA1_Stream6_IRQn, 0);
   /* USER CODE END DMA1_Stream6_IRQn 1 */
 }
 
@@ -328,9 +348,16 @@ void UART5_IRQHandler(void)
 void DMA2_Stream1_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA2_Stream1_IRQn 0 */
-  // USART6 RX
+  TRACE(TRACE_ISR_ENTER, DMA2_Stream1_IRQn, 0);
+  // USART6 RX, with its receive events on
+  if (LL_DMA_IsActiveFlag_HT1(DMA2) || LL_DMA_IsActiveFlag_TC1(DMA2)) {
+    LL_DMA_ClearFlag_HT1(DMA2);
+    LL_DMA_ClearFlag_TC1(DMA2);
+    usart_dma_rx_event(udcr_slots[UDCR_SLOT(DMA2, 1)]);
+  }
   /* USER CODE END DMA2_Stream1_IRQn 0 */
   /* USER CODE BEGIN DMA2_Stream1_IRQn 1 */
+  TRACE(TRACE_ISR_EXIT, DMA2_Stream1_IRQn, 0);
 
   /* USER CODE END DMA2_Stream1_IRQn 1 */
 }
@@ -341,9 +368,16 @@ void DMA2_Stream1_IRQHandler(void)
 void DMA2_Stream2_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA2_Stream2_IRQn 0 */
-  // USART1 RX
+  TRACE(TRACE_ISR_ENTER, DMA2_Stream2_IRQn, 0);
+  // USART1 RX, with its receive events on
+  if (LL_DMA_IsActiveFlag_HT2(DMA2) || LL_DMA_IsActiveFlag_TC2(DMA2)) {
+    LL_DMA_ClearFlag_HT2(DMA2);
+    LL_DMA_ClearFlag_TC2(DMA2);
+    usart_dma_rx_event(udcr_slots[UDCR_SLOT(DMA2, 2)]);
+  }
   /* USER CODE END DMA2_Stream2_IRQn 0 */
   /* USER CODE BEGIN DMA2_Stream2_IRQn 1 */
+  TRACE(TRACE_ISR_EXIT, DMA2_Stream2_IRQn, 0);
 
   /* USER CODE END DMA2_Stream2_IRQn 1 */
 }
@@ -354,11 +388,12 @@ void DMA2_Stream2_IRQHandler(void)
 void DMA2_Stream3_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA2_Stream3_IRQn 0 */
+  TRACE(TRACE_ISR_ENTER, DMA2_Stream3_IRQn, 0);
   // SPI1 TX
   /* USER CODE END DMA2_Stream3_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_spi1_tx);
   /* USER CODE BEGIN DMA2_Stream3_IRQn 1 */
-
+  TRACE(TRACE_ISR_EXIT, DMA2_Stream3_IRQn, 0);
   /* USER CODE END DMA2_Stream3_IRQn 1 */
 }
 
@@ -368,17 +403,18 @@ void DMA2_Stream3_IRQHandler(void)
 void DMA2_Stream6_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA2_Stream6_IRQn 0 */
+  TRACE(TRACE_ISR_ENTER, DMA2_Stream6_IRQn, 0);
   // Per configuration (.ioc file), this is USART 6 TX
   if (LL_DMA_IsActiveFlag_TC6(DMA2)) {
     LL_DMA_ClearFlag_TC6(DMA2);
-    usart_dma_transfer_complete(USART6);
+    usart_dma_transfer_complete(udcr_slots[UDCR_SLOT(DMA2, 6)]);
   }
   if (LL_DMA_IsActiveFlag_TE6(DMA2)) {
     LL_DMA_ClearFlag_TE6(DMA2);
   }
   /* USER CODE END DMA2_Stream6_IRQn 0 */
   /* USER CODE BEGIN DMA2_Stream6_IRQn 1 */
-
+  TRACE(TRACE_ISR_EXIT, DMA2_Stream6_IRQn, 0);
   /* USER CODE END DMA2_Stream6_IRQn 1 */
 }
 
@@ -388,20 +424,79 @@ void DMA2_Stream6_IRQHandler(void)
 void DMA2_Stream7_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA2_Stream7_IRQn 0 */
+  TRACE(TRACE_ISR_ENTER, DMA2_Stream7_IRQn, 0);
   // Per configuration (.ioc file), this is USART 1 TX
   if (LL_DMA_IsActiveFlag_TC7(DMA2)) {
     LL_DMA_ClearFlag_TC7(DMA2);
-    usart_dma_transfer_complete(USART1);
+    usart_dma_transfer_complete(udcr_slots[UDCR_SLOT(DMA2, 7)]);
   }
   if (LL_DMA_IsActiveFlag_TE7(DMA2)) {
     LL_DMA_ClearFlag_TE7(DMA2);
   }
   /* USER CODE END DMA2_Stream7_IRQn 0 */
   /* USER CODE BEGIN DMA2_Stream7_IRQn 1 */
-
+  TRACE(TRACE_ISR_EXIT, DMA2_Stream7_IRQn, 0);
   /* USER CODE END DMA2_Stream7_IRQn 1 */
 }
 
 /* USER CODE BEGIN 1 */
 
+/* The USART interrupts are only used for the IDLE (line went quiet)
+ * receive events of usartdma.c, so they are not set up in the .ioc;
+ * udcr_init() enables them in the NVIC. Each passes on the instance
+ * in the slot of its receive DMA stream.
+ *
+ * RXNE and error interrupts are off (the DMA reads RDR, so never read
+ * it here), but overrun, framing and noise errors still set their
+ * flags; they are counted and cleared whenever the line goes idle.
+ */
+static inline void usart_rx_idle(USART_TypeDef *usartx, usart_dma_config_t *udcr) {
+  uint32_t errors = 0;
+
+  if (LL_USART_IsActiveFlag_ORE(usartx)) {
+    LL_USART_ClearFlag_ORE(usartx);
+    errors++;
+  }
+  if (LL_USART_IsActiveFlag_FE(usartx)) {
+    LL_USART_ClearFlag_FE(usartx);
+    errors++;
+  }
+  if (LL_USART_IsActiveFlag_NE(usartx)) {
+    LL_USART_ClearFlag_NE(usartx);
+    errors++;
+  }
+  if (errors > 0 && udcr != NULL) {
+    udcr->rx_line_errors += errors;
+  }
+
+  if (LL_USART_IsEnabledIT_IDLE(usartx) && LL_USART_IsActiveFlag_IDLE(usartx)) {
+    LL_USART_ClearFlag_IDLE(usartx);
+    usart_dma_rx_event(udcr);
+  }
+}
+
+void USART1_IRQHandler(void) {
+  TRACE(TRACE_ISR_ENTER, USART1_IRQn, 0);
+  usart_rx_idle(USART1, udcr_slots[UDCR_SLOT(DMA2, 2)]);
+  TRACE(TRACE_ISR_EXIT, USART1_IRQn, 0);
+}
+
+void USART2_IRQHandler(void) {
+  TRACE(TRACE_ISR_ENTER, USART2_IRQn, 0);
+  usart_rx_idle(USART2, udcr_slots[UDCR_SLOT(DMA1, 5)]);
+  TRACE(TRACE_ISR_EXIT, USART2_IRQn, 0);
+}
+
+void USART3_IRQHandler(void) {
+  TRACE(TRACE_ISR_ENTER, USART3_IRQn, 0);
+  usart_rx_idle(USART3, udcr_slots[UDCR_SLOT(DMA1, 1)]);
+  TRACE(TRACE_ISR_EXIT, USART3_IRQn, 0);
+}
+
+void USART6_IRQHandler(void) {
+  TRACE(TRACE_ISR_ENTER, USART6_IRQn, 0);
+  usart_rx_idle(USART6, udcr_slots[UDCR_SLOT(DMA2, 1)]);
+  TRACE(TRACE_ISR_EXIT, USART6_IRQn, 0);
+}
+
 /* USER CODE END 1 */
@@ -4,7 +4,7 @@
  * Simple polyphonic synthesizer from scratch.
  *
  *  Created on: 2025-03-16
- *  Updated on: 2025-03-17
+ *  Updated on: 2025-04-09
  *      Author: Douglas P. Fields, Jr.
  *   Copyright: 2025, Douglas P. Fields, Jr.
  *     License: Apache 2.0
@@ -13,6 +13,12 @@
 #include "synth.h"
 
 FAST_BSS synth_voice_t voices[SYNTH_POLYPHONY];
+FAST_BSS synth_stats_t synth_stats;
+
+// Beat position, advanced every sample by beat_inc
+FAST_BSS uint64_t beat_pos;
+FAST_BSS uint64_t beat_inc;
+FAST_BSS uint32_t beat_epoch;
 
 /** Initialize our synthesizer engine
  * Does:
@@ -26,6 +32,28 @@ void synth_init(uint16_t sample_rate) {
     tonegen_init(&voices[v].tonegen, sample_rate);
     tonegen_set(&voices[v].tonegen, 1024, 0); // Frequency, Amplitude
   }
+  beat_pos = 0;
+  beat_inc = 0;
+  beat_epoch = 0;
+}
+
+/** Sets where the beat should be after the next samples, however
+ * many synth_fill() calls those take. The position moves evenly
+ * toward that (never backward), so it is continuous sample to
+ * sample; a new epoch means the transport moved it, and it jumps
+ * there instead.
+ */
+void synth_set_beat(uint64_t target, uint32_t epoch, size_t samples) {
+  if (epoch != beat_epoch) {
+    beat_epoch = epoch;
+    beat_pos = target;
+  }
+  beat_inc = target > beat_pos && samples > 0 ? (target - beat_pos) / samples : 0;
+}
+
+/** The beat position of the next sample, in Q32.32 beats */
+uint64_t synth_beat(void) {
+  return beat_pos;
 }
 
 /** Finds an unused voice number and returns its index, or negative if no
@@ -66,7 +94,13 @@ void synth_process_midi(midi_message *mm) {
   // Update our notes playing
   if (midi_type == MIDI_NOTE_ON) {
     v = find_voice(mm->note);
-    if (v >= 0) {
+    synth_stats.note_ons++;
+    if (v < 0) {
+      synth_stats.no_voice++;
+    } else {
+      if (voices[v].state == voice_on) {
+        synth_stats.retriggers++;
+      }
       // Start or restart a note playing
       // TODO: Get rid of the / 100 by pre-calculating the frequencies, or use that exact
       // x100 frequency since our sample rate could actually handle it
@@ -84,11 +118,14 @@ void synth_process_midi(midi_message *mm) {
   } else if (midi_type == MIDI_NOTE_OFF) { ////////////////////////////////////////////////
     // NOTE: We assume that there is only one note playing of each note.
     v = find_voice(mm->note);
+    synth_stats.note_offs++;
     // If it didn't find this note to turn off, then ignore it.
     if (v >= 0 && voices[v].state != voice_off) {
       voices[v].state = voice_off;
       // Is this actually necessary?
       tonegen_set(&voices[v].tonegen, voices[v].tonegen.desired_freq, 0);
+    } else {
+      synth_stats.stray_offs++;
     }
   }
 } // synth_process_midi()
@@ -111,7 +148,7 @@ void synth_check() {}
 void synth_fill(int16_t *buf, size_t samples) {
   int32_t acc; // accumulator
 
-  for (;;) {
+  while (samples > 0) {
     // The mixed value - sum of all samples for voices playing
     acc = 0;
     for (int v = 0; v < SYNTH_POLYPHONY; v++) {
@@ -129,8 +166,7 @@ void synth_fill(int16_t *buf, size_t samples) {
     // And output that value
     *buf = (int16_t)acc;
     buf++;
-    if (samples == 0)
-      return;
     samples--;
+    beat_pos += beat_inc;
   }
 } // synth_fill
@@ -0,0 +1,249 @@
+/*
+ * synthcheck.c
+ *
+ *  Created on: 2025-03-23
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Bit-exact golden audio regression check for the synth.
+ *
+ * Each scenario is a fixed list of MIDI messages, each applied at the
+ * start of a block, rendered through synth_init(), synth_process_midi()
+ * and synth_fill() exactly the way fill_i2s_data() does it. Each block
+ * of output is hashed (32-bit FNV-1a over the little endian samples)
+ * and compared against the golden hashes below, so a failure can
+ * be narrowed down to the first bad block of samples.
+ *
+ * The same code builds on a host, in Tools/synthcheck, which also
+ * keeps the golden samples themselves and so can find the first bad
+ * sample exactly. Run it there with make check.
+ *
+ * Any change to the synth which is meant to be bit-exact (e.g., an
+ * optimization) must keep this passing. Changes which are meant to
+ * change the sound need new golden hashes and samples: make golden
+ * in Tools/synthcheck writes the samples and prints the table to
+ * replace the one below.
+ *
+ * Running this resets the synth and takes a few milliseconds, so the
+ * audio output will glitch.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "synth.h"
+#include "midi.h"
+#include "synthcheck.h"
+
+#define FNV_OFFSET_BASIS 0x811C9DC5
+#define FNV_PRIME        0x01000193
+
+// End of an event list
+#define SC_END 0xFF
+
+typedef struct synthcheck_event {
+  uint8_t block;  // Which block to apply this before
+  uint8_t status; // MIDI status byte (with channel)
+  uint8_t data1;
+  uint8_t data2;
+} synthcheck_event_t;
+
+static const synthcheck_event_t single_note[] = {
+    { 0, 0x90, 60, 100 },
+    { 10, 0x80, 60, 64 },
+    { SC_END, 0, 0, 0 }
+};
+
+static const synthcheck_event_t chord[] = {
+    { 0, 0x90, 60, 90 },
+    { 0, 0x90, 64, 90 },
+    { 0, 0x90, 67, 90 },
+    { 12, 0x80, 64, 0 },
+    { 12, 0x80, 60, 0 },
+    { 13, 0x80, 67, 0 },
+    { SC_END, 0, 0, 0 }
+};
+
+static const synthcheck_event_t retrigger[] = {
+    { 0, 0x90, 64, 80 },
+    { 4, 0x90, 64, 120 },
+    { 8, 0x91, 64, 40 }, // Channels are ignored by the synth
+    { 12, 0x90, 64, 0 }, // Note off by velocity 0
+    { SC_END, 0, 0, 0 }
+};
+
+// Ten notes for eight voices; then a freed voice is reused
+static const synthcheck_event_t exhaustion[] = {
+    { 0, 0x90, 48, 30 },
+    { 0, 0x90, 50, 30 },
+    { 0, 0x90, 52, 30 },
+    { 0, 0x90, 53, 30 },
+    { 0, 0x90, 55, 30 },
+    { 0, 0x90, 57, 30 },
+    { 0, 0x90, 59, 30 },
+    { 0, 0x90, 60, 30 },
+    { 1, 0x90, 62, 127 }, // No voice available - not heard
+    { 1, 0x90, 64, 127 },
+    { 6, 0x80, 48, 0 },
+    { 7, 0x90, 72, 60 },
+    { 14, 0xB0, 123, 0 }, // All notes off is not handled by the synth
+    { SC_END, 0, 0, 0 }
+};
+
+static const synthcheck_event_t velocity_sweep[] = {
+    { 0, 0x90, 72, 1 },
+    { 2, 0x90, 72, 16 },
+    { 4, 0x90, 72, 32 },
+    { 6, 0x90, 72, 48 },
+    { 8, 0x90, 72, 64 },
+    { 10, 0x90, 72, 96 },
+    { 12, 0x90, 72, 127 },
+    { 14, 0x80, 72, 0 },
+    { SC_END, 0, 0, 0 }
+};
+
+// Lowest and highest notes, with loud enough chords to clip
+static const synthcheck_event_t extremes[] = {
+    { 0, 0x90, 0, 127 },
+    { 0, 0x90, 127, 127 },
+    { 4, 0x90, 36, 127 },
+    { 4, 0x90, 43, 127 },
+    { 4, 0x90, 48, 127 },
+    { 4, 0x90, 55, 127 },
+    { 11, 0x80, 0, 0 },
+    { 11, 0x80, 127, 0 },
+    { SC_END, 0, 0, 0 }
+};
+
+static const synthcheck_event_t *scenarios[] = {
+    single_note,
+    chord,
+    retrigger,
+    exhaustion,
+    velocity_sweep,
+    extremes
+};
+
+const char *synthcheck_scenario_names[] = {
+    "single note",
+    "chord",
+    "retrigger",
+    "voice exhaustion",
+    "velocity sweep",
+    "extremes & clipping"
+};
+
+const size_t synthcheck_num_scenarios = sizeof(scenarios) / sizeof(scenarios[0]);
+
+// Golden per-block hashes of each scenario, in the order above
+const uint32_t synthcheck_golden[][SYNTHCHECK_BLOCKS] = {
+    { // single note
+      0xA7AAA565, 0xC7C81D91, 0x5D4005ED, 0x75312069,
+      0x20B4D89A, 0x139F84EE, 0x6DA235DA, 0xD3811E21,
+      0xD538BC9D, 0x80B80E09, 0xE6A1D1C5, 0xE6A1D1C5,
+      0xE6A1D1C5, 0xE6A1D1C5, 0xE6A1D1C5, 0xE6A1D1C5
+    },
+    { // chord
+      0x5A4266EE, 0x81DF781A, 0x0787699E, 0xE37D828A,
+      0xC55E3370, 0x949D605B, 0x4363AAE9, 0x767AAD90,
+      0x327AB426, 0x0EB5F366, 0x5ED2DF75, 0x16EC945C,
+      0x3522B14D, 0xE6A1D1C5, 0xE6A1D1C5, 0xE6A1D1C5
+    },
+    { // retrigger
+      0x7935F631, 0xAAEDEB18, 0x180A4EDF, 0xD6AFE515,
+      0x89C6E521, 0xCBFBF680, 0xBE516CD7, 0x592F4FD4,
+      0x6E5EEEA0, 0x74B0A43A, 0xE2CFE780, 0x95BFEE4E,
+      0xE6A1D1C5, 0xE6A1D1C5, 0xE6A1D1C5, 0xE6A1D1C5
+    },
+    { // voice exhaustion
+      0x81EC0A8A, 0xCC82DD63, 0xBE47EE4B, 0x8DF73035,
+      0x21F3FF88, 0x0A142FD8, 0xC1F57AC6, 0xFB2E031D,
+      0x09A7F525, 0x0B05486B, 0xB2E73149, 0x65E3F34E,
+      0xC1C6DF60, 0x1DA683DA, 0xED108D25, 0xE5346FBA
+    },
+    { // velocity sweep
+      0x562D8745, 0x562D8745, 0x6B5A6DF6, 0xBC9877A8,
+      0xB81FF045, 0x82F7FB33, 0x532F88A5, 0x8279F9EC,
+      0x8C6185C8, 0x009D37FE, 0x9A7D933D, 0x94EDD747,
+      0xF1A3F316, 0x9B4CD32E, 0xE6A1D1C5, 0xE6A1D1C5
+    },
+    { // extremes & clipping
+      0xE345E15B, 0x12E278C0, 0x346F815D, 0x20B7679F,
+      0x9BD28319, 0x9C614BEE, 0x6212C356, 0x52C79626,
+      0x312E0E6C, 0x871D061A, 0xFFE5CA08, 0x2382D9CB,
+      0x3FBE0A8E, 0x99603CF0, 0xE0772935, 0xF2EE861C
+    }
+};
+
+/** Hash a block of samples (32-bit FNV-1a) in a byte order independent way */
+static uint32_t hash_samples(const int16_t *buf, size_t samples) {
+  uint32_t h = FNV_OFFSET_BASIS;
+
+  for (size_t i = 0; i < samples; i++) {
+    uint16_t s = (uint16_t)buf[i];
+    h = (h ^ (s & 0xFF)) * FNV_PRIME;
+    h = (h ^ (s >> 8)) * FNV_PRIME;
+  }
+  return h;
+}
+
+/** Render one scenario from a freshly initialized synth, putting the
+ * hash of each block into block_hashes[SYNTHCHECK_BLOCKS], and the
+ * samples into samples[SYNTHCHECK_SAMPLES] unless that is NULL.
+ */
+void synthcheck_render(size_t scenario, uint32_t *block_hashes, int16_t *samples) {
+  int16_t block_buf[SYNTHCHECK_BLOCK_SZ];
+  int16_t *buf = block_buf;
+  const synthcheck_event_t *e = scenarios[scenario];
+  midi_message mm;
+
+  synth_init(SYNTHCHECK_SAMPLE_RATE);
+
+  for (uint8_t block = 0; block < SYNTHCHECK_BLOCKS; block++) {
+    while (e->block == block) {
+      mm.type = e->status;
+      mm.channel = e->status & 0x0F;
+      mm.data1 = e->data1;
+      mm.data2 = e->data2;
+      synth_process_midi(&mm);
+      e++;
+    }
+    if (samples != NULL) {
+      buf = &samples[block * SYNTHCHECK_BLOCK_SZ];
+    }
+    synth_fill(buf, SYNTHCHECK_BLOCK_SZ);
+    block_hashes[block] = hash_samples(buf, SYNTHCHECK_BLOCK_SZ);
+  }
+}
+
+/** Render every scenario and compare against the golden hashes.
+ * Leaves the synth freshly initialized (silent) afterwards.
+ */
+void synthcheck_run(synthcheck_result_t *result) {
+  uint32_t hashes[SYNTHCHECK_BLOCKS];
+
+  result->scenarios = synthcheck_num_scenarios;
+  result->failures = 0;
+  result->failed_scenario = -1;
+  result->first_bad_sample = 0;
+  result->last_bad_sample = 0;
+
+  for (size_t s = 0; s < synthcheck_num_scenarios; s++) {
+    synthcheck_render(s, hashes, NULL);
+
+    for (size_t b = 0; b < SYNTHCHECK_BLOCKS; b++) {
+      if (hashes[b] != synthcheck_golden[s][b]) {
+        if (result->failures == 0) {
+          result->failed_scenario = s;
+          result->first_bad_sample = b * SYNTHCHECK_BLOCK_SZ;
+          result->last_bad_sample = (b + 1) * SYNTHCHECK_BLOCK_SZ - 1;
+        }
+        result->failures++;
+        break;
+      }
+    }
+  }
+
+  synth_init(SYNTHCHECK_SAMPLE_RATE);
+}
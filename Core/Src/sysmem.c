@@ -29,18 +29,27 @@
   * Updated as follows:
   * * Remove reference to _Min_Stack_Size as the stack is now fully
   *   pre-allocated and of a fixed size in DTCM.
+  * * Track the current and peak heap break and failed requests
+  *   (2025-03-25) so heap sizing can be done from measurements.
   */
 
 
 /* Includes */
 #include <errno.h>
 #include <stdint.h>
+#include "sysmem.h"
 
 /**
  * Pointer to the current high watermark of the heap usage
  */
 static uint8_t *__sbrk_heap_end = NULL;
 
+/**
+ * Highest heap end ever handed out, and how many requests failed
+ */
+static uint8_t *__sbrk_heap_peak = NULL;
+static uint32_t __sbrk_failures = 0;
+
 /**
  * @brief _sbrk() allocates memory to the newlib heap and is used by malloc
  *        and others from the C library
@@ -75,12 +84,34 @@ void *_sbrk(ptrdiff_t incr)
   /* Protect heap from growing into the reserved MSP stack */
   if (__sbrk_heap_end + incr > max_heap)
   {
+    __sbrk_failures++;
     errno = ENOMEM;
     return (void *)-1;
   }
 
   prev_heap_end = __sbrk_heap_end;
   __sbrk_heap_end += incr;
+  if (__sbrk_heap_end > __sbrk_heap_peak)
+  {
+    __sbrk_heap_peak = __sbrk_heap_end;
+  }
 
   return (void *)prev_heap_end;
 }
+
+/**
+ * @brief Reports the heap break: the total heap size, how much has been
+ *        given to newlib (now and at most), and failed _sbrk() requests
+ *
+ * @param stats Filled in with the heap statistics
+ */
+void sysmem_get_stats(sysmem_stats_t *stats)
+{
+  extern uint8_t _end;
+  extern uint8_t _eheap;
+
+  stats->heap_size = &_eheap - &_end;
+  stats->heap_brk = __sbrk_heap_end == NULL ? 0 : __sbrk_heap_end - &_end;
+  stats->heap_brk_peak = __sbrk_heap_peak == NULL ? 0 : __sbrk_heap_peak - &_end;
+  stats->sbrk_failures = __sbrk_failures;
+}
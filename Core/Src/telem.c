@@ -0,0 +1,165 @@
+/*
+ * telem.c
+ *
+ *  Created on: 2025-04-08
+ *  Updated on: 2025-04-08
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Binary telemetry stream.
+ *
+ * The '6' and '7' text dumps are a snapshot now and then, formatted
+ * at human speed. Streaming instead sends a fixed binary snapshot
+ * (see telem_snapshot_t) every TELEM_PERIOD_MS, which costs a struct
+ * fill and a byte-stuffing pass rather than a page of snprintf, and
+ * can be logged and plotted on the host under real load.
+ *
+ * Each payload gets a CRC-16/CCITT-FALSE (little endian) and is COBS
+ * encoded, so it contains no zero bytes, then sent between two zero
+ * delimiters. Other console text between frames ends up as a "frame"
+ * of its own that fails the CRC, and the receiver shows it as text;
+ * a frame cut short (or dropped whole by the console when it is
+ * backed up) is noticed from its sequence number.
+ *
+ * Profiling zones add up the cycles spent in parts of the main loop,
+ * with the longest, over each snapshot period.
+ *
+ * Decimated audio: every TELEM_AUDIO_DECIMATE'th sample written to
+ * the I2S buffer is collected, without filtering, into frames of
+ * TELEM_AUDIO_SAMPLES. That is plenty for watching levels and
+ * envelopes, but not for listening. While a full frame waits to be
+ * sent, samples are skipped; each frame says which sample it starts at.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "realmain.h"
+#include "telem.h"
+
+_Static_assert(sizeof(telem_audio_t) <= sizeof(telem_snapshot_t),
+               "Frames are sized for the snapshot");
+
+FAST_BSS telem_state_t telem;
+FAST_BSS telem_zone_t telem_zones[TELEM_ZONES];
+
+// CRC-16/CCITT-FALSE, a nibble at a time
+static const uint16_t crc_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+void telem_init(void) {
+  memset(&telem, 0, sizeof(telem));
+  memset(telem_zones, 0, sizeof(telem_zones));
+}
+
+uint16_t telem_crc16(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+
+  while (len-- > 0) {
+    crc = (crc << 4) ^ crc_nibble[(crc >> 12) ^ (*data >> 4)];
+    crc = (crc << 4) ^ crc_nibble[(crc >> 12) ^ (*data++ & 0x0F)];
+  }
+  return crc;
+}
+
+/** Builds a frame of payload into out: a zero, the COBS encoding of
+ * the payload and its CRC, and another zero. Returns the length, or 0
+ * if out_sz is less than TELEM_FRAME_MAX(len).
+ */
+size_t telem_frame(uint8_t *out, size_t out_sz, const void *payload, size_t len) {
+  const uint8_t *p = payload;
+  uint16_t crc = telem_crc16(p, len);
+  size_t o = 2, code_pos = 1;
+  uint8_t code = 1, b;
+
+  if (out_sz < TELEM_FRAME_MAX(len)) {
+    return 0;
+  }
+
+  out[0] = 0;
+  for (size_t i = 0; i < len + 2; i++) {
+    b = i < len ? p[i] : i == len ? crc & 0xFF : crc >> 8;
+    if (b == 0) {
+      out[code_pos] = code;
+      code_pos = o++;
+      code = 1;
+      continue;
+    }
+    out[o++] = b;
+    if (++code == 0xFF) {
+      // Longest run without a zero
+      out[code_pos] = code;
+      code_pos = o++;
+      code = 1;
+    }
+  }
+  out[code_pos] = code;
+  out[o++] = 0;
+  return o;
+}
+
+/** Fills in a payload header, using up the type's next sequence number */
+void telem_header(telem_header_t *hdr, uint8_t type, uint32_t now_ms) {
+  hdr->type = type;
+  hdr->version = TELEM_VERSION;
+  hdr->seq = telem.seq[type]++;
+  hdr->cycles = cyclecount_now();
+  hdr->ms = now_ms;
+}
+
+/** Starts or stops streaming; the zones start over. */
+void telem_set_streaming(bool on, uint32_t now_ms) {
+  telem.streaming = on;
+  telem.last_ms = now_ms;
+  telem.audio_count = 0;
+  telem.audio_ready = false;
+  memset(telem_zones, 0, sizeof(telem_zones));
+}
+
+/** Copies the zones into a snapshot and starts them over. */
+void telem_take_zones(telem_snapshot_t *snap) {
+  memcpy(snap->zones, telem_zones, sizeof(telem_zones));
+  memset(telem_zones, 0, sizeof(telem_zones));
+}
+
+/** Collects decimated audio from a block just rendered. */
+void telem_audio_add(const int16_t *buf, size_t samples) {
+  telem_audio_t *f = &telem.audio_frame;
+  uint32_t n = telem.audio_sample;
+  size_t i = (TELEM_AUDIO_DECIMATE - n % TELEM_AUDIO_DECIMATE) % TELEM_AUDIO_DECIMATE;
+
+  telem.audio_sample += samples;
+  if (!telem.streaming || !telem.audio) {
+    return;
+  }
+
+  for (; i < samples && !telem.audio_ready; i += TELEM_AUDIO_DECIMATE) {
+    if (telem.audio_count == 0) {
+      f->first = n + i;
+    }
+    f->samples[telem.audio_count++] = buf[i];
+    telem.audio_ready = telem.audio_count == TELEM_AUDIO_SAMPLES;
+  }
+}
+
+/** Returns the full audio frame, with its header filled in, and
+ * starts collecting the next one; or NULL if it is not full yet.
+ * Send it before the next telem_audio_add().
+ */
+const telem_audio_t *telem_audio_take(uint32_t now_ms) {
+  telem_audio_t *f = &telem.audio_frame;
+
+  if (!telem.audio_ready) {
+    return NULL;
+  }
+  telem_header(&f->hdr, TELEM_AUDIO, now_ms);
+  f->decimate = TELEM_AUDIO_DECIMATE;
+  f->count = telem.audio_count;
+  telem.audio_ready = false;
+  telem.audio_count = 0;
+  return f;
+}
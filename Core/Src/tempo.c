@@ -0,0 +1,179 @@
+/*
+ * tempo.c
+ *
+ *  Created on: 2025-03-30
+ *  Updated on: 2025-03-30
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * MIDI clock tempo tracker.
+ *
+ * Each clock (0xF8, 24 per beat) is timestamped with the DWT cycle
+ * counter when it is received. Those timestamps jitter with the
+ * sender, the wire and our polling, so an alpha-beta filter (a
+ * second order PLL) predicts when each clock should arrive from the
+ * last filtered one and the period, and moves both a fraction of
+ * the way toward where the clock actually arrived. Clocks too far
+ * off to be jitter (a tempo jump or a missed clock) resync the
+ * filter instead. This is O(1) per clock.
+ *
+ * The beat position is interpolated from the filtered clock time and
+ * period, not from raw arrivals, so it is smooth. It never runs
+ * past the next clock before it arrives and never goes backward,
+ * except when the transport moves it (Start, Song Position Pointer),
+ * which changes epoch.
+ *
+ * Positions are beats (quarter notes) in Q32.32.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "midi.h"
+#include "tempo.h"
+
+void tempo_init(tempo_t *t, uint32_t cpu_hz) {
+  memset(t, 0, sizeof(*t));
+  t->cpu_hz = cpu_hz;
+}
+
+/** Song position in clocks to beats in Q32.32 */
+static inline uint64_t clocks_to_beat(uint32_t clocks) {
+  return ((uint64_t)clocks << 32) / TEMPO_PPQN;
+}
+
+/** Takes a clock message received at time now. */
+void tempo_clock(tempo_t *t, uint32_t now) {
+  uint32_t interval = now - t->last_clock;
+  uint32_t period, err;
+  int32_t r;
+
+  if (t->clocks == 0 || interval > (uint64_t)t->cpu_hz * 60 / (TEMPO_MIN_BPM * TEMPO_PPQN)) {
+    // First clock, or first after the clock stopped: only a time reference
+    t->locked = false;
+    t->est_clock = now;
+  } else if (!t->locked) {
+    t->period_q16 = (uint64_t)interval << 16;
+    t->est_clock = now;
+    t->locked = true;
+  } else {
+    period = t->period_q16 >> 16;
+    r = (int32_t)(now - (t->est_clock + period));
+    err = r < 0 ? -r : r;
+
+    if (err > period / 2) {
+      t->resyncs++;
+      t->period_q16 = (uint64_t)interval << 16;
+      t->est_clock = now;
+    } else {
+      if (err > t->jitter_max) {
+        t->jitter_max = err;
+      }
+      t->est_clock += period + r / (1 << TEMPO_ALPHA_SHIFT);
+      t->period_q16 += ((int64_t)r << 16) / (1 << TEMPO_BETA_SHIFT);
+    }
+  }
+  t->last_clock = now;
+  t->clocks++;
+
+  if (t->running) {
+    t->position = t->next_position++;
+    t->ticking = true;
+  }
+}
+
+/** Start: play from the beginning at the next clock. */
+void tempo_start(tempo_t *t) {
+  t->running = true;
+  t->ticking = false;
+  t->next_position = 0;
+  t->hold = 0;
+  t->last_beat = 0;
+  t->epoch++;
+}
+
+/** Continue: play on from where we stopped at the next clock. */
+void tempo_continue(tempo_t *t, uint32_t now) {
+  t->hold = tempo_beat(t, now);
+  t->running = true;
+  t->ticking = false;
+}
+
+/** Stop: hold the position where it is now. */
+void tempo_stop(tempo_t *t, uint32_t now) {
+  t->hold = tempo_beat(t, now);
+  t->running = false;
+  t->ticking = false;
+}
+
+/** Song Position Pointer: where the next clock is, in 16th notes. */
+void tempo_song_position(tempo_t *t, uint16_t spp) {
+  t->next_position = (uint32_t)spp * TEMPO_CLOCKS_PER_SPP;
+  t->hold = clocks_to_beat(t->next_position);
+  t->last_beat = t->hold;
+  t->ticking = false;
+  t->epoch++;
+}
+
+/** Takes any MIDI message received at that time; returns true if it
+ * was one the tracker uses.
+ */
+bool tempo_process_midi(tempo_t *t, const midi_message *mm, uint32_t received) {
+  switch (mm->type) {
+  case MIDI_RT_TIMING_CLOCK:
+    tempo_clock(t, received);
+    return true;
+  case MIDI_RT_START:
+    tempo_start(t);
+    return true;
+  case MIDI_RT_CONTINUE:
+    tempo_continue(t, received);
+    return true;
+  case MIDI_RT_STOP:
+    tempo_stop(t, received);
+    return true;
+  case MIDI_SONG_POSITION:
+    tempo_song_position(t, MIDI_14bits(mm));
+    return true;
+  default:
+    return false;
+  }
+}
+
+/** Beat position at time now, in Q32.32 beats. */
+uint64_t tempo_beat(tempo_t *t, uint32_t now) {
+  uint64_t beat, fraction;
+  uint32_t period;
+  int32_t elapsed;
+
+  if (!t->ticking) {
+    return t->hold;
+  }
+
+  beat = (uint64_t)t->position << 32;
+  if (t->locked) {
+    // How far we are toward the next clock, short of reaching it
+    period = t->period_q16 >> 16;
+    elapsed = (int32_t)(now - t->est_clock);
+    if (elapsed > 0) {
+      fraction = ((uint64_t)elapsed << 32) / period;
+      beat += fraction < 0xFFFFFFFF ? fraction : 0xFFFFFFFF;
+    }
+  }
+  beat /= TEMPO_PPQN;
+
+  if (beat < t->last_beat) {
+    beat = t->last_beat;
+  }
+  t->last_beat = beat;
+  return beat;
+}
+
+/** Tempo in BPM x 100, or 0 if unknown. */
+uint32_t tempo_bpm_x100(const tempo_t *t) {
+  if (!t->locked || t->period_q16 == 0) {
+    return 0;
+  }
+  return (uint64_t)t->cpu_hz * 60 * 100 * 65536 / (TEMPO_PPQN * t->period_q16);
+}
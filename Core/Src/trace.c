@@ -0,0 +1,124 @@
+/*
+ * trace.c
+ *
+ *  Created on: 2025-03-24
+ *  Updated on: 2025-03-24
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Binary event trace ring.
+ *
+ * Events are 8 bytes: a DWT cycle count timestamp, an event id and
+ * two arguments (see trace.h). The ring lives in DTCM and always
+ * holds the most recent TRACE_ENTRIES events; older ones are
+ * overwritten. trace_head counts every event ever recorded.
+ *
+ * A dump freezes the ring (tracing stops) and hands out the header
+ * and then the records, oldest first, as contiguous spans that the
+ * caller queues to the serial console as space allows. The dump does
+ * not fit into the console transmit buffer at once, so this is done
+ * a bit per main loop. Once the last byte is consumed the ring is
+ * cleared and tracing restarts.
+ *
+ * Any event an interrupt was in the middle of writing at the moment
+ * of the freeze is finished long before the main loop gets around
+ * to sending it.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "realmain.h"
+#include "trace.h"
+
+FAST_BSS trace_record_t trace_ring[TRACE_ENTRIES];
+FAST_BSS volatile uint32_t trace_head;
+FAST_BSS volatile uint32_t trace_enabled;
+
+// Dump state
+static trace_dump_header_t dump_header;
+static int dumping = 0;
+static uint32_t dump_first; // trace_head value of the oldest record
+static size_t dump_pos;     // Bytes consumed so far
+static size_t dump_len;     // Total bytes in this dump
+
+/** Clear the ring and start tracing. */
+void trace_init(void) {
+  trace_enabled = 0;
+  trace_head = 0;
+  memset(trace_ring, 0, sizeof(trace_ring));
+  dumping = 0;
+  trace_enabled = 1;
+}
+
+/** Stop tracing and prepare to send everything in the ring. */
+void trace_dump_begin(void) {
+  uint32_t head, count;
+
+  if (dumping) {
+    return;
+  }
+
+  trace_enabled = 0;
+  head = trace_head;
+  count = head < TRACE_ENTRIES ? head : TRACE_ENTRIES;
+
+  memcpy(dump_header.magic, TRACE_MAGIC, sizeof(dump_header.magic));
+  dump_header.cpu_hz = SystemCoreClock;
+  dump_header.count = count;
+  dump_header.record_sz = sizeof(trace_record_t);
+  dump_header.lost = head - count;
+
+  dump_first = head - count;
+  dump_pos = 0;
+  dump_len = sizeof(dump_header) + count * sizeof(trace_record_t);
+  dumping = 1;
+}
+
+/** Is a dump in progress? Other console output should hold off. */
+int trace_dump_active(void) {
+  return dumping;
+}
+
+/** Points data at the next bytes of the dump and returns how many
+ * are contiguous there; 0 when there is no dump in progress.
+ */
+size_t trace_dump_peek(const uint8_t **data) {
+  size_t offset, slot, in_record, avail;
+
+  if (!dumping) {
+    return 0;
+  }
+
+  if (dump_pos < sizeof(dump_header)) {
+    *data = (const uint8_t *)&dump_header + dump_pos;
+    return sizeof(dump_header) - dump_pos;
+  }
+
+  // Records are contiguous up to the end of the ring array
+  offset = dump_pos - sizeof(dump_header);
+  slot = (dump_first + offset / sizeof(trace_record_t)) & (TRACE_ENTRIES - 1);
+  in_record = offset % sizeof(trace_record_t);
+  *data = (const uint8_t *)&trace_ring[slot] + in_record;
+
+  avail = (TRACE_ENTRIES - slot) * sizeof(trace_record_t) - in_record;
+  if (avail > dump_len - dump_pos) {
+    avail = dump_len - dump_pos;
+  }
+  return avail;
+}
+
+/** Marks bytes returned by trace_dump_peek() as sent. Ends the dump
+ * and restarts tracing when everything has been sent.
+ */
+void trace_dump_consume(size_t bytes) {
+  if (!dumping) {
+    return;
+  }
+
+  dump_pos += bytes;
+  if (dump_pos >= dump_len) {
+    trace_init();
+  }
+}
@@ -33,8 +33,7 @@
 #define BUF_SZ_USART_RX ((size_t)32)
 uint8_t console_rx_buf[BUF_SZ_USART_RX];
 #define BUF_SZ_USART_TX ((size_t)200)
-uint8_t console_tx_buf1[BUF_SZ_USART_RX];
-uint8_t console_tx_buf2[BUF_SZ_USART_RX];
+uint8_t console_tx_buf[2 * BUF_SZ_USART_RX + UDCR_TX_BOUNCE_SZ];
 
 void serial_transmit2(char *buf, uint16_t len) {
   for (size_t i = 0; i < len; i++) {
@@ -45,7 +44,7 @@ void serial_transmit2(char *buf, uint16_t len) {
 
 void uartrxdmamain() {
 
-  usart_dma_config_t console;
+  usart_dma_config_t console = { 0 };
   bool x = false;
   uint16_t rxc_or_not; // received character or not
   char rxc;
@@ -58,9 +57,8 @@ void uartrxdmamain() {
 
   console.rx_buf = console_rx_buf;
   console.rx_buf_sz = sizeof(console_rx_buf);
-  console.tx_buf1 = console_tx_buf1;
-  console.tx_buf2 = console_tx_buf2;
-  console.tx_buf_sz = sizeof(console_tx_buf1);
+  console.tx_buf = console_tx_buf;
+  console.tx_buf_sz = sizeof(console_tx_buf);
 
   udcr_init(&console);
 
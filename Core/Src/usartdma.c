@@ -3,11 +3,41 @@
  *
  * USART Receiving: Implements a DMA-based circular buffer receiver
  * with the ability to pull characters when available via a function.
+ * Bulk readers can instead peek at everything received as (up to two)
+ * spans of the buffer itself, handle them in place, and then consume
+ * them all at once - one DMA register read per burst instead of per
+ * byte. The receive buffer has to be in non-cached memory for that
+ * (as with DMA_BSS).
  *
- * USART Transmitting: Implements a dual-buffer DMA send.
- * One buffer is actually sending, and the other buffer is
- * queuing things for send. Periodically check if the DMA is
- * not sending, and if so, swap buffers and initiate a send.
+ * USART Receive events (optional, rx_events): rather than looking at
+ * the DMA position every main loop pass, the USART IDLE interrupt
+ * (a frame time of quiet line after bytes arrive) and the receive DMA
+ * half and full interrupts (so long bursts are noticed before they
+ * lap the buffer) count arrivals. udcr_rx_ready() then says whether
+ * there is anything to look at, and a sleeping main loop wakes up on
+ * the interrupt.
+ *
+ * USART Receive overruns: the DMA position alone can't tell an empty
+ * buffer from one the DMA has gone all the way around, so we also
+ * count every byte received, from how far the DMA position has moved
+ * each time we look. With rx_events we look at least every half
+ * buffer, so the count is exact even when the main loop stalls, and
+ * when it shows more waiting than the buffer holds, the DMA has lapped
+ * us. The unread bytes are then a mix of old and new, so they are all
+ * dropped and counted, and reading starts again at the DMA position.
+ * (Without rx_events this only works if the main loop looks at least
+ * once per buffer's worth anyway.)
+ *
+ * USART Transmitting: Implements a queue of segments to send, each a
+ * run of bytes: either copied into the tx_buf ring (udcr_queue_bytes),
+ * or the caller's constant data (udcr_queue_const), which the DMA
+ * reads right where it is if it can (flash, DTCM), or which is copied
+ * through a small bounce buffer a bit at a time if not (cached RAM,
+ * flash over ITCM). Copies queued back to back go into one segment.
+ * Call udcr_send_from_queue() to start sending; after that, the DMA
+ * complete interrupt starts the next segment (or bounce buffer's
+ * worth) right away, so the line doesn't sit idle until the main loop
+ * comes around again.
  *
  * USART needs to be configured as follows:
  * 1. LL API
@@ -21,7 +51,7 @@
  * first, unfortunately.
  *
  *  Created on: 2024-11-17
- *  Updated on: 2024-11-23
+ *  Updated on: 2025-04-11
  *      Author: Douglas P. Fields, Jr.
  *   Copyright: 2024, Douglas P. Fields, Jr.
  *     License: Apache 2.0
@@ -33,19 +63,94 @@
 #include <stdio.h>
 #include <string.h>
 #include "usartdma.h"
+#include "trace.h"
 
 
-typedef struct udcr_callback_map_entry {
-  USART_TypeDef *usartx;
-  usart_dma_config_t *udcr;
-} udcr_callback_map_entry_t;
-
-#define NUM_USART_CHANNELS 6
-/* Our callbacks only have n USARTx in the LL implementation,
- * so we have to map that to our usart_dma_config_t somehow.
+/* Our interrupt handlers know their DMA stream, so udcr_init() puts
+ * each usart_dma_config_t in the slots of its streams, and the
+ * handlers pass it straight to us without a search.
  */
 // TODO: Make this live in fast data RAM
-static udcr_callback_map_entry_t callback_map[NUM_USART_CHANNELS] = { 0 };
+usart_dma_config_t *udcr_slots[UDCR_DMA_SLOTS] = { 0 };
+
+/** Where in rx_buf the DMA will write the next received byte.
+ * LL_DMA_GetDataLength() counts down from rx_buf_sz as each byte is
+ * received, and reloads to rx_buf_sz after 1. (It is read as 0 only
+ * during the reload, which is the same place.)
+ */
+static inline size_t rx_write_index(usart_dma_config_t *udcr) {
+  size_t index = udcr->rx_buf_sz - LL_DMA_GetDataLength(udcr->dma_rx, udcr->dma_rx_stream);
+  return index >= udcr->rx_buf_sz ? 0 : index;
+}
+
+/** Where in rx_buf we read next. next_read_pos is kept in the
+ * same units as LL_DMA_GetDataLength(), rx_buf_sz down to 1.
+ */
+static inline size_t rx_read_index(const usart_dma_config_t *udcr) {
+  return udcr->rx_buf_sz - udcr->next_read_pos;
+}
+
+/** Catches rx_total up with the DMA position, which must not have
+ * gone all the way around since the last time. Called from the
+ * receive interrupts, and from the main loop with them masked.
+ */
+static inline void rx_update_total(usart_dma_config_t *udcr) {
+  size_t write = rx_write_index(udcr);
+
+  udcr->rx_total += (write + udcr->rx_buf_sz - udcr->rx_last_write) % udcr->rx_buf_sz;
+  udcr->rx_last_write = write;
+}
+
+/** Whether the DMA can read len bytes at p: flash over AXI, or DTCM.
+ * Other RAM may be cached, so the DMA could read stale data.
+ */
+static inline bool dma_can_read(const uint8_t *p, size_t len) {
+  uintptr_t a = (uintptr_t)p;
+
+  return (a >= FLASHAXI_BASE && a + len - 1 <= FLASH_END) ||
+         (a >= RAMDTCM_BASE && a + len <= RAMDTCM_BASE + 64 * 1024);
+}
+
+/** Starts the DMA sending the next part of the tail segment, if any.
+ * Called from the complete interrupt, or with it masked.
+ */
+static void tx_start(usart_dma_config_t *udcr) {
+  const udcr_tx_seg_t *seg;
+  const uint8_t *src;
+  uint32_t send_sz;
+
+  if (udcr->tx_seg_tail == udcr->tx_seg_head) {
+    udcr->is_sending = 0;
+    return;
+  }
+  udcr->is_sending = 1;
+
+  seg = &udcr->tx_segs[udcr->tx_seg_tail & (UDCR_TX_SEGS - 1)];
+  send_sz = seg->len - udcr->tx_seg_sent;
+  src = seg->data + udcr->tx_seg_sent;
+  if (seg->flags & UDCR_SEG_BOUNCE) {
+    uint8_t *bounce = udcr->tx_buf + udcr->tx_buf_sz - UDCR_TX_BOUNCE_SZ;
+    if (send_sz > UDCR_TX_BOUNCE_SZ) {
+      send_sz = UDCR_TX_BOUNCE_SZ;
+    }
+    memcpy(bounce, src, send_sz);
+    src = bounce;
+  } else if (send_sz > 0xFFFF) {
+    // Most the DMA can do at once
+    send_sz = 0xFFFF;
+  }
+  udcr->tx_send_sz = send_sz;
+
+  // Begin sending
+  TRACE(TRACE_DMA_START, TRACE_DMA_ID(udcr->dma_tx, udcr->dma_tx_stream), send_sz);
+  LL_DMA_DisableStream(udcr->dma_tx, udcr->dma_tx_stream);
+  // Crazy that the memory address type is a uint32_t than a pointer
+  LL_DMA_SetMemoryAddress(udcr->dma_tx, udcr->dma_tx_stream, (uint32_t)src);
+  LL_DMA_SetDataLength(udcr->dma_tx, udcr->dma_tx_stream, send_sz);
+  LL_DMA_EnableStream(udcr->dma_tx, udcr->dma_tx_stream);
+  LL_USART_EnableDMAReq_TX(udcr->usartx);
+  LL_USART_EnableDirectionTx(udcr->usartx);
+}
 
 /*
  * Callback function when an DMA transfer has completed,
@@ -54,34 +159,53 @@ static udcr_callback_map_entry_t callback_map[NUM_USART_CHANNELS] = { 0 };
  * We can gratuitously blink an LED for now just to show it working.
  */
 // TODO: Make this live in fast code RAM
-void usart_dma_transfer_complete(USART_TypeDef *usartx) {
-  if (usartx == NULL) {
+void usart_dma_transfer_complete(usart_dma_config_t *udcr) {
+  // If nothing is using this stream, do nothing
+  if (udcr == NULL) {
     return;
   }
 
-  usart_dma_config_t *udcr = NULL;
+  // Flash or transmit stuff for gratuitous purposes
+#ifdef TOGGLE_LEDS
+  HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_14); // Green LED
+  // HAL_UART_Transmit(&huart2, (uint8_t *)"+", 1, HAL_MAX_DELAY);
+#endif
 
-  // Find our usart_dma_config_t from usartx
-  // (hopefully the optimizer will unroll this loop)
-  for (int i = 0; i < NUM_USART_CHANNELS; i++) {
-    if (callback_map[i].usartx == usartx) {
-      udcr = callback_map[i].udcr;
-      break;
+  TRACE(TRACE_DMA_COMPLETE, TRACE_DMA_ID(udcr->dma_tx, udcr->dma_tx_stream), 0);
+
+  // Finish the segment if that was all of it
+  if (udcr->is_sending && udcr->tx_seg_tail != udcr->tx_seg_head) {
+    const udcr_tx_seg_t *seg = &udcr->tx_segs[udcr->tx_seg_tail & (UDCR_TX_SEGS - 1)];
+    udcr->tx_seg_sent += udcr->tx_send_sz;
+    if (udcr->tx_seg_sent >= seg->len) {
+      if (seg->flags & UDCR_SEG_COPIED) {
+        udcr->tx_buf_tail += seg->len;
+      }
+      udcr->tx_seg_sent = 0;
+      udcr->tx_seg_tail++;
     }
   }
 
-  // If we cannot identify the sending interrupt, do nothing
+  // And keep going
+  tx_start(udcr);
+  if (udcr->is_sending) {
+    udcr->tx_chained++;
+  }
+}
+
+/*
+ * Callback function when bytes have been received, from the USART
+ * IDLE or the receive DMA half/complete interrupt (with rx_events).
+ * The caller clears the interrupt flag. This is an interrupt handler.
+ */
+void usart_dma_rx_event(usart_dma_config_t *udcr) {
   if (udcr == NULL) {
     return;
   }
 
-  // Flash or transmit stuff for gratuitous purposes
-#ifdef TOGGLE_LEDS
-  HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_14); // Green LED
-  // HAL_UART_Transmit(&huart2, (uint8_t *)"+", 1, HAL_MAX_DELAY);
-#endif
-
-  udcr->is_sending = 0;
+  rx_update_total(udcr);
+  udcr->rx_available = udcr->rx_total - udcr->rx_read_total;
+  udcr->rx_notify++;
 }
 
 /** Using LL, configures a U(S)ART and DMA for (circular) buffer
@@ -103,45 +227,31 @@ udcr_return_value_t udcr_init(usart_dma_config_t *udcr) {
     return UDCR_IGNORED;
   }
 
-  // Update our callback map so we can handle this new spidma_config_t
-  int i;
-  for (i = 0; i < NUM_USART_CHANNELS; i++) {
-    if (callback_map[i].usartx == udcr->usartx) {
-      return UDCR_IN_USE;
-    }
-  }
-  for (i = 0; i < NUM_USART_CHANNELS; i++) {
-    if (callback_map[i].usartx == NULL) {
-      // Allocate this one
-      callback_map[i].usartx = udcr->usartx;
-      callback_map[i].udcr = udcr;
-      break;
-    }
-  }
-  if (i >= NUM_USART_CHANNELS) {
-    // No available entry found
-    return UDCR_FULL;
+  // Take the interrupt slots of our streams
+  usart_dma_config_t **rx_slot = &udcr_slots[UDCR_SLOT(udcr->dma_rx, udcr->dma_rx_stream)];
+  usart_dma_config_t **tx_slot = &udcr_slots[UDCR_SLOT(udcr->dma_tx, udcr->dma_tx_stream)];
+  if ((*rx_slot != NULL && *rx_slot != udcr) || (*tx_slot != NULL && *tx_slot != udcr)) {
+    return UDCR_IN_USE;
   }
+  *rx_slot = udcr;
+  *tx_slot = udcr;
 
-  // Register the send complete interrupt callback next.
-  // The LL system does not have a mechanism for this.
-  // You have to hard-code the callback.
-  // See: DMA1_Stream6_IRQHandler() in stm32f7xx_it.c
+  // The LL system does not have a mechanism for registering the
+  // interrupt callbacks; the handlers have to be hard-coded to call
+  // us with their slot. See: DMA1_Stream6_IRQHandler() in stm32f7xx_it.c
   udcr->is_sending = 0;
 
 
   // Set our last rx read position, which is always the buffer size
   udcr->next_read_pos = udcr->rx_buf_sz;
 
-  // Set up our tx buffers
-  // We will queue initially into the first buffer
-  udcr->tx_q_buf = udcr->tx_buf1;
-  udcr->tx_q_next = udcr->tx_q_buf;
-  udcr->tx_q_sz_remain = udcr->tx_buf_sz;
-
-  // And we'll send from the other buffer
-  udcr->tx_send_buf = udcr->tx_buf2;
+  // Set up our tx queue
+  udcr->tx_seg_head = 0;
+  udcr->tx_seg_tail = 0;
+  udcr->tx_seg_sent = 0;
   udcr->tx_send_sz = 0;
+  udcr->tx_buf_head = 0;
+  udcr->tx_buf_tail = 0;
   udcr->is_sending = 0;
 
   // Initialize and start the DMA circular buffer receiving
@@ -150,28 +260,34 @@ udcr_return_value_t udcr_init(usart_dma_config_t *udcr) {
       (uint32_t)udcr->rx_buf,
       LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
   LL_DMA_SetDataLength(udcr->dma_rx, udcr->dma_rx_stream, udcr->rx_buf_sz);
+
+  // Event driven receive. The DMA stream interrupt handlers have to
+  // clear the HT & TC flags (see DMA1_Stream5_IRQHandler() for USART2),
+  // or the DMA stops after one buffer's worth.
+  udcr->rx_notify = 0;
+  udcr->rx_notify_seen = 0;
+  udcr->rx_total = 0;
+  udcr->rx_last_write = 0;
+  udcr->rx_read_total = 0;
+  udcr->rx_line_errors = 0;
+  if (udcr->rx_events) {
+    LL_DMA_EnableIT_HT(udcr->dma_rx, udcr->dma_rx_stream);
+    LL_DMA_EnableIT_TC(udcr->dma_rx, udcr->dma_rx_stream);
+    LL_USART_ClearFlag_IDLE(udcr->usartx);
+    LL_USART_EnableIT_IDLE(udcr->usartx);
+    NVIC_SetPriority(udcr->usart_irqn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), 1, 0));
+    NVIC_EnableIRQ(udcr->usart_irqn);
+  }
+
   LL_DMA_EnableStream(udcr->dma_rx, udcr->dma_rx_stream);
   LL_USART_EnableDMAReq_RX(udcr->usartx);
 
-  // Initialize DMA receiving
-  // If we enable TC interrupts, we need to clear the flag upon an interrupt.
-  /*
-  LL_DMA_EnableIT_TC(udcr->dma_rx, udcr->dma_rx_stream);
-  */
-  // This would need to be added in DMA1_Stream5_IRQHandler(void) for USART2_RX
-  // We seem to be unable to receive more than a full buffer worth,
-  // even with circular buffers turned on,
-  // if TC interrupts are enabled, unless we clear these interrupts.
-  /*
-  if (LL_DMA_IsActiveFlag_TC5(DMA1)) {
-    LL_DMA_ClearFlag_TC5(DMA1);
-  }
-  */
+  // Initialize DMA sending
   LL_DMA_DisableStream(udcr->dma_tx, udcr->dma_tx_stream);
   LL_DMA_EnableIT_TC(udcr->dma_tx, udcr->dma_tx_stream); // Transmit complete interrupt
   // LL_DMA_EnableIT_TE(udcr->dma_tx, udcr->dma_tx_stream); // Transmit error interrupt
   LL_DMA_ConfigAddresses(udcr->dma_tx, udcr->dma_tx_stream,
-      (uint32_t)udcr->tx_buf1,
+      (uint32_t)udcr->tx_buf,
       (uint32_t)LL_USART_DMA_GetRegAddr(udcr->usartx, LL_USART_DMA_REG_DATA_TRANSMIT),
       LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
 
@@ -185,89 +301,194 @@ udcr_return_value_t udcr_init(usart_dma_config_t *udcr) {
  * UDCR_IN_USE - sending already going on
  */
 udcr_return_value_t udcr_send_from_queue(usart_dma_config_t *udcr) {
-	if (udcr->is_sending) {
-		return UDCR_IN_USE;
-	}
-	if (udcr->tx_q_sz_remain == udcr->tx_buf_sz) {
-		// We have nothing to send
-		return UDCR_IGNORED;
-	}
-
-	udcr->is_sending = 1;
-
-	// Start sending our buffers
-	size_t send_sz = udcr->tx_buf_sz - udcr->tx_q_sz_remain;
-	uint8_t *temp;
-
-	// Swap our sending and queueing buffers
-	temp = udcr->tx_send_buf;
-	udcr->tx_send_buf = udcr->tx_q_buf;
-	udcr->tx_q_buf = temp;
-	udcr->tx_q_next = temp;
-	udcr->tx_q_sz_remain = udcr->tx_buf_sz;
-
-	// Begin sending our current sending buffer
-	LL_DMA_DisableStream(udcr->dma_tx, udcr->dma_tx_stream);
-	// Crazy that the memory address type is a uint32_t than a pointer
-	LL_DMA_SetMemoryAddress(udcr->dma_tx, udcr->dma_tx_stream, (uint32_t)udcr->tx_send_buf);
-	LL_DMA_SetDataLength(udcr->dma_tx, udcr->dma_tx_stream, send_sz);
-	LL_DMA_EnableStream(udcr->dma_tx, udcr->dma_tx_stream);
-  LL_USART_EnableDMAReq_TX(udcr->usartx);
-  LL_USART_EnableDirectionTx(udcr->usartx);
+  udcr_return_value_t rv = UDCR_OK;
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (udcr->is_sending) {
+    rv = UDCR_IN_USE;
+  } else if (udcr->tx_seg_tail == udcr->tx_seg_head) {
+    // We have nothing to send
+    rv = UDCR_IGNORED;
+  } else {
+    tx_start(udcr);
+  }
+  __set_PRIMASK(primask);
 
-	return UDCR_OK;
+  return rv;
+}
+
+/** Adds a segment, or extends the newest one if data follows right
+ * on from it and it has not started sending. Returns false if there
+ * is no room for another segment.
+ */
+static bool tx_add_segment(usart_dma_config_t *udcr, const uint8_t *data, size_t len, uint32_t flags) {
+  uint32_t primask = __get_PRIMASK();
+  udcr_tx_seg_t *last;
+  bool added = true;
+
+  __disable_irq();
+  last = &udcr->tx_segs[(udcr->tx_seg_head - 1) & (UDCR_TX_SEGS - 1)];
+  if (udcr->tx_seg_head != udcr->tx_seg_tail &&
+      !(udcr->is_sending && udcr->tx_seg_head - 1 == udcr->tx_seg_tail) &&
+      last->flags == flags && (flags & UDCR_SEG_COPIED) &&
+      last->data + last->len == data) {
+    last->len += len;
+  } else if (udcr->tx_seg_head - udcr->tx_seg_tail < UDCR_TX_SEGS) {
+    udcr_tx_seg_t *seg = &udcr->tx_segs[udcr->tx_seg_head & (UDCR_TX_SEGS - 1)];
+    seg->data = data;
+    seg->len = len;
+    seg->flags = flags;
+    udcr->tx_seg_head++;
+  } else {
+    added = false;
+  }
+  __set_PRIMASK(primask);
+
+  return added;
 }
 
 /*
- * Returns the # of bytes actually queued.
+ * Copies bytes to send. Returns the # of bytes actually queued.
  */
 size_t udcr_queue_bytes(usart_dma_config_t *udcr, const uint8_t *buf, size_t buf_sz) {
-	size_t to_enqueue = buf_sz < udcr->tx_q_sz_remain ? buf_sz : udcr->tx_q_sz_remain;
+  size_t ring_sz = udcr->tx_buf_sz - UDCR_TX_BOUNCE_SZ;
+  size_t queued = 0;
+  size_t pos, n;
+
+  while (queued < buf_sz) {
+    // As much as fits before the end of the ring; then the rest at the start
+    pos = udcr->tx_buf_head % ring_sz;
+    n = buf_sz - queued;
+    if (n > ring_sz - (udcr->tx_buf_head - udcr->tx_buf_tail)) {
+      n = ring_sz - (udcr->tx_buf_head - udcr->tx_buf_tail);
+    }
+    if (n > ring_sz - pos) {
+      n = ring_sz - pos;
+    }
+    if (n == 0) {
+      break;
+    }
 
-	if (to_enqueue == 0) {
-		return 0;
-	}
+    // destination, source, size
+    memcpy(udcr->tx_buf + pos, buf + queued, n);
+    if (!tx_add_segment(udcr, udcr->tx_buf + pos, n, UDCR_SEG_COPIED)) {
+      break;
+    }
+    udcr->tx_buf_head += n;
+    queued += n;
+  }
 
-	// Copy the data to send
-	// destination, source, size
-	memcpy(udcr->tx_q_next, buf, to_enqueue);
+  udcr->tx_copied += queued;
+  udcr->tx_dropped += buf_sz - queued;
+  return queued;
+}
 
-	// Increment our next send pointer & reduce our send size remaining
-	udcr->tx_q_next += to_enqueue;
-	udcr->tx_q_sz_remain -= to_enqueue;
+/*
+ * Queues constant bytes to send without copying them here; they must
+ * not change until they have been sent. Returns buf_sz, or 0 if
+ * there is no room.
+ */
+size_t udcr_queue_const(usart_dma_config_t *udcr, const uint8_t *buf, size_t buf_sz) {
+  bool direct = dma_can_read(buf, buf_sz);
 
-	return to_enqueue;
+  if (buf_sz == 0) {
+    return 0;
+  }
+  if (!tx_add_segment(udcr, buf, buf_sz, direct ? UDCR_SEG_BORROWED : UDCR_SEG_BOUNCE)) {
+    udcr->tx_dropped += buf_sz;
+    return 0;
+  }
+  if (direct) {
+    udcr->tx_borrowed += buf_sz;
+  } else {
+    udcr->tx_bounced += buf_sz;
+  }
+  return buf_sz;
+}
+
+/** How many received bytes are waiting to be read, dropping them all
+ * if the DMA has lapped us (see above); *lost gets how many that was.
+ * (At exactly a buffer's worth, the next byte received overwrites the
+ * oldest one, probably while we are reading it, so that counts too.)
+ */
+static size_t rx_waiting(usart_dma_config_t *udcr, size_t *lost) {
+  uint32_t primask = __get_PRIMASK();
+  uint32_t waiting;
+
+  __disable_irq();
+  rx_update_total(udcr);
+  // Anything arriving from here on is a new event
+  udcr->rx_peek_notify = udcr->rx_notify;
+  __set_PRIMASK(primask);
+
+  waiting = udcr->rx_total - udcr->rx_read_total;
+  udcr->rx_peek_write = udcr->rx_last_write;
+  *lost = 0;
+  if (waiting >= udcr->rx_buf_sz) {
+    udcr->rx_overruns++;
+    udcr->rx_lost += waiting;
+    *lost = waiting;
+    udcr_consume(udcr, waiting);
+    waiting = 0;
+  }
+
+  if (waiting == 0) {
+    udcr->rx_notify_seen = udcr->rx_peek_notify;
+  } else if (waiting > udcr->rx_peak) {
+    udcr->rx_peak = waiting;
+  }
+  return waiting;
 }
 
 /** Returns a byte from the DMA RX circular buffer, if any.
  * Returns > 0xFF if there is no data.
  */
-// TODO: Make this vastly more efficient
 uint16_t udcr_read_byte(usart_dma_config_t *udcr) {
-  uint32_t datalength = LL_DMA_GetDataLength(udcr->dma_rx, udcr->dma_rx_stream);
+  size_t lost;
+  size_t read;
 
-  if (datalength == udcr->next_read_pos) {
+  if (rx_waiting(udcr, &lost) == 0) {
     // DMA has not advanced, so nothing to read
     return 0x100;
   }
 
-  /* datalength - upon initialization, this starts at 32 (rx_buf_sz).
-   * As each letter comes in, it goes down. It never reaches 0, but after
-   * 1 it goes back to 32.
-   *
-   * However, it does receive into the buffer in the expected order, that is,
-   * the first letter received is at console_rx_buf[0].
-   */
-  size_t most_recent = udcr->rx_buf_sz - udcr->next_read_pos;
-
-  // datalength decrements each byte received by DMA
-  // and wraps at 0 to the starting length,
-  // so do that too.
-  udcr->next_read_pos--;
-  if (udcr->next_read_pos == 0) {
-    udcr->next_read_pos = udcr->rx_buf_sz;
-  }
+  read = rx_read_index(udcr);
+  udcr_consume(udcr, 1);
+  return udcr->rx_buf[read];
+}
 
-  return udcr->rx_buf[most_recent];
+/** Finds everything received and not yet consumed, without copying
+ * it: spans points into rx_buf. Returns the total number of bytes.
+ * They stay where they are until udcr_consume(), but have to be
+ * consumed before the DMA comes all the way around the buffer again.
+ * spans->lost says if bytes were dropped before these because it did.
+ */
+size_t udcr_peek_spans(usart_dma_config_t *udcr, udcr_spans_t *spans) {
+  size_t waiting = rx_waiting(udcr, &spans->lost);
+  size_t read = rx_read_index(udcr);
+
+  spans->buf[0] = &udcr->rx_buf[read];
+  spans->buf[1] = udcr->rx_buf;
+  if (read + waiting <= udcr->rx_buf_sz) {
+    spans->len[0] = waiting;
+    spans->len[1] = 0;
+  } else {
+    // Wrapped around the end of the buffer
+    spans->len[0] = udcr->rx_buf_sz - read;
+    spans->len[1] = waiting - spans->len[0];
+  }
+  return waiting;
 }
 
+/** Moves past n received bytes, normally the total from udcr_peek_spans(). */
+void udcr_consume(usart_dma_config_t *udcr, size_t n) {
+  size_t read = (rx_read_index(udcr) + n) % udcr->rx_buf_sz;
+
+  udcr->next_read_pos = udcr->rx_buf_sz - read;
+  udcr->rx_read_total += n;
+  if (read == udcr->rx_peek_write) {
+    // Read everything there was as of the peek
+    udcr->rx_notify_seen = udcr->rx_peek_notify;
+  }
+}
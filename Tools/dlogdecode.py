@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+#
+# dlogdecode.py
+#
+#  Created on: 2025-04-07
+#  Updated on: 2025-04-07
+#      Author: Douglas P. Fields, Jr.
+#   Copyright: 2025, Douglas P. Fields, Jr.
+#     License: Apache 2.0
+#
+# Formats the binary log frames of DLOG() (see Core/Src/dlog.c) sent
+# over the serial console in binary mode (console option "l").
+#
+# Each frame carries the address of its format string, which is looked
+# up in the .dlog_fmt section of the firmware's ELF file, so that has
+# to be the same build as is running. %s arguments are looked up in
+# the ELF file too. Anything that is not a valid frame (the menu,
+# echoed keys and other plain text) is passed through as it is.
+#
+# The log can come from a file (e.g., a raw capture of the serial
+# console) or be read directly from the serial port with pyserial.
+#
+# Usage:
+#   dlogdecode.py Debug/midi.elf capture.bin
+#   dlogdecode.py Debug/midi.elf --port /dev/ttyACM0 --timestamps
+
+import argparse
+import re
+import struct
+import sys
+
+# Keep in sync with Core/Inc/dlog.h
+SYNC = 0xA5
+HDR_SZ = 12
+MAX_ARGS = 12
+FMT_SECTION = ".dlog_fmt"
+
+SHF_ALLOC = 0x2
+SHT_PROGBITS = 1
+
+SPEC = re.compile(r"%([-+ #0]*)(\d*)(\.\d+)?(hh|h|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf:
+    """Just enough of an ELF file to read strings by address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF" or data[5] != 1:
+            raise ValueError(path + " is not a little endian ELF file")
+        if data[4] == 1:
+            shoff, = struct.unpack_from("<I", data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+            sh = struct.Struct("<IIIIIIIIII")
+        else:
+            shoff, = struct.unpack_from("<Q", data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x3A)
+            sh = struct.Struct("<IIQQQQIIQQ")
+
+        headers = [sh.unpack_from(data, shoff + i * shentsize) for i in range(shnum)]
+        names = headers[shstrndx]
+        self.sections = {}
+        self.loaded = []
+        for name, stype, flags, addr, offset, size in (h[:6] for h in headers):
+            end = data.index(b"\0", names[4] + name)
+            sname = data[names[4] + name:end].decode()
+            if stype == SHT_PROGBITS and flags & SHF_ALLOC:
+                section = (addr, addr + size, data[offset:offset + size])
+                self.sections[sname] = section
+                self.loaded.append(section)
+
+        if FMT_SECTION not in self.sections:
+            raise ValueError("No " + FMT_SECTION + " section in " + path)
+        self.fmt_start, self.fmt_end, _ = self.sections[FMT_SECTION]
+
+    def is_format(self, addr):
+        return self.fmt_start <= addr < self.fmt_end
+
+    def string(self, addr):
+        """The NUL terminated string at addr, or None if it is not in the file."""
+        for start, end, data in self.loaded:
+            if start <= addr < end:
+                pos = addr - start
+                stop = data.find(b"\0", pos)
+                return data[pos:stop if stop >= 0 else len(data)].decode("latin-1")
+        return None
+
+
+def format_message(elf, fmt, args):
+    """printf, with each argument a 32 bit word."""
+    args = list(args)
+
+    def convert(m):
+        flags, width, precision, _, conv = m.groups()
+        if conv == "%":
+            return "%"
+        value = args.pop(0) if args else 0
+        spec = "%" + flags + width + (precision or "")
+        if conv in "di":
+            return (spec + "d") % (value - (1 << 32) if value & 0x80000000 else value)
+        if conv == "u":
+            return (spec + "d") % value
+        if conv == "c":
+            return (spec + "c") % (value & 0xFF)
+        if conv == "s":
+            s = elf.string(value)
+            return (spec + "s") % (s if s is not None else "<%08x>" % value)
+        if conv == "p":
+            return (spec + "s") % ("0x%08x" % value)
+        return (spec + conv) % value
+
+    return SPEC.sub(convert, fmt)
+
+
+class Decoder:
+    """Splits the console stream into text and frames."""
+
+    def __init__(self, elf, out, timestamps=False, cpu_hz=216000000):
+        self.elf = elf
+        self.out = out
+        self.timestamps = timestamps
+        self.cpu_hz = cpu_hz
+        self.pending = bytearray()
+        self.seq = None
+        self.frames = 0
+        self.lost = 0
+        self.line_start = True
+
+    def write(self, text):
+        if text:
+            text = text.replace("\r\n", "\n")
+            self.out.write(text)
+            self.line_start = text.endswith("\n")
+
+    def frame_at(self, pos):
+        """Length of a valid frame at pos; 0 if there is none; None if
+        there might be one but not all of it has arrived yet."""
+        buf = self.pending
+        if len(buf) - pos < 2:
+            return None
+        nargs = buf[pos + 1]
+        if nargs > MAX_ARGS:
+            return 0
+        flen = HDR_SZ + 4 * nargs
+        if len(buf) - pos < flen:
+            # Could be a frame, unless the format address is already wrong
+            if len(buf) - pos >= 8 and not self.elf.is_format(struct.unpack_from("<I", buf, pos + 4)[0]):
+                return 0
+            return None
+        if sum(buf[pos:pos + flen]) & 0xFF != 0:
+            return 0
+        if not self.elf.is_format(struct.unpack_from("<I", buf, pos + 4)[0]):
+            return 0
+        return flen
+
+    def message(self, frame):
+        nargs, seq = frame[1], frame[2]
+        fmt_addr, cycles = struct.unpack_from("<II", frame, 4)
+        args = struct.unpack_from("<%dI" % nargs, frame, HDR_SZ)
+
+        if self.seq is not None and seq != (self.seq + 1) & 0xFF:
+            lost = (seq - self.seq - 1) & 0xFF
+            self.lost += lost
+            self.write("\n[%d log messages lost]\n" % lost)
+        self.seq = seq
+        self.frames += 1
+
+        text = format_message(self.elf, self.elf.string(fmt_addr), args)
+        # Stamp the start of each line; some messages are only part of one
+        if self.timestamps:
+            stamp = "[%10.6f] " % (cycles / self.cpu_hz)
+            text = text.replace("\r\n", "\n")
+            if self.line_start:
+                text = stamp + text.lstrip("\n")
+            elif text.startswith("\n"):
+                text = "\n" + stamp + text.lstrip("\n")
+        self.write(text)
+
+    def feed(self, data, final=False):
+        self.pending += data
+        buf = self.pending
+        pos = 0
+        text_start = 0
+        while pos < len(buf):
+            if buf[pos] != SYNC:
+                pos += 1
+                continue
+            flen = self.frame_at(pos)
+            if flen is None and not final:
+                break
+            if not flen:
+                pos += 1
+                continue
+            self.write(buf[text_start:pos].decode("latin-1"))
+            self.message(bytes(buf[pos:pos + flen]))
+            pos += flen
+            text_start = pos
+        # Hold back a CR, in case its LF is in the next read
+        if not final and pos > text_start and buf[pos - 1] == ord("\r"):
+            pos -= 1
+        self.write(buf[text_start:pos].decode("latin-1"))
+        del buf[:pos]
+        self.out.flush()
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Format binary DLOG() frames from the serial console")
+    ap.add_argument("elf", help="the firmware ELF file that is running")
+    ap.add_argument("input", nargs="?", help="file containing a raw console capture")
+    ap.add_argument("-p", "--port", help="read from this serial port (until ^C)")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    ap.add_argument("-t", "--timestamps", action="store_true",
+                    help="show when each message was logged, in seconds")
+    ap.add_argument("--cpu-hz", type=int, default=216000000,
+                    help="DWT cycle counter frequency")
+    args = ap.parse_args()
+
+    decoder = Decoder(Elf(args.elf), sys.stdout, args.timestamps, args.cpu_hz)
+
+    if args.port:
+        import serial  # pyserial
+
+        with serial.Serial(args.port, args.baud, timeout=0.1) as ser:
+            # Switch the device to binary logging
+            ser.write(b"l")
+            try:
+                while True:
+                    decoder.feed(ser.read(4096))
+            except KeyboardInterrupt:
+                pass
+    elif args.input:
+        with open(args.input, "rb") as f:
+            decoder.feed(f.read(), final=True)
+    else:
+        ap.error("specify an input file or --port")
+
+    decoder.feed(b"", final=True)
+    print("\n%d log messages, %d lost" % (decoder.frames, decoder.lost), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+#
+# mid2c.py
+#
+#  Created on: 2025-04-02
+#  Updated on: 2025-04-02
+#      Author: Douglas P. Fields, Jr.
+#   Copyright: 2025, Douglas P. Fields, Jr.
+#     License: Apache 2.0
+#
+# Converts a Standard MIDI File into a C source file holding it as a
+# const array, which the linker puts in flash, for the SMF player
+# (Core/Src/smf.c) to play in place.
+#
+# With --demo, writes the built-in demo song (a type 1 file with a
+# tempo change, melody, bass and chords) instead of reading a file.
+#
+# Usage:
+#   mid2c.py song.mid -n smf_song -o Core/Src/smfsong.c
+#   mid2c.py --demo -n smf_demo -o Core/Src/smfdemo.c
+
+import argparse
+import struct
+import sys
+
+
+def vlq(n):
+    out = [n & 0x7F]
+    n >>= 7
+    while n:
+        out.insert(0, 0x80 | (n & 0x7F))
+        n >>= 7
+    return bytes(out)
+
+
+def track(events):
+    """events: list of (abs_tick, bytes); returns an MTrk chunk with
+    running status used wherever possible."""
+    data = bytearray()
+    last_tick = 0
+    running = None
+    for tick, ev in sorted(events, key=lambda e: e[0]):
+        data += vlq(tick - last_tick)
+        last_tick = tick
+        status = ev[0]
+        if status < 0xF0 and status == running:
+            data += ev[1:]
+        else:
+            data += ev
+            running = status if status < 0xF0 else None
+    data += vlq(0) + b"\xFF\x2F\x00"
+    return b"MTrk" + struct.pack(">I", len(data)) + data
+
+
+def demo_song():
+    ppq = 96
+    bar = ppq * 4
+    tempo = lambda bpm: b"\xFF\x51\x03" + struct.pack(">I", 60000000 // bpm)[1:]
+    conductor = [(0, tempo(120)), (0, b"\xFF\x58\x04\x04\x02\x18\x08"),
+                 (8 * bar, tempo(140)), (12 * bar, tempo(100))]
+
+    def note(events, ch, tick, n, vel, length):
+        events.append((tick, bytes([0x90 | ch, n, vel])))
+        # Note On velocity 0 as the off, so running status carries
+        events.append((tick + length, bytes([0x90 | ch, n, 0])))
+
+    # I - vi - IV - V in C, four bars each time round
+    roots = [48, 45, 41, 43]
+    chords = [[60, 64, 67], [57, 60, 64], [53, 57, 60], [55, 59, 62]]
+    melody, bass, pads = [], [], []
+    for b in range(16):
+        i = b % 4
+        t = b * bar
+        for step in range(8):
+            n = chords[i][step % 3] + (12 if step >= 4 else 0)
+            note(melody, 0, t + step * ppq // 2, n, 90 - step * 4, ppq // 2 - 8)
+        note(bass, 1, t, roots[i], 100, ppq * 2 - 8)
+        note(bass, 1, t + ppq * 2, roots[i] + 7, 90, ppq * 2 - 8)
+        for n in chords[i]:
+            note(pads, 2, t, n - 12, 50, bar - 16)
+        pads.append((t + ppq, bytes([0xB2, 1, (b * 8) & 0x7F])))
+
+    tracks = [conductor, melody, bass, pads]
+    header = b"MThd" + struct.pack(">IHHH", 6, 1, len(tracks), ppq)
+    return header + b"".join(track(t) for t in tracks)
+
+
+def to_c(data, name, source):
+    lines = ["/*",
+             " * Generated by Tools/mid2c.py from %s - do not edit." % source,
+             " */",
+             "",
+             "#include <stdint.h>",
+             "#include <stddef.h>",
+             "",
+             "const uint8_t %s[] = {" % name]
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02X" % b for b in data[i:i + 16]) + ",")
+    lines += ["};", "", "const size_t %s_len = sizeof(%s);" % (name, name), ""]
+    return "\n".join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Convert a Standard MIDI File to a C const array")
+    ap.add_argument("input", nargs="?", help="the .mid file")
+    ap.add_argument("--demo", action="store_true", help="write the built-in demo song")
+    ap.add_argument("-n", "--name", default="smf_song", help="C array name")
+    ap.add_argument("-o", "--output", default="-", help="C output file")
+    args = ap.parse_args()
+
+    if args.demo:
+        data, source = demo_song(), "the built-in demo song"
+    elif args.input:
+        with open(args.input, "rb") as f:
+            data = f.read()
+        source = args.input.split("/")[-1]
+    else:
+        ap.error("specify an input file or --demo")
+
+    if data[:4] != b"MThd":
+        sys.exit("Not a Standard MIDI File")
+
+    out = to_c(data, args.name, source)
+    if args.output == "-":
+        sys.stdout.write(out)
+    else:
+        with open(args.output, "w") as f:
+            f.write(out)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,309 @@
+/*
+ * midifuzz.c
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Fuzz target for the MIDI parser (Core/Src/midi.c) and encoder
+ * (Core/Src/midiout.c), on a host.
+ *
+ * Each input is a stream of MIDI bytes, and goes through the parser
+ * cross-checks in Core/Src/midicheck.c, which the on-device benchmark
+ * runs too: the byte parser against the reference decoder (midiref.c),
+ * and the bulk parser against the byte parser, in spans and with
+ * message array sizes from a PRNG seeded by the input's hash. That
+ * PRNG then also drives a round of the MIDI output encoder round trip
+ * (midiout.c, encoded, drained and parsed again).
+ * Any difference aborts, which is what libFuzzer and AFL look for.
+ *
+ * Built with -fsanitize=fuzzer this is a libFuzzer target. With
+ * MIDIFUZZ_MAIN it has a main() instead, which runs the files it is
+ * given (AFL's @@, or replaying the corpus or a crash), and can also:
+ *   -n N   run N random mutations of them, for hosts with no fuzzer
+ *          (no coverage guidance); a failing input is saved to
+ *          midifuzz-crash.bin
+ *   -b     benchmark both parsers over them: bytes/s and messages/s
+ *
+ * See the Makefile for the builds.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "midi.h"
+#include "midicheck.h"
+
+#define FNV_OFFSET_BASIS 0x811C9DC5
+#define FNV_PRIME        0x01000193
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#ifdef MIDIFUZZ_MAIN
+// The input being run, saved if it fails
+static const uint8_t *current;
+static size_t current_len;
+#endif
+
+// For failures that aren't at a byte of the input
+#define NO_OFFSET SIZE_MAX
+
+static void fail(const char *what, size_t offset) {
+  if (offset == NO_OFFSET) {
+    fprintf(stderr, "midifuzz: %s\n", what);
+  } else {
+    fprintf(stderr, "midifuzz: %s at byte %zu\n", what, offset);
+  }
+#ifdef MIDIFUZZ_MAIN
+  FILE *f = fopen("midifuzz-crash.bin", "wb");
+
+  if (f != NULL) {
+    fwrite(current, 1, current_len, f);
+    fclose(f);
+    fprintf(stderr, "midifuzz: input saved to midifuzz-crash.bin\n");
+  }
+#endif
+  abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  midicheck_t mc;
+  uint32_t state = FNV_OFFSET_BASIS;
+
+  // Spans depend on the input, so the fuzzer can steer them
+  for (size_t i = 0; i < size; i++) {
+    state = (state ^ data[i]) * FNV_PRIME;
+  }
+  state |= 1;
+
+  midicheck_init(&mc);
+  midicheck_reference(&mc, data, size);
+  midicheck_bulk(&mc, data, size, &state);
+  midicheck_finish(&mc);
+  midicheck_encoder(&mc, &state);
+
+  if (mc.mismatches > 0) {
+    fail("byte parser differs from the reference", mc.first_mismatch);
+  }
+  if (mc.sysex_mismatch) {
+    fail("byte parser's SysEx differs from the reference", size);
+  }
+  if (mc.bulk_mismatches > 0) {
+    fail("bulk and byte parsers differ", mc.first_bulk_mismatch);
+  }
+  if (mc.encode_mismatches > 0) {
+    fail("encoder round trip differs", NO_OFFSET);
+  }
+  return 0;
+}
+
+#ifdef MIDIFUZZ_MAIN
+
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+// Largest mutated input, and the benchmark's stream
+#define MUTATE_MAX 4096
+#define BENCH_SZ 65536
+#define BENCH_SECONDS 0.5
+
+typedef struct input {
+  uint8_t *data;
+  size_t len;
+} input_t;
+
+static void run(const uint8_t *data, size_t len) {
+  current = data;
+  current_len = len;
+  LLVMFuzzerTestOneInput(data, len);
+}
+
+static int read_file(const char *path, input_t *in) {
+  FILE *f = fopen(path, "rb");
+  size_t cap = 4096;
+
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  in->data = malloc(cap);
+  in->len = 0;
+  while (in->data != NULL) {
+    in->len += fread(in->data + in->len, 1, cap - in->len, f);
+    if (in->len < cap) {
+      break;
+    }
+    cap *= 2;
+    in->data = realloc(in->data, cap);
+  }
+  fclose(f);
+  return in->data != NULL ? 0 : -1;
+}
+
+/** Random edits of an input, biased to MIDI: status bytes of every
+ * kind, data bytes, deletions, repeats and splices of another input.
+ */
+static size_t mutate(uint32_t *state, const input_t *inputs, int count, uint8_t *out) {
+  const input_t *in = &inputs[midicheck_random(state) % count];
+  size_t len = in->len < MUTATE_MAX ? in->len : MUTATE_MAX;
+  uint32_t edits = 1 + midicheck_random(state) % 8;
+
+  memcpy(out, in->data, len);
+  while (edits-- > 0) {
+    uint32_t r = midicheck_random(state);
+    size_t at = len > 0 ? midicheck_random(state) % len : 0;
+    size_t n;
+
+    switch (r % 6) {
+    case 0: // Replace a byte with a status byte
+      if (len > 0) {
+        out[at] = 0x80 | ((r >> 8) & 0x7F);
+      }
+      break;
+    case 1: // Replace a byte with a data byte
+      if (len > 0) {
+        out[at] = (r >> 8) & 0x7F;
+      }
+      break;
+    case 2: // Insert a byte
+      if (len < MUTATE_MAX) {
+        memmove(out + at + 1, out + at, len - at);
+        out[at] = r >> 8;
+        len++;
+      }
+      break;
+    case 3: // Delete a run
+      n = (r >> 8) % 16;
+      n = n > len - at ? len - at : n;
+      memmove(out + at, out + at + n, len - at - n);
+      len -= n;
+      break;
+    case 4: // Repeat a run
+      n = 1 + (r >> 8) % 16;
+      n = n > len - at ? len - at : n;
+      if (len + n <= MUTATE_MAX) {
+        memmove(out + at + n, out + at, len - at);
+        len += n;
+      }
+      break;
+    default: // Splice in part of another input
+      in = &inputs[(r >> 8) % count];
+      if (in->len > 0) {
+        size_t from = midicheck_random(state) % in->len;
+        n = 1 + midicheck_random(state) % (in->len - from);
+        n = n > MUTATE_MAX - at ? MUTATE_MAX - at : n;
+        memcpy(out + at, in->data + from, n);
+        len = at + n > len ? at + n : len;
+      }
+      break;
+    }
+  }
+  return len;
+}
+
+static double seconds_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** Parses the inputs, repeated to BENCH_SZ, over and over for a while:
+ * a byte at a time, and in spans of MIDICHECK_SPAN_SZ into 16 messages.
+ */
+static void bench(const input_t *inputs, int count) {
+  uint8_t *stream = malloc(BENCH_SZ);
+  midi_stream ms;
+  midi_message mm, msgs[16];
+  size_t pos = 0, used, span;
+  uint64_t bytes, messages;
+  double start, took;
+
+  for (int i = 0; pos < BENCH_SZ; i = (i + 1) % count) {
+    size_t n = inputs[i].len < BENCH_SZ - pos ? inputs[i].len : BENCH_SZ - pos;
+    memcpy(stream + pos, inputs[i].data, n);
+    pos += n;
+  }
+
+  midi_stream_init(&ms);
+  bytes = messages = 0;
+  start = seconds_now();
+  do {
+    for (size_t i = 0; i < BENCH_SZ; i++) {
+      messages += midi_stream_receive(&ms, stream[i], &mm);
+    }
+    bytes += BENCH_SZ;
+  } while ((took = seconds_now() - start) < BENCH_SECONDS);
+  printf("byte: %.1f MB/s, %.2f M msgs/s\n", bytes / took / 1e6, messages / took / 1e6);
+
+  midi_stream_init(&ms);
+  bytes = messages = 0;
+  start = seconds_now();
+  do {
+    for (size_t i = 0; i < BENCH_SZ; i += used) {
+      span = BENCH_SZ - i < MIDICHECK_SPAN_SZ ? BENCH_SZ - i : MIDICHECK_SPAN_SZ;
+      messages += midi_stream_receive_buf(&ms, &stream[i], span, msgs, 16, &used);
+    }
+    bytes += BENCH_SZ;
+  } while ((took = seconds_now() - start) < BENCH_SECONDS);
+  printf("bulk: %.1f MB/s, %.2f M msgs/s\n", bytes / took / 1e6, messages / took / 1e6);
+  free(stream);
+}
+
+int main(int argc, char **argv) {
+  unsigned long iterations = 0;
+  uint32_t state = 1;
+  int do_bench = 0, c, count;
+  input_t *inputs;
+  uint8_t *buf;
+
+  while ((c = getopt(argc, argv, "n:s:b")) != -1) {
+    switch (c) {
+    case 'n': iterations = strtoul(optarg, NULL, 0); break;
+    case 's': state = strtoul(optarg, NULL, 0) | 1; break;
+    case 'b': do_bench = 1; break;
+    default:
+      fprintf(stderr, "Usage: %s [-n mutations] [-s seed] [-b] file...\n", argv[0]);
+      return 2;
+    }
+  }
+  count = argc - optind;
+  if (count <= 0) {
+    fprintf(stderr, "Usage: %s [-n mutations] [-s seed] [-b] file...\n", argv[0]);
+    return 2;
+  }
+
+  inputs = calloc(count, sizeof(*inputs));
+  for (int i = 0; i < count; i++) {
+    if (read_file(argv[optind + i], &inputs[i]) != 0) {
+      return 1;
+    }
+    run(inputs[i].data, inputs[i].len);
+  }
+  printf("%d inputs ok\n", count);
+
+  if (iterations > 0) {
+    buf = malloc(MUTATE_MAX);
+    for (unsigned long i = 0; i < iterations; i++) {
+      run(buf, mutate(&state, inputs, count, buf));
+    }
+    printf("%lu mutations ok\n", iterations);
+    free(buf);
+  }
+
+  if (do_bench) {
+    bench(inputs, count);
+  }
+
+  for (int i = 0; i < count; i++) {
+    free(inputs[i].data);
+  }
+  free(inputs);
+  return 0;
+}
+
+#endif // MIDIFUZZ_MAIN
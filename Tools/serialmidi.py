@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+#
+# serialmidi.py
+#
+#  Created on: 2025-04-09
+#  Updated on: 2025-04-10
+#      Author: Douglas P. Fields, Jr.
+#   Copyright: 2025, Douglas P. Fields, Jr.
+#     License: Apache 2.0
+#
+# Blasts MIDI at the board over the serial console in serial MIDI mode
+# (console option "M", ended by FD FD FD; see check_midi_input() in
+# Core/Src/realmain.c), to stress the parser, the synth queue and the
+# voice allocator at several times the DIN rate of 3,125 bytes/s.
+#
+# The stream is random but repeatable (--seed): notes held and released
+# with running status, more of them at once than the synth has voices,
+# and with --mixed, controllers, pitch bend, program changes, pressure,
+# short SysEx and timing clocks dropped in between any two bytes.
+#
+# The same voice allocation is worked out here as the synth does it, so
+# the "Voices:" line the board shows when the session ends can be
+# checked against the one printed here (as long as the synth queue
+# dropped nothing).
+#
+# Where it goes:
+#   --port    the board, with pyserial: starts serial MIDI, sends, ends
+#             it and shows what the board reports
+#   --pty     a pseudo-terminal standing in for the board, for any
+#             program that reads a serial port (e.g., a bridge); its
+#             name is printed, and writes wait for the reader
+#   -o FILE   a file, of --bytes (64 KiB if not given)
+#
+# Usage:
+#   serialmidi.py --port /dev/ttyACM0 --seconds 10 --mixed
+#   serialmidi.py --port /dev/ttyACM0 --rate 2 --held 6
+#   serialmidi.py --pty --rate 0
+
+import argparse
+import os
+import random
+import sys
+import time
+
+DIN_RATE = 3125       # Bytes/s at 31,250 baud
+POLYPHONY = 8         # Keep in sync with SYNTH_POLYPHONY in Core/Inc/synth.h
+ESCAPE = b"\xFD\xFD\xFD"
+START = b"M"
+
+
+class Voices:
+    """The synth's voice allocation (synth_process_midi()): no
+    stealing, and a note on for a note playing restarts it."""
+
+    def __init__(self):
+        self.playing = set()
+        self.note_ons = self.note_offs = self.retriggers = self.no_voice = self.stray_offs = 0
+
+    def note_on(self, note):
+        self.note_ons += 1
+        if note in self.playing:
+            self.retriggers += 1
+        elif len(self.playing) < POLYPHONY:
+            self.playing.add(note)
+        else:
+            self.no_voice += 1
+
+    def note_off(self, note):
+        self.note_offs += 1
+        if note in self.playing:
+            self.playing.remove(note)
+        else:
+            self.stray_offs += 1
+
+    def __str__(self):
+        return "Voices: %d on, %d off, %d retriggered, %d no voice, %d stray off" % (
+            self.note_ons, self.note_offs, self.retriggers, self.no_voice, self.stray_offs)
+
+
+class Generator:
+    """Random MIDI, a message at a time."""
+
+    def __init__(self, seed, held, mixed, channels):
+        self.rng = random.Random(seed)
+        self.held = held
+        self.mixed = mixed
+        self.channels = channels
+        self.notes = []
+        self.status = None
+        self.voices = Voices()
+        self.messages = 0
+        self.clocks = 0
+
+    def channel_message(self, status, data):
+        # Running status, as every sender does
+        out = bytes(data) if status == self.status else bytes([status]) + bytes(data)
+        self.status = status
+        return out
+
+    def message(self):
+        rng = self.rng
+        ch = rng.randrange(self.channels)
+        self.messages += 1
+
+        if self.mixed:
+            kind = rng.random()
+            if kind < 0.10:
+                return self.channel_message(0xB0 | ch, [rng.randrange(120), rng.randrange(128)])
+            if kind < 0.15:
+                return self.channel_message(0xE0 | ch, [rng.randrange(128), rng.randrange(128)])
+            if kind < 0.17:
+                return self.channel_message(0xC0 | ch, [rng.randrange(128)])
+            if kind < 0.20:
+                return self.channel_message(0xD0 | ch, [rng.randrange(128)])
+            if kind < 0.21:
+                # SysEx ends running status
+                self.status = None
+                return bytes([0xF0, 0x7D] + [rng.randrange(128) for _ in range(rng.randrange(1, 24))] + [0xF7])
+
+        if not self.notes or (len(self.notes) < self.held and rng.random() < 0.6):
+            note = rng.randrange(36, 96)
+            self.notes.append(note)
+            self.voices.note_on(note)
+            return self.channel_message(0x90 | ch, [note, rng.randrange(1, 128)])
+        note = self.notes.pop(rng.randrange(len(self.notes)))
+        self.voices.note_off(note)
+        # Half as note on with velocity 0, which keeps running status
+        if rng.random() < 0.5:
+            return self.channel_message(0x90 | ch, [note, 0])
+        return self.channel_message(0x80 | ch, [note, rng.randrange(128)])
+
+    def chunk(self, size):
+        """At least size bytes of whole messages (real-time bytes may
+        be in the middle of them)."""
+        out = bytearray()
+        while len(out) < size:
+            msg = self.message()
+            if self.mixed and self.rng.random() < 0.1:
+                pos = self.rng.randrange(len(msg) + 1)
+                msg = msg[:pos] + b"\xF8" + msg[pos:]
+                self.clocks += 1
+            out += msg
+        return bytes(out)
+
+    def finish(self):
+        """Note offs for everything still held."""
+        out = bytearray()
+        while self.notes:
+            note = self.notes.pop()
+            self.voices.note_off(note)
+            self.messages += 1
+            out += self.channel_message(0x80, [note, 64])
+        return bytes(out)
+
+
+def blast(write, gen, rate, seconds, total_bytes, chunk):
+    """Writes the stream, paced to rate bytes/s (0 for as fast as it
+    goes), for seconds or total_bytes. Returns (bytes, seconds)."""
+    sent = 0
+    start = time.monotonic()
+    while True:
+        elapsed = time.monotonic() - start
+        if (seconds and elapsed >= seconds) or (total_bytes and sent >= total_bytes):
+            break
+        if rate:
+            ahead = sent / rate - elapsed
+            if ahead > 0:
+                time.sleep(ahead)
+        data = gen.chunk(chunk)
+        write(data)
+        sent += len(data)
+    data = gen.finish()
+    write(data)
+    sent += len(data)
+    return sent, time.monotonic() - start
+
+
+def read_for(ser, seconds):
+    """What the board sends in the next seconds."""
+    out = bytearray()
+    end = time.monotonic() + seconds
+    while time.monotonic() < end:
+        out += ser.read(4096)
+    return out.decode("latin-1")
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Stress the board with MIDI over the serial console")
+    ap.add_argument("-p", "--port", help="the board's serial console")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    ap.add_argument("--pty", action="store_true", help="write to a new pseudo-terminal")
+    ap.add_argument("-o", "--output", help="write to a file")
+    ap.add_argument("--rate", type=float, default=0,
+                    help="bytes/s as a multiple of the DIN rate (0: as fast as it goes)")
+    ap.add_argument("--seconds", type=float, default=5.0)
+    ap.add_argument("--bytes", type=int, default=0, help="stop after this many bytes instead")
+    ap.add_argument("--held", type=int, default=POLYPHONY + 4,
+                    help="notes to keep held at once (more than %d runs out of voices)" % POLYPHONY)
+    ap.add_argument("--channels", type=int, default=1)
+    ap.add_argument("--mixed", action="store_true",
+                    help="add controllers, pitch bend, SysEx and clocks")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--chunk", type=int, default=64, help="bytes per write")
+    args = ap.parse_args()
+
+    gen = Generator(args.seed, args.held, args.mixed, args.channels)
+    rate = args.rate * DIN_RATE
+    seconds = 0 if args.bytes else args.seconds
+
+    if args.port:
+        import serial  # pyserial
+
+        with serial.Serial(args.port, args.baud, timeout=0.05) as ser:
+            ser.write(START)
+            sys.stderr.write(read_for(ser, 0.2))
+            sent, took = blast(ser.write, gen, rate, seconds, args.bytes, args.chunk)
+            ser.write(ESCAPE)
+            ser.flush()
+            # The board's own account of the session
+            sys.stderr.write(read_for(ser, 1.0).replace("\r\n", "\n"))
+    elif args.pty:
+        import tty
+
+        master, slave = os.openpty()
+        tty.setraw(slave)
+        print("Writing to %s" % os.ttyname(slave), file=sys.stderr)
+        sent, took = blast(lambda data: os.write(master, data), gen, rate, seconds,
+                           args.bytes, args.chunk)
+        os.write(master, ESCAPE)
+        # Let the reader finish
+        input("Enter to close: ")
+        os.close(master)
+        os.close(slave)
+    elif args.output:
+        with open(args.output, "wb") as f:
+            sent, took = blast(f.write, gen, 0, 0, args.bytes or 65536, args.chunk)
+            f.write(ESCAPE)
+    else:
+        ap.error("specify --port, --pty or --output")
+
+    print("\nSent %d B, %d msgs (%d clocks) in %.2f s: %.0f B/s (%.1fx DIN)" % (
+        sent, gen.messages, gen.clocks, took, sent / took if took else 0,
+        sent / took / DIN_RATE if took else 0), file=sys.stderr)
+    print("Expected " + str(gen.voices), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
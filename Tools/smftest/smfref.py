@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+#
+# smfref.py
+#
+#  Created on: 2025-04-12
+#  Updated on: 2025-04-12
+#      Author: Douglas P. Fields, Jr.
+#   Copyright: 2025, Douglas P. Fields, Jr.
+#     License: Apache 2.0
+#
+# Independent decode of a Standard MIDI File, to check the SMF player
+# (Core/Src/smf.c) against: reads every track, merges them by tick
+# (ties to the lower track), follows the tempo map, and compares each
+# MIDI event, its tick and its sample with what `smftest -e` printed.
+#
+# The file is a .mid, or a C file written by Tools/mid2c.py (such as
+# Core/Src/smfdemo.c, the demo song the console plays).
+#
+# Usage:
+#   ./smftest -e | smfref.py ../../Core/Src/smfdemo.c
+
+import re
+import struct
+import sys
+
+SAMPLE_RATE = 32000
+DEFAULT_TEMPO = 500000
+DATA_BYTES = {0x80: 2, 0x90: 2, 0xA0: 2, 0xB0: 2, 0xC0: 1, 0xD0: 1, 0xE0: 2}
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if path.endswith(".c"):
+        body = data.decode().split("{", 1)[1].split("}", 1)[0]
+        data = bytes(int(h, 16) for h in re.findall(r"0x([0-9A-Fa-f]{2})", body))
+    return data
+
+
+def vlq(data, i):
+    v = 0
+    while True:
+        b = data[i]
+        i += 1
+        v = (v << 7) | (b & 0x7F)
+        if not b & 0x80:
+            return v, i
+
+
+def track_events(data):
+    """(tick, kind, value) for each event: kind "midi" with the message
+    bytes, or "tempo" with microseconds per quarter note."""
+    out = []
+    i, tick, running = 0, 0, None
+    while i < len(data):
+        delta, i = vlq(data, i)
+        tick += delta
+        status = data[i]
+        if status & 0x80:
+            i += 1
+        else:
+            status = running
+        if status == 0xFF:
+            kind, i = data[i], i + 1
+            n, i = vlq(data, i)
+            if kind == 0x51 and n == 3:
+                out.append((tick, "tempo", int.from_bytes(data[i:i + 3], "big")))
+            i += n
+            running = None
+            if kind == 0x2F:
+                break
+        elif status in (0xF0, 0xF7):
+            n, i = vlq(data, i)
+            i += n
+            running = None
+        else:
+            n = DATA_BYTES[status & 0xF0]
+            msg = bytes([status]) + data[i:i + n] + bytes(2 - n)
+            i += n
+            running = status
+            if status & 0xF0 == 0x90 and msg[2] == 0:
+                msg = bytes([0x80 | (status & 0x0F)]) + msg[1:]
+            out.append((tick, "midi", msg))
+    return out
+
+
+def decode(data):
+    magic, hlen, fmt, ntracks, division = struct.unpack(">4sIHHH", data[:14])
+    assert magic == b"MThd" and fmt <= 1 and not division & 0x8000
+    pos = 8 + hlen
+    merged = []
+    for track in range(ntracks):
+        magic, n = struct.unpack(">4sI", data[pos:pos + 8])
+        if magic == b"MTrk":
+            for order, (tick, kind, value) in enumerate(track_events(data[pos + 8:pos + 8 + n])):
+                merged.append((tick, track, order, kind, value))
+        pos += 8 + n
+    merged.sort()
+
+    # Each tempo change starts a segment; samples count from its start
+    tempo, seg_tick, seg_sample = DEFAULT_TEMPO, 0, 0
+    events = []
+    for tick, _, _, kind, value in merged:
+        sample = seg_sample + (tick - seg_tick) * tempo // division * SAMPLE_RATE // 1000000
+        if kind == "tempo":
+            tempo, seg_tick, seg_sample = max(value, 1), tick, sample
+        else:
+            events.append("%d %d %02X %d %d" % (sample, tick, value[0], value[1], value[2]))
+    return events
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("Usage: smftest -e | smfref.py song.mid|song.c")
+    expected = decode(load(sys.argv[1]))
+    got = [line.strip() for line in sys.stdin if line.strip()]
+    for n, (e, g) in enumerate(zip(expected, got)):
+        if e != g:
+            sys.exit("Event %d differs: smf.c has '%s', expected '%s'" % (n, g, e))
+    if len(got) != len(expected):
+        sys.exit("smf.c has %d events, expected %d" % (len(got), len(expected)))
+    print("%d events match (sample, tick, message)" % len(expected))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,226 @@
+/*
+ * smftest.c
+ *
+ *  Created on: 2025-04-12
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Host tests of the Standard MIDI File player (Core/Src/smf.c), on
+ * the demo song the console plays (Core/Src/smfdemo.c), or on a .mid
+ * file given on the command line:
+ *   (default) open and read every event, in order, with no errors;
+ *             then read every truncation of the file, and -n random
+ *             corruptions of it (default 20000), each from a buffer
+ *             of exactly its size, so ASan sees any read past the end
+ *   -e        print every event, for smfref.py to check against its
+ *             own decode
+ *   -b        play the whole song through the synth, in audio blocks,
+ *             and report how much faster than real time it renders
+ *   -s seed   PRNG seed for the corruptions
+ *
+ * See the Makefile for the builds.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "midi.h"
+#include "synth.h"
+#include "smf.h"
+
+#define SAMPLE_RATE 32000
+// Samples per smf_play_block(), as on the device: half the I2S buffer
+#define BLOCK_SZ 128
+#define CORRUPTIONS 20000
+#define BENCH_SECONDS 0.5
+
+extern const uint8_t smf_demo[];
+extern const size_t smf_demo_len;
+
+static uint32_t prng(uint32_t *state) {
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static double seconds_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_file(const char *path, uint8_t **data, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  long sz;
+
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  fseek(f, 0, SEEK_END);
+  sz = ftell(f);
+  rewind(f);
+  *data = malloc(sz > 0 ? sz : 1);
+  *len = fread(*data, 1, sz, f);
+  fclose(f);
+  return 0;
+}
+
+/** Reads all the events of an image, copied into a buffer of exactly
+ * its size. Returns how many, or -1 if it won't open.
+ */
+static long read_all(const uint8_t *image, size_t len, smf_player_t *p) {
+  uint8_t *copy = malloc(len > 0 ? len : 1);
+  smf_event_t ev;
+  long events = 0;
+
+  memcpy(copy, image, len);
+  if (smf_open(p, copy, len, SAMPLE_RATE) != 0) {
+    free(copy);
+    return -1;
+  }
+  while (smf_next_event(p, &ev)) {
+    events++;
+  }
+  free(copy);
+  return events;
+}
+
+static void print_events(const uint8_t *image, size_t len) {
+  smf_player_t p;
+  smf_event_t ev;
+
+  if (smf_open(&p, image, len, SAMPLE_RATE) != 0) {
+    fprintf(stderr, "smftest: not a file we can play\n");
+    exit(1);
+  }
+  while (smf_next_event(&p, &ev)) {
+    printf("%llu %u %02X %u %u\n", (unsigned long long)ev.sample, (unsigned)ev.tick,
+           ev.msg.type, ev.msg.data1, ev.msg.data2);
+  }
+}
+
+static int check(const uint8_t *image, size_t len, uint32_t state, unsigned long corruptions) {
+  static smf_player_t p;
+  smf_event_t ev;
+  uint64_t last = 0;
+  long events, most = 0, opened = 0;
+  uint8_t *buf;
+
+  // The whole file
+  if (smf_open(&p, image, len, SAMPLE_RATE) != 0) {
+    fprintf(stderr, "smftest: not a file we can play\n");
+    return 1;
+  }
+  while (smf_next_event(&p, &ev)) {
+    if (ev.sample < last) {
+      fprintf(stderr, "smftest: event %u goes back in time\n", (unsigned)p.events);
+      return 1;
+    }
+    last = ev.sample;
+  }
+  printf("%u tracks, %u events, %u tempo changes, %u errors, %.1f s\n",
+         p.num_tracks, (unsigned)p.events, (unsigned)p.tempo_changes, (unsigned)p.errors,
+         (double)last / SAMPLE_RATE);
+  if (p.errors > 0) {
+    return 1;
+  }
+  events = p.events;
+
+  // Every truncation: never more events than the whole file
+  for (size_t n = 0; n < len; n++) {
+    long got = read_all(image, n, &p);
+    if (got > events) {
+      fprintf(stderr, "smftest: %zu bytes give %ld events, more than all %ld\n", n, got, events);
+      return 1;
+    }
+  }
+  printf("%zu truncations ok\n", len);
+
+  // Random corruptions: 1 to 8 bytes changed
+  buf = malloc(len);
+  for (unsigned long i = 0; i < corruptions; i++) {
+    uint32_t edits = 1 + prng(&state) % 8;
+    long got;
+
+    memcpy(buf, image, len);
+    while (edits-- > 0) {
+      uint32_t r = prng(&state);
+      buf[r % len] = prng(&state);
+    }
+    got = read_all(buf, len, &p);
+    if (got >= 0) {
+      opened++;
+      most = got > most ? got : most;
+    }
+  }
+  free(buf);
+  printf("%lu corruptions ok (%ld opened, up to %ld events)\n", corruptions, opened, most);
+  return 0;
+}
+
+static void bench(const uint8_t *image, size_t len) {
+  static smf_player_t p;
+  int16_t block[BLOCK_SZ];
+  uint64_t samples = 0;
+  double start, took;
+
+  start = seconds_now();
+  do {
+    synth_init(SAMPLE_RATE);
+    smf_open(&p, image, len, SAMPLE_RATE);
+    while (smf_play_block(&p, block, BLOCK_SZ)) {
+      // Keep going to the end
+    }
+    samples += p.sample_now;
+  } while ((took = seconds_now() - start) < BENCH_SECONDS);
+  printf("%.1f s of audio in %.3f s: %.0fx real time\n",
+         (double)samples / SAMPLE_RATE, took, (double)samples / SAMPLE_RATE / took);
+}
+
+int main(int argc, char **argv) {
+  const uint8_t *image = smf_demo;
+  size_t len = smf_demo_len;
+  unsigned long corruptions = CORRUPTIONS;
+  uint32_t state = 1;
+  int events = 0, do_bench = 0, c;
+  uint8_t *file = NULL;
+
+  while ((c = getopt(argc, argv, "ebn:s:")) != -1) {
+    switch (c) {
+    case 'e': events = 1; break;
+    case 'b': do_bench = 1; break;
+    case 'n': corruptions = strtoul(optarg, NULL, 0); break;
+    case 's': state = strtoul(optarg, NULL, 0) | 1; break;
+    default:
+      fprintf(stderr, "Usage: %s [-e | -b] [-n corruptions] [-s seed] [file.mid]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (optind < argc) {
+    if (read_file(argv[optind], &file, &len) != 0) {
+      return 1;
+    }
+    image = file;
+  }
+
+  if (events) {
+    print_events(image, len);
+  } else if (do_bench) {
+    bench(image, len);
+  } else if (check(image, len, state, corruptions) != 0) {
+    return 1;
+  }
+  free(file);
+  return 0;
+}
@@ -0,0 +1,25 @@
+/*
+ * main.h (host stand-in)
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-11
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * The display pins from Core/Inc/main.h, without the LL headers.
+ */
+
+#ifndef SPISIM_MAIN_H_
+#define SPISIM_MAIN_H_
+
+#include "stm32f7xx_hal.h"
+
+#define SPI2_CS_Pin GPIO_PIN_15
+#define SPI2_CS_GPIO_Port GPIOA
+#define SPI2_RESET_Pin GPIO_PIN_5
+#define SPI2_RESET_GPIO_Port GPIOB
+#define SPI2_DC_Pin GPIO_PIN_8
+#define SPI2_DC_GPIO_Port GPIOB
+
+#endif /* SPISIM_MAIN_H_ */
@@ -0,0 +1,72 @@
+/*
+ * stm32f7xx.h (host stand-in)
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Just enough of the CMSIS device header for spidma.c,
+ * spidma_ili9341.c and cyclecount.c to build on the host, for
+ * spisim. The peripherals are plain structures, and the DWT cycle
+ * counter is the simulator's virtual clock. Of the interrupts, only
+ * the SPI DMA's can be masked, which holds its completion back.
+ */
+
+#ifndef SPISIM_STM32F7XX_H_
+#define SPISIM_STM32F7XX_H_
+
+#include <stdint.h>
+
+typedef struct {
+  volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct {
+  volatile uint32_t CR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+  volatile uint32_t CR1;
+} SPI_TypeDef;
+
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CYCCNT;
+  volatile uint32_t LAR;
+} DWT_Type;
+
+typedef struct {
+  volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef enum {
+  DMA1_Stream4_IRQn = 15
+} IRQn_Type;
+
+extern GPIO_TypeDef sim_gpio[3];
+extern DMA_Stream_TypeDef sim_dma_streams[16];
+extern SPI_TypeDef sim_spi2;
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+extern uint32_t SystemCoreClock;
+
+#define GPIOA (&sim_gpio[0])
+#define GPIOB (&sim_gpio[1])
+#define GPIOC (&sim_gpio[2])
+#define DMA1_Stream0 (&sim_dma_streams[0])
+#define DMA1_Stream4 (&sim_dma_streams[4])
+#define DMA2_Stream0 (&sim_dma_streams[8])
+#define SPI2 (&sim_spi2)
+#define DWT (&sim_dwt)
+#define CoreDebug (&sim_core_debug)
+
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk     (1UL << 0)
+
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetEnableIRQ(IRQn_Type IRQn);
+
+#endif /* SPISIM_STM32F7XX_H_ */
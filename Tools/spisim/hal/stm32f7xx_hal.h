@@ -0,0 +1,74 @@
+/*
+ * stm32f7xx_hal.h (host stand-in)
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-11
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * The HAL calls the SPI DMA queue makes, with the same names and
+ * types as the real HAL; spisim.c models what they cost and when the
+ * transfer complete interrupt comes.
+ */
+
+#ifndef SPISIM_STM32F7XX_HAL_H_
+#define SPISIM_STM32F7XX_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "stm32f7xx.h"
+
+typedef enum {
+  HAL_OK      = 0x00U,
+  HAL_ERROR   = 0x01U,
+  HAL_BUSY    = 0x02U,
+  HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+  GPIO_PIN_RESET = 0U,
+  GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0  ((uint16_t)0x0001)
+#define GPIO_PIN_1  ((uint16_t)0x0002)
+#define GPIO_PIN_2  ((uint16_t)0x0004)
+#define GPIO_PIN_3  ((uint16_t)0x0008)
+#define GPIO_PIN_4  ((uint16_t)0x0010)
+#define GPIO_PIN_5  ((uint16_t)0x0020)
+#define GPIO_PIN_6  ((uint16_t)0x0040)
+#define GPIO_PIN_7  ((uint16_t)0x0080)
+#define GPIO_PIN_8  ((uint16_t)0x0100)
+#define GPIO_PIN_9  ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+
+typedef struct {
+  DMA_Stream_TypeDef *Instance;
+} DMA_HandleTypeDef;
+
+typedef struct __SPI_HandleTypeDef {
+  SPI_TypeDef *Instance;
+  DMA_HandleTypeDef *hdmatx;
+  void (*TxCpltCallback)(struct __SPI_HandleTypeDef *hspi);
+} SPI_HandleTypeDef;
+
+typedef enum {
+  HAL_SPI_TX_COMPLETE_CB_ID = 0x00U
+} HAL_SPI_CallbackIDTypeDef;
+
+typedef void (*pSPI_CallbackTypeDef)(SPI_HandleTypeDef *hspi);
+
+HAL_StatusTypeDef HAL_SPI_RegisterCallback(SPI_HandleTypeDef *hspi, HAL_SPI_CallbackIDTypeDef CallbackID,
+                                           pSPI_CallbackTypeDef pCallback);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+uint32_t HAL_GetTick(void);
+
+#endif /* SPISIM_STM32F7XX_HAL_H_ */
@@ -0,0 +1,21 @@
+/*
+ * trace.h (host stand-in)
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-11
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * The event trace uses LDREX/STREX; spisim keeps its own statistics
+ * instead, so TRACE() does nothing here.
+ */
+
+#ifndef SPISIM_TRACE_H_
+#define SPISIM_TRACE_H_
+
+#include "cyclecount.h"
+
+#define TRACE(event, arg8, arg16) ((void)0)
+
+#endif /* SPISIM_TRACE_H_ */
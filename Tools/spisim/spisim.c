@@ -0,0 +1,276 @@
+/*
+ * spisim.c
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Host model of the SPI DMA peripheral, driven by a virtual clock of
+ * CPU cycles, which is also what DWT->CYCCNT reads. So spidma.c's own
+ * bus statistics work here as they do on the board, and can be
+ * checked against what the model knows the bus did.
+ *
+ * Time only moves when the code calls into the HAL (each call costs
+ * what spisim_config_t says) or when the caller says the CPU did some
+ * work (spisim_advance()). A transfer takes its bytes at the SPI clock,
+ * starting dma_setup cycles into HAL_SPI_Transmit_DMA(); the transfer
+ * complete interrupt comes irq cycles after the last bit, preempting
+ * whatever the CPU was doing then, and runs the registered callback.
+ * As on the board, a short transfer can complete before
+ * HAL_SPI_Transmit_DMA() returns.
+ *
+ * Code that spins waiting for the interrupt (spidma_empty_queue(),
+ * spidma_wait_for_completion()) makes no HAL calls, so the clock would
+ * never get there. A CPU time interval timer notices when nothing has
+ * called in for a while with a transfer running, and takes the
+ * interrupt then, as if the CPU had spun until it came. That happens
+ * in a signal handler, on the same thread, so it preempts the code
+ * like the real interrupt; the virtual times are the same either way.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "stm32f7xx_hal.h"
+#include "spisim.h"
+
+// Host CPU time (us) with a transfer running and no HAL call before a spin is assumed
+#define SPIN_CHECK_US 500
+
+GPIO_TypeDef sim_gpio[3];
+DMA_Stream_TypeDef sim_dma_streams[16];
+SPI_TypeDef sim_spi2;
+DWT_Type sim_dwt;
+CoreDebug_Type sim_core_debug;
+uint32_t SystemCoreClock = 216000000;
+
+spisim_config_t spisim_cfg = {
+    .cpu_hz = 216000000,
+    .spi_hz = 27000000,
+    .dma_setup = 400,
+    .dma_return = 100,
+    .irq = 250,
+    .gpio = 20,
+    .tick = 10,
+};
+spisim_stats_t spisim_stats;
+
+static uint64_t now;
+static uint64_t last_bit;       // End of the last transfer
+
+static struct {
+  bool busy;
+  uint64_t done;                // When the interrupt comes
+  SPI_HandleTypeDef *hspi;
+  bool irq_enabled;             // In the NVIC; if not, it waits
+} dma;
+
+// Inside the model (no spin checks), and calls into it so far
+static volatile sig_atomic_t in_sim;
+static volatile uint32_t progress;
+static uint32_t spin_progress;
+
+static void set_now(uint64_t t) {
+  now = t;
+  sim_dwt.CYCCNT = (uint32_t)t;
+}
+
+/** The CPU does cycles of work, taking the transfer complete
+ * interrupt on the way if it comes.
+ */
+static void run_for(uint64_t cycles) {
+  SPI_HandleTypeDef *hspi;
+
+  while (dma.busy && dma.irq_enabled && dma.done <= now + cycles) {
+    // Late, if it came while masked
+    uint64_t at = dma.done > now ? dma.done : now;
+
+    cycles -= at - now;
+    set_now(at + spisim_cfg.irq);
+    hspi = dma.hspi;
+    dma.busy = false;
+    spisim_stats.irqs++;
+    if (hspi->TxCpltCallback != NULL) {
+      hspi->TxCpltCallback(hspi);
+    }
+  }
+  set_now(now + cycles);
+}
+
+static void enter(void) {
+  in_sim++;
+  progress++;
+}
+
+static void leave(void) {
+  in_sim--;
+}
+
+static void spin_check(int sig) {
+  (void)sig;
+
+  if (in_sim == 0 && dma.busy && dma.irq_enabled && progress == spin_progress) {
+    in_sim++;
+    spisim_stats.spin_irqs++;
+    run_for(dma.done - now);
+    in_sim--;
+  }
+  spin_progress = progress;
+}
+
+void spisim_init(void) {
+  struct sigaction sa;
+  struct itimerval it = {
+      .it_interval = { 0, SPIN_CHECK_US },
+      .it_value = { 0, SPIN_CHECK_US },
+  };
+
+  SystemCoreClock = spisim_cfg.cpu_hz;
+  set_now(0);
+  last_bit = 0;
+  memset(&dma, 0, sizeof(dma));
+  // As MX_DMA_Init() leaves it
+  dma.irq_enabled = true;
+  spisim_stats_reset();
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = spin_check;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGVTALRM, &sa, NULL);
+  setitimer(ITIMER_VIRTUAL, &it, NULL);
+}
+
+void spisim_done(void) {
+  struct itimerval it = { 0 };
+
+  setitimer(ITIMER_VIRTUAL, &it, NULL);
+}
+
+void spisim_stats_reset(void) {
+  memset(&spisim_stats, 0, sizeof(spisim_stats));
+  spisim_stats.start = now;
+}
+
+uint64_t spisim_now(void) {
+  return now;
+}
+
+/** The CPU spends cycles on other things (e.g., the rest of the main loop) */
+void spisim_advance(uint32_t cycles) {
+  enter();
+  run_for(cycles);
+  leave();
+}
+
+bool spisim_dma_busy(void) {
+  return dma.busy;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// CMSIS
+
+void NVIC_EnableIRQ(IRQn_Type IRQn) {
+  if (IRQn == DMA1_Stream4_IRQn) {
+    enter();
+    dma.irq_enabled = true;
+    // Taken now, if it came while masked
+    run_for(0);
+    leave();
+  }
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn) {
+  if (IRQn == DMA1_Stream4_IRQn) {
+    dma.irq_enabled = false;
+  }
+}
+
+uint32_t NVIC_GetEnableIRQ(IRQn_Type IRQn) {
+  return IRQn == DMA1_Stream4_IRQn ? dma.irq_enabled : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// The HAL
+
+HAL_StatusTypeDef HAL_SPI_RegisterCallback(SPI_HandleTypeDef *hspi, HAL_SPI_CallbackIDTypeDef CallbackID,
+                                           pSPI_CallbackTypeDef pCallback) {
+  if (hspi == NULL || pCallback == NULL || CallbackID != HAL_SPI_TX_COMPLETE_CB_ID) {
+    return HAL_ERROR;
+  }
+  hspi->TxCpltCallback = pCallback;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size) {
+  uint64_t first_bit, bits;
+
+  enter();
+  if (dma.busy) {
+    spisim_stats.busy_errors++;
+    leave();
+    return HAL_BUSY;
+  }
+  if (pData == NULL || Size == 0) {
+    leave();
+    return HAL_ERROR;
+  }
+
+  run_for(spisim_cfg.dma_setup);
+  first_bit = now;
+  bits = (uint64_t)Size * 8;
+  dma.busy = true;
+  dma.hspi = hspi;
+  dma.done = first_bit + (bits * spisim_cfg.cpu_hz + spisim_cfg.spi_hz - 1) / spisim_cfg.spi_hz;
+
+  if (spisim_stats.transfers > 0) {
+    uint64_t idle = first_bit - last_bit;
+
+    spisim_stats.idle += idle;
+    if (idle > spisim_stats.max_idle) {
+      spisim_stats.max_idle = idle;
+    }
+  }
+  spisim_stats.transfers++;
+  spisim_stats.bytes += Size;
+  spisim_stats.busy += dma.done - first_bit;
+  last_bit = dma.done;
+
+  run_for(spisim_cfg.dma_return);
+  leave();
+  return HAL_OK;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+  enter();
+  if (PinState == GPIO_PIN_RESET) {
+    GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+  } else {
+    GPIOx->ODR |= GPIO_Pin;
+  }
+  spisim_stats.gpio_writes++;
+  run_for(spisim_cfg.gpio);
+  leave();
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+  enter();
+  GPIOx->ODR ^= GPIO_Pin;
+  spisim_stats.gpio_writes++;
+  run_for(spisim_cfg.gpio);
+  leave();
+}
+
+uint32_t HAL_GetTick(void) {
+  uint32_t tick;
+
+  enter();
+  run_for(spisim_cfg.tick);
+  tick = (uint32_t)(now / (spisim_cfg.cpu_hz / 1000));
+  leave();
+  return tick;
+}
@@ -0,0 +1,59 @@
+/*
+ * spisim.h
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-11
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Host model of the SPI DMA peripheral, for running the SPI DMA queue
+ * and the ILI9341 drawing code on Linux. See spisim.c.
+ */
+
+#ifndef SPISIM_H_
+#define SPISIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* What the hardware and HAL cost, in CPU cycles unless noted. The
+ * defaults are the board's: SPI2 at 54 MHz / 2. The HAL costs are
+ * estimates; set dma_setup + dma_return from option 8's "setup/DMA"
+ * on the real board.
+ */
+typedef struct spisim_config {
+  uint32_t cpu_hz;
+  uint32_t spi_hz;       // SPI clock, Hz
+  uint32_t dma_setup;    // In HAL_SPI_Transmit_DMA() before the DMA starts
+  uint32_t dma_return;   // ... and after, until it returns
+  uint32_t irq;          // From the last bit out to the callback running
+  uint32_t gpio;         // A HAL_GPIO_WritePin()
+  uint32_t tick;         // A HAL_GetTick()
+} spisim_config_t;
+
+// What the simulated bus did: the ground truth for spidma_stats_t
+typedef struct spisim_stats {
+  uint64_t start;        // When these started
+  uint64_t transfers;
+  uint64_t bytes;
+  uint64_t busy;         // Cycles shifting bits out
+  uint64_t idle;         // Cycles from one transfer's last bit to the next one's first
+  uint64_t max_idle;
+  uint64_t irqs;
+  uint64_t spin_irqs;    // Of those, taken while the CPU spun waiting for one
+  uint64_t gpio_writes;
+  uint64_t busy_errors;  // HAL_SPI_Transmit_DMA() while a transfer was running
+} spisim_stats_t;
+
+extern spisim_config_t spisim_cfg;
+extern spisim_stats_t spisim_stats;
+
+void spisim_init(void);
+void spisim_done(void);
+void spisim_stats_reset(void);
+uint64_t spisim_now(void);
+void spisim_advance(uint32_t cycles);
+bool spisim_dma_busy(void);
+
+#endif /* SPISIM_H_ */
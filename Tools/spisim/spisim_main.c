@@ -0,0 +1,315 @@
+/*
+ * spisim_main.c
+ *
+ *  Created on: 2025-04-11
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Runs the SPI DMA queue (Core/Src/spidma.c) and the ILI9341 drawing
+ * code (Core/Src/spidma_ili9341.c), unchanged, against the spisim
+ * model, and reports what option 8 would on the board along with the
+ * model's own account of the bus.
+ *
+ * The display is initialized as display_init() does it, then a
+ * workload draws for a while from a model main loop: each pass costs
+ * --loop cycles, may queue some drawing, and calls
+ * spidma_check_activity(), as realmain's loop does.
+ *
+ * Workloads:
+ *   fill     Fill the screen, again as soon as the queue is empty
+ *   text     Lines of Font_7x10, whenever the queue has room
+ *   pixels   Single pixels (the worst case per entry)
+ *   monitor  What the MIDI monitor does: two rows of Font_7x10 at
+ *            the top every --interval ms, if the queue is empty
+ *
+ * Usage:
+ *   make && ./spisim --workload text --seconds 2 -o depth.csv
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include "main.h"
+#include "spidma.h"
+#include "spidma_ili9341.h"
+#include "fonts.h"
+#include "cyclecount.h"
+#include "spisim.h"
+
+// Entries the workloads wait for before queueing more
+#define ROOM_NEEDED 32
+
+static SPI_HandleTypeDef hspi2 = { .Instance = SPI2 };
+static DMA_HandleTypeDef hdma_spi2_tx = { .Instance = DMA1_Stream4 };
+static spidma_config_t spi_config;
+
+typedef enum workload {
+  WL_FILL,
+  WL_TEXT,
+  WL_PIXELS,
+  WL_MONITOR
+} workload_t;
+
+static const char *const workload_names[] = { "fill", "text", "pixels", "monitor" };
+
+static struct {
+  workload_t workload;
+  double seconds;
+  uint32_t interval_ms;
+  uint32_t loop;          // Cycles per main loop pass, besides the SPI queue
+  uint32_t sample_us;
+  const char *output;
+} opt = {
+    .workload = WL_TEXT,
+    .seconds = 2.0,
+    .interval_ms = 20,
+    .loop = 1000,
+    .sample_us = 1000,
+};
+
+// The workload's state
+static uint32_t drawn;
+static uint16_t row;
+static uint64_t next_draw;
+
+static double to_ms(uint64_t cycles) {
+  return cycles * 1000.0 / spisim_cfg.cpu_hz;
+}
+
+/** Queues the next piece of drawing, if the workload wants to. */
+static void produce(spidma_config_t *spi) {
+  char line[91];
+
+  switch (opt.workload) {
+  case WL_FILL:
+    if (spidma_queue_length(spi) == 0) {
+      spidma_ili9341_fill_screen(spi, drawn++ & 1 ? ILI9341_BLUE : ILI9341_BLACK);
+    }
+    break;
+  case WL_TEXT:
+    if (spidma_queue_remaining(spi) >= ROOM_NEEDED) {
+      snprintf(line, sizeof(line), "%08lu 90 B0 3C 64 80 3C 40 B0 07 64 E0 00 40 F8 FA FC FE",
+               (unsigned long)drawn++);
+      spidma_ili9341_write_string(spi, 0, row * Font_7x10.height, line, Font_7x10,
+                                  ILI9341_CYAN, ILI9341_BLACK);
+      row = (row + 1) % (ILI9341_HEIGHT / Font_7x10.height - 1);
+    }
+    break;
+  case WL_PIXELS:
+    if (spidma_queue_remaining(spi) >= ROOM_NEEDED) {
+      spidma_ili9341_draw_pixel(spi, drawn % ILI9341_WIDTH, (drawn / ILI9341_WIDTH) % ILI9341_HEIGHT,
+                                ILI9341_RED);
+      drawn++;
+    }
+    break;
+  case WL_MONITOR:
+    if (spisim_now() >= next_draw && spidma_queue_length(spi) == 0) {
+      snprintf(line, sizeof(line), "%-45s%-45s", "Note on  ch 1 C4  vel 100",
+               drawn++ & 1 ? "Control  ch 1 #7  val 64" : "Clock");
+      spidma_ili9341_write_string(spi, 0, 0, line, Font_7x10, ILI9341_CYAN, ILI9341_BLACK);
+      next_draw = spisim_now() + (uint64_t)opt.interval_ms * (spisim_cfg.cpu_hz / 1000);
+    }
+    break;
+  }
+}
+
+/** What print_spi_bus_stats() shows for option 8 */
+static void print_spidma_stats(spidma_config_t *spi) {
+  spidma_stats_t *st = &spi->stats;
+  uint64_t elapsed = spidma_stats_elapsed(spi);
+  uint32_t starts = st->dma_starts > 0 ? st->dma_starts : 1;
+
+  if (elapsed == 0) {
+    elapsed = 1;
+  }
+  printf("spidma: %lu ms, DMAs: %lu, bytes: %lu, eff: %lu B/s, bus: %lu B/s, busy: %lu%%\n",
+         (unsigned long)(elapsed * 1000 / SystemCoreClock), (unsigned long)st->dma_starts,
+         (unsigned long)st->bytes_sent,
+         (unsigned long)(st->bytes_sent * SystemCoreClock / elapsed),
+         st->busy_cycles > 0 ? (unsigned long)(st->bytes_sent * SystemCoreClock / st->busy_cycles) : 0,
+         (unsigned long)(st->busy_cycles * 100 / elapsed));
+  printf("  setup/DMA: %lu cyc, gap/DMA: %lu cyc, max gap: %lu cyc, starved: %lu ms, max depth: %u\n",
+         (unsigned long)(st->setup_cycles / starts),
+         (unsigned long)(st->backlogged_gap_cycles / starts),
+         (unsigned long)st->max_backlogged_gap,
+         (unsigned long)(st->starved_gap_cycles * 1000 / SystemCoreClock),
+         st->max_depth);
+  printf("  depth hist (0, 1, 2-3 ... 128-255):");
+  for (int i = 0; i < SPIDMA_DEPTH_BUCKETS; i++) {
+    printf(" %lu", (unsigned long)st->depth_histogram[i]);
+  }
+  printf("\n");
+}
+
+/** The model's own account of the bus over the same window */
+static void print_model_stats(uint64_t depth_sum, uint32_t samples) {
+  spisim_stats_t *ss = &spisim_stats;
+  uint64_t elapsed = spisim_now() - ss->start;
+  double secs = elapsed / (double)spisim_cfg.cpu_hz;
+  uint64_t gaps = ss->transfers > 1 ? ss->transfers - 1 : 1;
+
+  if (elapsed == 0) {
+    return;
+  }
+  printf("model: %.1f ms, %llu transfers, %llu B, eff %.0f B/s of %lu B/s line rate, busy %.1f%%\n",
+         secs * 1000, (unsigned long long)ss->transfers, (unsigned long long)ss->bytes,
+         ss->bytes / secs, (unsigned long)(spisim_cfg.spi_hz / 8), ss->busy * 100.0 / elapsed);
+  printf("  idle between transfers: %.2f ms total, %.2f us avg, %.2f us max\n",
+         to_ms(ss->idle), to_ms(ss->idle) * 1000 / gaps, to_ms(ss->max_idle) * 1000);
+  printf("  per transfer: %.1f B, %.2f us on the bus\n",
+         ss->transfers ? (double)ss->bytes / ss->transfers : 0.0,
+         ss->transfers ? to_ms(ss->busy) * 1000 / ss->transfers : 0.0);
+  printf("  %llu interrupts (%llu during spins), %llu GPIO writes, %llu busy errors\n",
+         (unsigned long long)ss->irqs, (unsigned long long)ss->spin_irqs,
+         (unsigned long long)ss->gpio_writes, (unsigned long long)ss->busy_errors);
+  printf("  queue depth: %.1f avg over %lu samples; drawn %lu, %lu queue failures\n",
+         samples ? (double)depth_sum / samples : 0.0, (unsigned long)samples,
+         (unsigned long)drawn, (unsigned long)ili_queue_failures);
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -w, --workload fill|text|pixels|monitor (text)\n"
+          "  -s, --seconds S      virtual time to draw for (2)\n"
+          "  -i, --interval MS    monitor redraw interval (20)\n"
+          "  -l, --loop CYC       main loop cycles besides the SPI queue (1000)\n"
+          "  -o, --output FILE    queue depth over time, as CSV\n"
+          "      --sample-us US   depth sample interval (1000)\n"
+          "      --cpu-hz HZ, --spi-hz HZ\n"
+          "      --dma-setup CYC, --dma-return CYC, --irq CYC, --gpio CYC\n",
+          prog);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  static const struct option longopts[] = {
+      { "workload", required_argument, NULL, 'w' },
+      { "seconds", required_argument, NULL, 's' },
+      { "interval", required_argument, NULL, 'i' },
+      { "loop", required_argument, NULL, 'l' },
+      { "output", required_argument, NULL, 'o' },
+      { "sample-us", required_argument, NULL, 'S' },
+      { "cpu-hz", required_argument, NULL, 'C' },
+      { "spi-hz", required_argument, NULL, 'P' },
+      { "dma-setup", required_argument, NULL, 'D' },
+      { "dma-return", required_argument, NULL, 'R' },
+      { "irq", required_argument, NULL, 'I' },
+      { "gpio", required_argument, NULL, 'G' },
+      { NULL, 0, NULL, 0 }
+  };
+  spidma_config_t *spi = &spi_config;
+  FILE *csv = NULL;
+  uint64_t t0, end, next_sample, sample_cycles, depth_sum = 0;
+  uint32_t samples = 0;
+  int c, w;
+
+  while ((c = getopt_long(argc, argv, "w:s:i:l:o:", longopts, NULL)) != -1) {
+    switch (c) {
+    case 'w':
+      for (w = 0; w <= WL_MONITOR && strcmp(optarg, workload_names[w]) != 0; w++);
+      if (w > WL_MONITOR) {
+        usage(argv[0]);
+      }
+      opt.workload = w;
+      break;
+    case 's': opt.seconds = atof(optarg); break;
+    case 'i': opt.interval_ms = strtoul(optarg, NULL, 0); break;
+    case 'l': opt.loop = strtoul(optarg, NULL, 0); break;
+    case 'o': opt.output = optarg; break;
+    case 'S': opt.sample_us = strtoul(optarg, NULL, 0); break;
+    case 'C': spisim_cfg.cpu_hz = strtoul(optarg, NULL, 0); break;
+    case 'P': spisim_cfg.spi_hz = strtoul(optarg, NULL, 0); break;
+    case 'D': spisim_cfg.dma_setup = strtoul(optarg, NULL, 0); break;
+    case 'R': spisim_cfg.dma_return = strtoul(optarg, NULL, 0); break;
+    case 'I': spisim_cfg.irq = strtoul(optarg, NULL, 0); break;
+    case 'G': spisim_cfg.gpio = strtoul(optarg, NULL, 0); break;
+    default: usage(argv[0]);
+    }
+  }
+  if (opt.seconds <= 0 || opt.sample_us == 0 ||
+      spisim_cfg.cpu_hz < 1000 || spisim_cfg.spi_hz == 0) {
+    usage(argv[0]);
+  }
+  if (opt.output != NULL && (csv = fopen(opt.output, "w")) == NULL) {
+    perror(opt.output);
+    return 1;
+  }
+
+  spisim_init();
+
+  // As display_init() does it
+  spi->bank_cs = SPI2_CS_GPIO_Port;
+  spi->pin_cs = SPI2_CS_Pin;
+  spi->bank_dc = SPI2_DC_GPIO_Port;
+  spi->pin_dc = SPI2_DC_Pin;
+  spi->bank_reset = SPI2_RESET_GPIO_Port;
+  spi->pin_reset = SPI2_RESET_Pin;
+  spi->use_cs = 1;
+  spi->use_reset = 1;
+  spi->spi = &hspi2;
+  spi->dma_tx = &hdma_spi2_tx;
+  spi->dma_tx_irqn = DMA1_Stream4_IRQn;
+  if (spidma_init(spi) != SDRV_OK) {
+    fprintf(stderr, "spidma_init failed\n");
+    return 1;
+  }
+
+  // Queued, then sent in a busy loop
+  t0 = spisim_now();
+  spidma_ili9341_init(spi);
+  spidma_empty_queue(spi);
+  printf("ILI9341 init: %.1f ms, %llu transfers, %llu interrupts during spins\n",
+         to_ms(spisim_now() - t0), (unsigned long long)spisim_stats.transfers,
+         (unsigned long long)spisim_stats.spin_irqs);
+  spidma_queue(spi, SPIDMA_SELECT, 0, NULL, 1000000);
+
+  spidma_stats_reset(spi);
+  spisim_stats_reset();
+  t0 = spisim_now();
+  end = t0 + (uint64_t)(opt.seconds * spisim_cfg.cpu_hz);
+  sample_cycles = (uint64_t)opt.sample_us * spisim_cfg.cpu_hz / 1000000;
+  next_sample = t0;
+  if (csv != NULL) {
+    fprintf(csv, "time_ms,depth,bytes\n");
+  }
+
+  while (spisim_now() < end) {
+    spisim_advance(opt.loop);
+    produce(spi);
+    spidma_check_activity(spi);
+
+    while (spisim_now() >= next_sample) {
+      spiq_size_t depth = spidma_queue_length(spi);
+
+      depth_sum += depth;
+      samples++;
+      if (csv != NULL) {
+        fprintf(csv, "%.3f,%u,%llu\n", to_ms(next_sample - t0), depth,
+                (unsigned long long)spisim_stats.bytes);
+      }
+      next_sample += sample_cycles;
+    }
+  }
+
+  printf("Workload %s, %.2f s, loop %lu cycles, SPI %lu Hz\n", workload_names[opt.workload],
+         opt.seconds, (unsigned long)opt.loop, (unsigned long)spisim_cfg.spi_hz);
+  print_spidma_stats(spi);
+  print_model_stats(depth_sum, samples);
+
+  // Let what is queued finish, so everything is freed
+  while (spidma_queue_length(spi) > 0 || spisim_dma_busy()) {
+    spisim_advance(opt.loop);
+    spidma_check_activity(spi);
+  }
+  spidma_check_activity(spi);
+  spisim_done();
+  if (csv != NULL) {
+    fclose(csv);
+  }
+  return 0;
+}
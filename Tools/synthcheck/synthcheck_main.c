@@ -0,0 +1,157 @@
+/*
+ * synthcheck_main.c
+ *
+ *  Created on: 2025-04-12
+ *  Updated on: 2025-04-12
+ *      Author: Douglas P. Fields, Jr.
+ *   Copyright: 2025, Douglas P. Fields, Jr.
+ *     License: Apache 2.0
+ *
+ * Host runner for the synth's golden audio check (Core/Src/synthcheck.c),
+ * which console option 'S' runs on the device.
+ *
+ * By default it runs that check against the golden hashes, then
+ * renders every scenario again and compares it sample by sample with
+ * the golden samples in golden/, to report the first sample that
+ * differs, not just its block. Exits 1 on any difference.
+ *
+ * With -g it writes the golden samples instead, from the synth as it
+ * is now, and prints the golden hash table for synthcheck.c.
+ *
+ * Golden samples are raw 16-bit little endian PCM, SYNTHCHECK_SAMPLES
+ * per scenario, in golden/scenarioN.pcm (N as in
+ * synthcheck_scenario_names[]).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "synthcheck.h"
+
+static char path[512];
+
+static const char *golden_path(const char *dir, size_t scenario) {
+  snprintf(path, sizeof(path), "%s/scenario%zu.pcm", dir, scenario);
+  return path;
+}
+
+static int write_golden(const char *dir, size_t scenario, const int16_t *samples) {
+  uint8_t bytes[SYNTHCHECK_SAMPLES * 2];
+  FILE *f = fopen(golden_path(dir, scenario), "wb");
+
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  for (size_t i = 0; i < SYNTHCHECK_SAMPLES; i++) {
+    bytes[i * 2] = (uint16_t)samples[i] & 0xFF;
+    bytes[i * 2 + 1] = (uint16_t)samples[i] >> 8;
+  }
+  fwrite(bytes, 1, sizeof(bytes), f);
+  fclose(f);
+  return 0;
+}
+
+static int read_golden(const char *dir, size_t scenario, int16_t *samples) {
+  uint8_t bytes[SYNTHCHECK_SAMPLES * 2];
+  FILE *f = fopen(golden_path(dir, scenario), "rb");
+  size_t got;
+
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  got = fread(bytes, 1, sizeof(bytes), f);
+  fclose(f);
+  if (got != sizeof(bytes)) {
+    fprintf(stderr, "%s: %zu bytes, not %zu\n", path, got, sizeof(bytes));
+    return -1;
+  }
+  for (size_t i = 0; i < SYNTHCHECK_SAMPLES; i++) {
+    samples[i] = (int16_t)(bytes[i * 2] | (bytes[i * 2 + 1] << 8));
+  }
+  return 0;
+}
+
+/** Writes the golden samples, and prints the hash table for synthcheck.c */
+static int regenerate(const char *dir) {
+  uint32_t hashes[SYNTHCHECK_BLOCKS];
+  int16_t samples[SYNTHCHECK_SAMPLES];
+
+  printf("const uint32_t synthcheck_golden[][SYNTHCHECK_BLOCKS] = {\n");
+  for (size_t s = 0; s < synthcheck_num_scenarios; s++) {
+    synthcheck_render(s, hashes, samples);
+    if (write_golden(dir, s, samples) != 0) {
+      return 1;
+    }
+    printf("    { // %s", synthcheck_scenario_names[s]);
+    for (size_t b = 0; b < SYNTHCHECK_BLOCKS; b++) {
+      printf("%s0x%08X%s", b % 4 == 0 ? "\n      " : "", (unsigned)hashes[b],
+             b + 1 < SYNTHCHECK_BLOCKS ? (b % 4 == 3 ? "," : ", ") : "");
+    }
+    printf("\n    }%s\n", s + 1 < synthcheck_num_scenarios ? "," : "");
+  }
+  printf("};\n");
+  return 0;
+}
+
+static int check(const char *dir) {
+  synthcheck_result_t r;
+  uint32_t hashes[SYNTHCHECK_BLOCKS];
+  int16_t samples[SYNTHCHECK_SAMPLES], golden[SYNTHCHECK_SAMPLES];
+  int failed = 0;
+
+  // What the device runs: the hashes
+  synthcheck_run(&r);
+  printf("Hashes: %u scenarios, %u failed", (unsigned)r.scenarios, (unsigned)r.failures);
+  if (r.failures > 0) {
+    printf("; first %s, samples %u-%u", synthcheck_scenario_names[r.failed_scenario],
+           (unsigned)r.first_bad_sample, (unsigned)r.last_bad_sample);
+    failed = 1;
+  }
+  printf("\n");
+
+  // The samples themselves
+  for (size_t s = 0; s < synthcheck_num_scenarios; s++) {
+    size_t first = SYNTHCHECK_SAMPLES, differ = 0;
+
+    if (read_golden(dir, s, golden) != 0) {
+      return 1;
+    }
+    synthcheck_render(s, hashes, samples);
+    for (size_t i = 0; i < SYNTHCHECK_SAMPLES; i++) {
+      if (samples[i] != golden[i]) {
+        if (differ++ == 0) {
+          first = i;
+        }
+      }
+    }
+    if (differ > 0) {
+      printf("%s: %zu samples differ; first is %zu (block %zu): %d, golden %d\n",
+             synthcheck_scenario_names[s], differ, first, first / SYNTHCHECK_BLOCK_SZ,
+             samples[first], golden[first]);
+      failed = 1;
+    } else {
+      printf("%s: ok\n", synthcheck_scenario_names[s]);
+    }
+  }
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  const char *dir = "golden";
+  int gen = 0, c;
+
+  while ((c = getopt(argc, argv, "gd:")) != -1) {
+    switch (c) {
+    case 'g': gen = 1; break;
+    case 'd': dir = optarg; break;
+    default:
+      fprintf(stderr, "Usage: %s [-g] [-d golden_dir]\n", argv[0]);
+      return 2;
+    }
+  }
+  return gen ? regenerate(dir) : check(dir);
+}
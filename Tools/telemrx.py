@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+#
+# telemrx.py
+#
+#  Created on: 2025-04-08
+#  Updated on: 2025-04-12
+#      Author: Douglas P. Fields, Jr.
+#   Copyright: 2025, Douglas P. Fields, Jr.
+#     License: Apache 2.0
+#
+# Receives the binary telemetry stream (console options "T" and "A",
+# see Core/Src/telem.c): COBS frames with a CRC-16/CCITT-FALSE,
+# between zero bytes. Snapshots are written as CSV rows, decimated
+# audio to a CSV of its own, and either can be plotted live with
+# matplotlib. Anything on the console that is not a frame is shown
+# as text on stderr.
+#
+# The stream can come from a file (e.g., a raw capture of the serial
+# console) or be read directly from the serial port with pyserial, in
+# which case streaming is switched on (and off again at the end).
+#
+# Usage:
+#   telemrx.py capture.bin -o snapshots.csv
+#   telemrx.py --port /dev/ttyACM0 -o snapshots.csv --audio audio.csv --plot
+
+import argparse
+import binascii
+import csv
+import struct
+import sys
+
+# Keep in sync with Core/Inc/telem.h (and SYNTH_POLYPHONY in synth.h)
+SNAPSHOT = 1
+AUDIO = 2
+VERSION = 2
+POLYPHONY = 8
+ZONES = ["loop", "audio", "midi_in", "display"]
+
+HEADER = struct.Struct("<BBHII")
+VOICE = struct.Struct("<BBhI")
+COUNTERS = ["midi_rx_bytes", "midi_rx_lost", "synth_msgs", "synth_dropped", "rt_msgs",
+            "midi_out_msgs", "midi_out_dropped", "console_dropped", "log_dropped",
+            "spi_queue_failures", "loops_per_tick"]
+DEPTHS = ["synth_queue", "midi_out_queue", "console_tx", "spi_queue", "log_queue"]
+SNAPSHOT_BODY = struct.Struct("<I" + VOICE.format[1:] * POLYPHONY + "I" * len(COUNTERS) +
+                              "H" * len(DEPTHS) + "III" * len(ZONES))
+AUDIO_BODY = struct.Struct("<IHH")
+
+COLUMNS = (["seq", "ms", "time_s", "voices_on"] +
+           ["voice%d_%s" % (v, f) for v in range(POLYPHONY) for f in ("note", "ampl", "freq")] +
+           COUNTERS + DEPTHS +
+           ["%s_%s" % (z, f) for z in ZONES for f in ("count", "avg_us", "max_us")])
+
+# What --plot shows
+PLOTS = [("voices_on", "voices"),
+         ("synth_queue", "queues"), ("midi_out_queue", "queues"), ("console_tx", "queues"),
+         ("loop_max_us", "zones (max us)"), ("audio_max_us", "zones (max us)"),
+         ("midi_in_max_us", "zones (max us)")]
+
+
+def cobs_decode(data):
+    """Returns the decoded bytes, or None if they are not valid COBS."""
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        if code == 0 or pos + code > len(data):
+            return None
+        out += data[pos + 1:pos + code]
+        pos += code
+        if code < 0xFF and pos < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def parse_snapshot(payload):
+    """Turns a snapshot payload into a CSV row dict."""
+    seq, ms = HEADER.unpack_from(payload)[2], HEADER.unpack_from(payload)[4]
+    values = list(SNAPSHOT_BODY.unpack_from(payload, HEADER.size))
+    cpu_hz = values.pop(0) or 1
+    row = {"seq": seq, "ms": ms, "time_s": ms / 1000.0}
+
+    on = 0
+    for v in range(POLYPHONY):
+        voice_on, note, ampl, freq = values[:4]
+        del values[:4]
+        on += voice_on
+        row["voice%d_note" % v] = note if voice_on else ""
+        row["voice%d_ampl" % v] = ampl
+        row["voice%d_freq" % v] = freq
+    row["voices_on"] = on
+
+    for name in COUNTERS + DEPTHS:
+        row[name] = values.pop(0)
+    for z in ZONES:
+        count, total, mx = values[:3]
+        del values[:3]
+        row[z + "_count"] = count
+        row[z + "_avg_us"] = round(total / count * 1e6 / cpu_hz, 2) if count else 0
+        row[z + "_max_us"] = round(mx * 1e6 / cpu_hz, 2)
+    return row
+
+
+def parse_audio(payload):
+    """Returns (first sample number, decimation, samples)."""
+    first, decimate, count = AUDIO_BODY.unpack_from(payload, HEADER.size)
+    samples = struct.unpack_from("<%dh" % count, payload, HEADER.size + AUDIO_BODY.size)
+    return first, decimate, samples
+
+
+class Receiver:
+    """Splits the console stream into frames and text."""
+
+    def __init__(self, on_snapshot, on_audio, text=sys.stderr):
+        self.on_snapshot = on_snapshot
+        self.on_audio = on_audio
+        self.text = text
+        self.pending = bytearray()
+        self.last_seq = {}
+        self.frames = 0
+        self.bad = 0
+        self.lost = 0
+
+    def chunk(self, data):
+        payload = cobs_decode(data)
+        if payload is None or len(payload) < HEADER.size + 2 or \
+                binascii.crc_hqx(payload[:-2], 0xFFFF) != struct.unpack_from("<H", payload, len(payload) - 2)[0]:
+            # Console text, or a damaged frame
+            if any(32 <= b < 127 for b in data):
+                self.text.write(data.decode("latin-1"))
+            else:
+                self.bad += 1
+            return
+        payload = payload[:-2]
+        ptype, version, seq = HEADER.unpack_from(payload)[:3]
+        if version != VERSION:
+            self.bad += 1
+            return
+
+        last = self.last_seq.get(ptype)
+        if last is not None and seq != (last + 1) & 0xFFFF:
+            self.lost += (seq - last - 1) & 0xFFFF
+        self.last_seq[ptype] = seq
+        self.frames += 1
+
+        if ptype == SNAPSHOT and len(payload) == HEADER.size + SNAPSHOT_BODY.size:
+            self.on_snapshot(parse_snapshot(payload))
+        elif ptype == AUDIO:
+            self.on_audio(*parse_audio(payload))
+        else:
+            self.bad += 1
+
+    def feed(self, data):
+        self.pending += data
+        while True:
+            end = self.pending.find(0)
+            if end < 0:
+                break
+            if end > 0:
+                self.chunk(bytes(self.pending[:end]))
+            del self.pending[:end + 1]
+
+
+class Plot:
+    """Live plot of the PLOTS columns over the last --window seconds."""
+
+    def __init__(self, window):
+        import matplotlib.pyplot as plt
+
+        self.plt = plt
+        self.window = window
+        groups = []
+        for _, group in PLOTS:
+            if group not in groups:
+                groups.append(group)
+        self.fig, axes = plt.subplots(len(groups), 1, sharex=True)
+        self.axes = dict(zip(groups, axes))
+        self.lines = {}
+        for column, group in PLOTS:
+            self.lines[column], = self.axes[group].plot([], [], label=column)
+        for group, ax in self.axes.items():
+            ax.set_ylabel(group)
+            ax.legend(loc="upper left", fontsize="small")
+        self.t = []
+        self.data = {column: [] for column, _ in PLOTS}
+        plt.ion()
+        plt.show()
+
+    def add(self, row):
+        self.t.append(row["time_s"])
+        for column in self.data:
+            self.data[column].append(row[column])
+        while self.t and self.t[0] < self.t[-1] - self.window:
+            self.t.pop(0)
+            for values in self.data.values():
+                values.pop(0)
+
+    def update(self):
+        if not self.t:
+            return
+        for column, line in self.lines.items():
+            line.set_data(self.t, self.data[column])
+        for ax in self.axes.values():
+            ax.relim()
+            ax.autoscale_view()
+        self.plt.pause(0.001)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Receive the binary telemetry stream")
+    ap.add_argument("input", nargs="?", help="file containing a raw console capture")
+    ap.add_argument("-p", "--port", help="read from this serial port (until ^C)")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    ap.add_argument("-o", "--output", default="-", help="snapshot CSV file")
+    ap.add_argument("--audio", help="decimated audio CSV file (and ask for audio)")
+    ap.add_argument("--plot", action="store_true", help="plot the snapshots live")
+    ap.add_argument("--window", type=float, default=30.0, help="seconds shown in the plot")
+    args = ap.parse_args()
+
+    out = sys.stdout if args.output == "-" else open(args.output, "w", newline="")
+    snapshots = csv.DictWriter(out, COLUMNS)
+    snapshots.writeheader()
+    audio_out = None
+    if args.audio:
+        audio_out = csv.writer(open(args.audio, "w", newline=""))
+        audio_out.writerow(["sample", "value"])
+    plot = Plot(args.window) if args.plot else None
+
+    def on_snapshot(row):
+        snapshots.writerow(row)
+        if plot:
+            plot.add(row)
+
+    def on_audio(first, decimate, samples):
+        if audio_out:
+            for i, value in enumerate(samples):
+                audio_out.writerow([first + i * decimate, value])
+
+    rx = Receiver(on_snapshot, on_audio)
+
+    if args.port:
+        import serial  # pyserial
+
+        with serial.Serial(args.port, args.baud, timeout=0.1) as ser:
+            # Each key toggles; the device starts with both off
+            ser.write(b"TA" if args.audio else b"T")
+            try:
+                while True:
+                    rx.feed(ser.read(4096))
+                    out.flush()
+                    if plot:
+                        plot.update()
+            except KeyboardInterrupt:
+                pass
+            ser.write(b"TA" if args.audio else b"T")
+    elif args.input:
+        with open(args.input, "rb") as f:
+            rx.feed(f.read())
+        if plot:
+            plot.update()
+            plot.plt.ioff()
+            plot.plt.show()
+    else:
+        ap.error("specify an input file or --port")
+
+    print("%d frames, %d lost, %d bad" % (rx.frames, rx.lost, rx.bad), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+#
+# trace2chrome.py
+#
+#  Created on: 2025-03-24
+#  Updated on: 2025-03-24
+#      Author: Douglas P. Fields, Jr.
+#   Copyright: 2025, Douglas P. Fields, Jr.
+#     License: Apache 2.0
+#
+# Converts a binary event trace dump (console option "t", see
+# Core/Src/trace.c) into Chrome trace_event JSON, which can be
+# opened in chrome://tracing or https://ui.perfetto.dev
+#
+# The dump can come from a file (e.g., a raw capture of the serial
+# console) or be read directly from the serial port with pyserial.
+# Anything before the "TRC1" magic is ignored.
+#
+# Usage:
+#   trace2chrome.py capture.bin -o trace.json
+#   trace2chrome.py --port /dev/ttyACM0 -o trace.json
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"TRC1"
+HEADER = struct.Struct("<4sIHHI")
+RECORD = struct.Struct("<IBBH")
+
+# Keep in sync with trace_event_id_t in Core/Inc/trace.h
+ISR_ENTER = 1
+ISR_EXIT = 2
+DMA_START = 3
+DMA_COMPLETE = 4
+AUDIO_FILL_BEGIN = 5
+AUDIO_FILL_END = 6
+MIDI_MESSAGE = 7
+SPI_ENTRY = 8
+MARK = 9
+
+# STM32F722 IRQn values we trace, for nicer names
+IRQ_NAMES = {
+    14: "DMA1_Stream3",
+    15: "DMA1_Stream4",
+    17: "DMA1_Stream6",
+    59: "DMA2_Stream3",
+    69: "DMA2_Stream6",
+    70: "DMA2_Stream7",
+}
+
+# What is on each DMA stream (see realmain.c); DMA2 streams are 8-15
+DMA_NAMES = {
+    3: "USART3 TX",
+    4: "SPI2 TX (display)",
+    6: "USART2 TX (console)",
+    8 + 3: "SPI1 TX (I2S)",
+    8 + 6: "USART6 TX",
+    8 + 7: "USART1 TX (MIDI)",
+}
+
+# spidma_entry_type_t
+SPI_ENTRY_NAMES = ["data", "command", "unchanged", "delay",
+                   "reset", "unreset", "select", "deselect"]
+
+# Track (thread) ids for the timeline
+TID_MAIN = 1
+TID_AUDIO = 2
+TID_MIDI = 3
+TID_SPI = 4
+TID_ISR = 10
+TID_DMA = 100
+
+
+def parse_dump(data):
+    """Returns (header dict, list of (timestamp, event, arg8, arg16))."""
+    start = data.find(MAGIC)
+    if start < 0:
+        raise ValueError("No " + MAGIC.decode() + " trace dump found")
+    if len(data) < start + HEADER.size:
+        raise ValueError("Trace dump header is truncated")
+
+    _, cpu_hz, count, record_sz, lost = HEADER.unpack_from(data, start)
+    if record_sz != RECORD.size:
+        raise ValueError("Unexpected record size %d" % record_sz)
+
+    pos = start + HEADER.size
+    available = (len(data) - pos) // record_sz
+    if available < count:
+        print("Warning: dump truncated, %d of %d records" % (available, count),
+              file=sys.stderr)
+        count = available
+
+    records = [RECORD.unpack_from(data, pos + i * record_sz) for i in range(count)]
+    return {"cpu_hz": cpu_hz, "count": count, "lost": lost}, records
+
+
+def read_serial(port, baud, timeout):
+    """Asks the device for a dump and reads it from the serial port."""
+    import serial  # pyserial
+
+    with serial.Serial(port, baud, timeout=timeout) as ser:
+        ser.reset_input_buffer()
+        ser.write(b"t")
+        data = bytearray()
+        needed = None
+        while True:
+            chunk = ser.read(4096)
+            if not chunk:
+                break
+            data += chunk
+            start = data.find(MAGIC)
+            if needed is None and start >= 0 and len(data) >= start + HEADER.size:
+                _, _, count, record_sz, _ = HEADER.unpack_from(data, start)
+                needed = start + HEADER.size + count * record_sz
+            if needed is not None and len(data) >= needed:
+                break
+        return bytes(data)
+
+
+def to_chrome(header, records):
+    """Converts the records to a list of Chrome trace events."""
+    cycles_per_us = header["cpu_hz"] / 1e6
+    events = []
+    base = None
+    prev = None
+    wraps = 0
+
+    def track(tid, name):
+        events.append({"ph": "M", "name": "thread_name", "pid": 1, "tid": tid,
+                       "args": {"name": name}})
+
+    track(TID_MAIN, "main loop")
+    track(TID_AUDIO, "audio fill")
+    track(TID_MIDI, "MIDI in")
+    track(TID_SPI, "SPI queue")
+    for irq, name in IRQ_NAMES.items():
+        track(TID_ISR + irq, "ISR " + name)
+    for dma, name in DMA_NAMES.items():
+        track(TID_DMA + dma, "DMA " + name)
+
+    for ts, ev, arg8, arg16 in records:
+        # The cycle counter is 32 bits and wraps every ~20 seconds
+        if prev is not None and ts < prev:
+            wraps += 1
+        prev = ts
+        cycles = ts + (wraps << 32)
+        if base is None:
+            base = cycles
+        us = (cycles - base) / cycles_per_us
+        e = {"pid": 1, "ts": us}
+
+        if ev in (ISR_ENTER, ISR_EXIT):
+            e.update(name=IRQ_NAMES.get(arg8, "IRQ %d" % arg8),
+                     ph="B" if ev == ISR_ENTER else "E", tid=TID_ISR + arg8)
+        elif ev in (DMA_START, DMA_COMPLETE):
+            e.update(name=DMA_NAMES.get(arg8, "DMA %d" % arg8),
+                     ph="B" if ev == DMA_START else "E", tid=TID_DMA + arg8)
+            if ev == DMA_START:
+                e["args"] = {"bytes": arg16}
+        elif ev in (AUDIO_FILL_BEGIN, AUDIO_FILL_END):
+            e.update(name="fill half %d" % arg8,
+                     ph="B" if ev == AUDIO_FILL_BEGIN else "E", tid=TID_AUDIO)
+            if ev == AUDIO_FILL_BEGIN:
+                e["args"] = {"samples": arg16}
+        elif ev == MIDI_MESSAGE:
+            e.update(name="MIDI %02X" % arg8, ph="i", s="t", tid=TID_MIDI,
+                     args={"data1": arg16 & 0xFF, "data2": arg16 >> 8})
+        elif ev == SPI_ENTRY:
+            name = SPI_ENTRY_NAMES[arg8] if arg8 < len(SPI_ENTRY_NAMES) else str(arg8)
+            e.update(name="SPI " + name, ph="i", s="t", tid=TID_SPI,
+                     args={"size": arg16})
+        elif ev == MARK:
+            e.update(name="mark", ph="i", s="g", tid=TID_MAIN,
+                     args={"arg8": arg8, "arg16": arg16})
+        else:
+            e.update(name="event %d" % ev, ph="i", s="t", tid=TID_MAIN,
+                     args={"arg8": arg8, "arg16": arg16})
+        events.append(e)
+
+    return events
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Convert a binary event trace dump to Chrome trace_event JSON")
+    ap.add_argument("input", nargs="?", help="file containing a raw trace dump")
+    ap.add_argument("-p", "--port", help="read the dump from this serial port")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    ap.add_argument("-t", "--timeout", type=float, default=2.0,
+                    help="serial read timeout in seconds")
+    ap.add_argument("-o", "--output", default="-", help="JSON output file")
+    args = ap.parse_args()
+
+    if args.port:
+        data = read_serial(args.port, args.baud, args.timeout)
+    elif args.input:
+        with open(args.input, "rb") as f:
+            data = f.read()
+    else:
+        ap.error("specify an input file or --port")
+
+    header, records = parse_dump(data)
+    print("%d events, %d lost, %d Hz" % (header["count"], header["lost"], header["cpu_hz"]),
+          file=sys.stderr)
+
+    out = {"traceEvents": to_chrome(header, records), "displayTimeUnit": "ns"}
+    if args.output == "-":
+        json.dump(out, sys.stdout)
+    else:
+        with open(args.output, "w") as f:
+            json.dump(out, f)
+
+
+if __name__ == "__main__":
+    main()